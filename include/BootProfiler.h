@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "NetworkSettings.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class BootProfilerClass {
+public:
+    struct Stage_t {
+        const char* name; // constant string
+        uint32_t start; // ms since boot
+        uint32_t duration; // ms
+    };
+
+    // Starts the sequential stages of setup(). Everything before is recorded as "startup".
+    void begin();
+
+    // Registers the network callback, requires an initialized network
+    void init();
+
+    // Ends the current sequential stage of setup() and starts the next one
+    void endStage(const char* name);
+
+    // Records a stage which ran in parallel to setup()
+    void addStage(const char* name, const uint32_t start);
+
+    void setWebStarted();
+
+    // Returns the time the web server was started and an IP was available, 0 if not reached yet
+    uint32_t getWebReadyMillis() const;
+
+    // Calls the visitor for every recorded stage in the order they completed
+    void visitStages(const std::function<void(const Stage_t& stage)>& visitor) const;
+
+private:
+    void onNetworkEvent(network_event event);
+
+    mutable std::mutex _mutex;
+    std::vector<Stage_t> _stages;
+    uint32_t _stageStart = 0;
+
+    std::atomic<uint32_t> _webStartedMillis { 0 };
+    std::atomic<uint32_t> _gotIpMillis { 0 };
+};
+
+extern BootProfilerClass BootProfiler;
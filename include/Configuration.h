@@ -2,12 +2,19 @@
 #pragma once
 
 #include "PinMapping.h"
+#include <Print.h>
 #include <TaskSchedulerDeclarations.h>
-#include <condition_variable>
+#include <atomic>
+#include <bitset>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
-#define CONFIG_FILENAME "/config.json"
+#define CONFIG_FILENAME "/config.json" // imported at boot if present, name of the JSON export
+#define CONFIG_DIR "/config"
+#define CONFIG_WRITE_DELAY 1000 // ms
 #define CONFIG_VERSION 0x00011e00 // 0.1.30 // make sure to clean all after change
 
 #define WIFI_MAX_SSID_STRLEN 32
@@ -64,7 +71,6 @@ struct INVERTER_CONFIG_T {
 struct CONFIG_T {
     struct {
         uint32_t Version;
-        uint32_t SaveCount;
     } Cfg;
 
     struct {
@@ -109,6 +115,9 @@ struct CONFIG_T {
         bool Retain;
         uint32_t PublishInterval;
         bool CleanSession;
+        bool PublishOnChange;
+        uint32_t PublishMaxAge;
+        bool Aggregated; // one JSON document per inverter instead of one topic per value
 
         struct {
             char Topic[MQTT_MAX_TOPIC_STRLEN + 1];
@@ -180,36 +189,112 @@ struct CONFIG_T {
     } Logging;
 };
 
+// Parts of the configuration changed by a WriteGuard, used to apply only what changed
+struct ConfigDiff_t {
+    bool MqttConnection = false; // everything requiring a reconnect of the client, including the base topic
+    bool MqttHass = false;
+    bool MqttPublish = false; // interval, publish on change and aggregated mode
+
+    bool DtuSerial = false;
+    bool DtuPollInterval = false;
+    bool DtuNrfPaLevel = false;
+    bool DtuCmtPaLevel = false;
+    bool DtuCmtCountryMode = false;
+    bool DtuCmtFrequency = false;
+
+    // One bit per inverter slot
+    std::bitset<INV_MAX_COUNT> InverterSerial;
+    std::bitset<INV_MAX_COUNT> InverterName;
+    std::bitset<INV_MAX_COUNT> InverterSettings; // polling, commands, reachability and midnight handling
+    std::bitset<INV_MAX_COUNT> InverterChannel; // max power and yield total offset
+
+    // Channel names and the order are only read by the web interface and have no callback
+
+    static ConfigDiff_t compare(const CONFIG_T& previous, const CONFIG_T& current);
+
+    bool any() const;
+    void merge(const ConfigDiff_t& other);
+};
+
+typedef std::function<void(const ConfigDiff_t& diff)> ConfigChangeCb;
+
+class InverterAbstract;
+
 class ConfigurationClass {
 public:
     void init(Scheduler& scheduler);
     bool read();
-    bool write();
+
+    // Schedules a save. Saves within CONFIG_WRITE_DELAY are combined, a failure is reported by hasWriteFailed().
+    void write();
+
+    // Writes a scheduled save immediately. Called before a restart.
+    bool flush();
+
+    // True if the last save could not write all sections
+    bool hasWriteFailed() const;
+
+    // Drops a scheduled save and blocks all further saves until the restart.
+    // Used when CONFIG_FILENAME was replaced, which is imported at the next boot instead.
+    void discardWrites();
+
     void migrate();
-    CONFIG_T const& get();
 
+    // Returns the current snapshot. Snapshots are immutable, a write publishes a new one.
+    // A superseded snapshot stays valid as long as it is referenced. Not lock free, code
+    // running for every value fetches it once per loop.
+    std::shared_ptr<const CONFIG_T> get();
+
+    // Incremented with every published snapshot
+    uint32_t getRevision() const;
+
+    // Incremented with every save which changed a section
+    uint32_t getSaveCount() const;
+
+    // Writes the complete configuration in the format of CONFIG_FILENAME, used for backups
+    bool exportJson(Print& out);
+    size_t getExportSize();
+
+    // Writers are serialized. The changes are made on a copy which is published by the destructor.
     class WriteGuard {
     public:
         WriteGuard();
         CONFIG_T& getConfig();
         ~WriteGuard();
 
+        INVERTER_CONFIG_T* getFreeInverterSlot();
+        void deleteInverterById(const uint8_t id);
+
     private:
         std::unique_lock<std::mutex> _lock;
+        std::unique_ptr<CONFIG_T> _config;
     };
 
     WriteGuard getWriteGuard();
 
-    INVERTER_CONFIG_T* getFreeInverterSlot();
-    INVERTER_CONFIG_T* getInverterConfig(const uint64_t serial);
-    void deleteInverterById(const uint8_t id);
+    // The callback is called by the main loop after a WriteGuard changed the configuration
+    void onChange(const ConfigChangeCb& cb);
+
+    // The returned pointer keeps the snapshot alive
+    std::shared_ptr<const INVERTER_CONFIG_T> getInverterConfig(const uint64_t serial);
+    std::shared_ptr<const INVERTER_CONFIG_T> getInverterConfig(const InverterAbstract& inv); // O(1) using the config index of the inverter
 
     int8_t getIndexForLogModule(const String& moduleName) const;
 
 private:
     void loop();
 
+    bool importJson(CONFIG_T& config);
+    bool writeSections(const CONFIG_T& config);
+
     Task _loopTask;
+
+    std::vector<ConfigChangeCb> _changeCallbacks;
+
+    std::atomic<bool> _writePending { false };
+    std::atomic<bool> _writeFailed { false };
+    bool _writesDiscarded = false; // protected by the writer mutex
+    std::atomic<uint32_t> _writeRequestMillis { 0 };
 };
 
 extern ConfigurationClass Configuration;
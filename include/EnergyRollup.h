@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <TaskSchedulerDeclarations.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define ENERGY_DIR "/energy"
+#define ENERGY_FILE_MAGIC 0x454e5231 // "ENR1"
+#define ENERGY_FILE_VERSION 1
+
+#define ENERGY_HOURS 48
+#define ENERGY_DAYS 400
+#define ENERGY_MONTHS 60
+#define ENERGY_YEARS 20
+
+#define ENERGY_MAX_DELTA (50 * 1000) // Wh, larger yield jumps are treated as counter reset
+#define ENERGY_FLEET_SERIAL 0
+
+enum EnergyResolution_t {
+    ENERGY_HOUR = 0,
+    ENERGY_DAY,
+    ENERGY_MONTH,
+    ENERGY_YEAR,
+};
+
+class EnergyRollupClass {
+public:
+    EnergyRollupClass();
+    void init(Scheduler& scheduler);
+
+    // Writes all pending energy to flash. Called before a restart.
+    void flush();
+
+    // Returns the index of the period containing the given time (local time)
+    static uint32_t getPeriod(const EnergyResolution_t resolution, const time_t time);
+
+    // Returns the start (epoch seconds) of the given period
+    static time_t getPeriodStart(const EnergyResolution_t resolution, const uint32_t period);
+
+    // Fills values with the energy in Wh of count consecutive periods starting at firstPeriod.
+    // Use ENERGY_FLEET_SERIAL to get the sum of all inverters.
+    bool getEnergy(const uint64_t serial, const EnergyResolution_t resolution, const uint32_t firstPeriod, const size_t count, float* values);
+
+private:
+    struct __attribute__((packed)) RollupFile_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        float lastYieldTotal; // kWh
+        uint32_t lastPeriod[4]; // most recent period per resolution
+        float hours[ENERGY_HOURS]; // Wh, index is period % ENERGY_HOURS
+        float days[ENERGY_DAYS];
+        float months[ENERGY_MONTHS];
+        float years[ENERGY_YEARS];
+    };
+
+    struct Pending_t {
+        uint64_t serial = 0;
+        bool synced = false;
+        float lastYieldTotal = 0;
+        float energy = 0; // Wh not yet written to flash
+        uint32_t period[4] = {}; // periods the pending energy belongs to
+    };
+
+    void loop();
+
+    Pending_t& getPending(const uint64_t serial);
+    void addEnergy(Pending_t& pending, const uint32_t* period, const float energy);
+    void closePeriods(const uint32_t* period); // writes the pending energy of finished periods
+    bool writePending(Pending_t& pending);
+    void flushAll();
+
+    static String getFileName(const uint64_t serial);
+    static bool readFile(const uint64_t serial, RollupFile_t& data);
+    static float* getBuckets(RollupFile_t& data, const EnergyResolution_t resolution, size_t& size);
+    static void advance(float* buckets, const size_t size, uint32_t& lastPeriod, const uint32_t period);
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::vector<Pending_t> _pending; // one entry per inverter plus the fleet
+    RollupFile_t _file; // buffer for file access, protected by _mutex
+};
+
+extern EnergyRollupClass EnergyRollup;
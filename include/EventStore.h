@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <LittleFS.h>
+#include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#define EVENTSTORE_DIR "/events"
+#define EVENTSTORE_FILE_MAGIC 0x45564c31 // "EVL1"
+#define EVENTSTORE_FILE_VERSION 1
+
+#define EVENTSTORE_FLASH_BUDGET (24 * 1024) // total LittleFS space for all inverters
+#define EVENTSTORE_MIN_RECORDS 64
+#define EVENTSTORE_RECENT_COUNT 16 // more than the inverter keeps in its own log
+
+struct __attribute__((packed)) StoredEvent_t {
+    uint32_t startTime; // epoch seconds
+    uint32_t endTime; // epoch seconds, 0 while the event is active
+    uint16_t messageId;
+    uint16_t reserved;
+};
+
+using StoredEventVisitor = std::function<void(const StoredEvent_t& event)>;
+
+class EventStoreClass {
+public:
+    EventStoreClass();
+    void init(Scheduler& scheduler);
+
+    // Visits the events of one inverter which started between from and to (epoch seconds) in chronological order.
+    // The first offset events are skipped and at most limit events are visited.
+    // Returns the total number of events within the range.
+    size_t forEachEvent(const uint64_t serial, const uint32_t from, const uint32_t to, const size_t offset, const size_t limit, const StoredEventVisitor& visitor);
+
+private:
+    struct __attribute__((packed)) FileHeader_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+    };
+
+    struct RecentEvent_t {
+        size_t index; // record number in the file
+        StoredEvent_t event;
+    };
+
+    struct InverterEvents_t {
+        uint64_t serial = 0;
+        uint32_t lastUpdate = 0; // last update of the alarm log which was processed
+        size_t recordCount = 0;
+        std::vector<RecentEvent_t> recent; // newest records used to detect duplicates and updates
+    };
+
+    void loop();
+
+    InverterEvents_t* getInverterEvents(const uint64_t serial, const bool create);
+    void openFile(InverterEvents_t& events);
+    void storeEvent(InverterEvents_t& events, const StoredEvent_t& event);
+    void compact(InverterEvents_t& events);
+    static String getFileName(const uint64_t serial);
+    static size_t getMaxRecords();
+
+    static size_t lowerBound(File& f, const size_t count, const uint32_t time);
+    static bool readRecord(File& f, const size_t index, StoredEvent_t& event);
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::vector<InverterEvents_t> _events;
+};
+
+extern EventStoreClass EventStore;
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <FS.h>
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define HISTORY_DIR "/history"
+#define HISTORY_FILE_MAGIC 0x48535431 // "HST1"
+#define HISTORY_FILE_VERSION 1
+
+#define HISTORY_RETENTION (7 * 24 * 60 * 60) // seconds
+#define HISTORY_BLOCK_SIZE 1024
+#define HISTORY_FLASH_BUDGET (32 * 1024) // LittleFS space of the one minute samples of all inverters
+#define HISTORY_FLASH_MIN_SLOTS 4
+#define HISTORY_RAM_SLOTS 200 // enough for 7 days, only used with PSRAM
+#define HISTORY_AVERAGE_INTERVAL 10 // minutes per average sample
+#define HISTORY_AVERAGE_BUDGET (64 * 1024) // LittleFS space of the averages of all inverters
+#define HISTORY_AVERAGE_VALUE_SIZE 2 // expected bytes per encoded average, used to size the ring for HISTORY_RETENTION
+#define HISTORY_MAX_SERIES (3 + 2 * INV_MAX_CHAN_COUNT)
+#define HISTORY_VALUE_SCALE 10 // values are stored with one decimal
+
+struct HistorySeries_t {
+    uint8_t type; // ChannelType_t
+    uint8_t channel; // ChannelNum_t
+    uint8_t field; // FieldId_t
+};
+
+// Calls for every stored sample with the timestamp (epoch seconds) and one value per series
+using HistorySampleVisitor = std::function<void(const uint32_t timestamp, const uint8_t seriesCount, const HistorySeries_t* series, const float* values)>;
+
+// Position of an incremental read, see HistoryClass::openCursor()
+struct HistoryCursor_t {
+    uint64_t serial = 0;
+    uint32_t start = 0; // timestamp of the next sample to visit
+    uint32_t to = 0;
+    uint32_t minutesStart = 0; // averages are only visited before the oldest one minute sample
+    bool finished = true;
+
+    // Ring which is currently read
+    uint8_t ring = 0;
+    bool recorded = false; // layout was taken from the recorded history instead of the file header
+    uint16_t slotCount = 0; // 0 after the last slot was copied
+    uint16_t slot = 0; // next slot to copy
+    uint16_t remaining = 0; // slots which were not copied yet
+    bool currentCopied = false; // block which is currently recorded was copied
+
+    // Block which is currently decoded, empty if the next one has to be copied
+    std::vector<uint8_t> block;
+    uint16_t sample = 0; // decoded samples
+    uint16_t offset = 0; // decoded bytes
+    int32_t values[HISTORY_MAX_SERIES] = {};
+};
+
+class HistoryClass {
+public:
+    HistoryClass();
+    void init(Scheduler& scheduler);
+
+    // Visits all samples of the given inverter between from and to (epoch seconds) in chronological order
+    bool forEachSample(const uint64_t serial, const uint32_t from, const uint32_t to, const HistorySampleVisitor& visitor);
+
+    // Starts reading the samples of the given inverter between from and to in parts, e.g. one per response chunk.
+    // Every block is read only once. Returns false if there is no history of the inverter.
+    bool openCursor(const uint64_t serial, const uint32_t from, const uint32_t to, HistoryCursor_t& cursor);
+
+    // Visits up to maxSamples following samples. Returns false after the last sample.
+    bool readCursor(HistoryCursor_t& cursor, const size_t maxSamples, const HistorySampleVisitor& visitor);
+
+    // Returns the series currently recorded for the given inverter
+    std::vector<HistorySeries_t> getSeries(const uint64_t serial);
+
+private:
+    struct __attribute__((packed)) FileHeader_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t slotCount;
+        uint16_t nextSlot;
+        uint16_t reserved;
+    };
+
+    // Every block contains consecutive samples of all series.
+    // Values are stored as zigzag varint encoded deltas to the previous sample.
+    struct __attribute__((packed)) BlockHeader_t {
+        uint32_t startMinute; // epoch minutes of the first sample
+        uint16_t sampleCount;
+        uint16_t dataLength;
+        uint8_t seriesCount;
+        uint8_t interval; // minutes between two samples, 0 in blocks written before averages were recorded
+        uint8_t reserved[2];
+        HistorySeries_t series[HISTORY_MAX_SERIES];
+    };
+
+    enum RingType_t : uint8_t {
+        RING_MINUTES = 0, // one minute samples of the last hours
+        RING_AVERAGES, // HISTORY_AVERAGE_INTERVAL averages of HISTORY_RETENTION
+        RING_COUNT
+    };
+
+    struct Ring_t {
+        uint16_t slots = 0; // blocks in the file, 0 if the file could not be created
+        uint16_t nextSlot = 0;
+
+        std::vector<uint8_t> current; // block which is currently recorded
+        int32_t lastValues[HISTORY_MAX_SERIES] = {};
+        uint32_t lastMinute = 0;
+    };
+
+    struct InverterHistory_t {
+        uint64_t serial = 0;
+
+        Ring_t rings[RING_COUNT];
+
+        std::vector<uint8_t> ramSlots; // complete copy of the one minute samples in PSRAM, empty without PSRAM
+        uint16_t ramNextSlot = 0;
+
+        // Sum of the samples of the current average interval
+        int32_t sums[HISTORY_MAX_SERIES] = {};
+        uint8_t sumSeriesCount = 0;
+        uint16_t sumCount = 0;
+        uint32_t sumMinute = 0; // epoch minutes of the start of the interval
+    };
+
+    void loop();
+
+    InverterHistory_t* getInverterHistory(const uint64_t serial, const bool create);
+    void openFile(InverterHistory_t& history, const RingType_t type);
+    static String getFileName(const uint64_t serial, const RingType_t type);
+
+    // Flash blocks per inverter, depends on the number of inverters and for the averages on the number of series
+    static uint16_t getSlotCount(const RingType_t type, const size_t seriesCount);
+    static size_t getSamplesPerBlock(const size_t seriesCount); // expected averages per block
+    void resizeFile(InverterHistory_t& history, const RingType_t type, const uint16_t slotCount);
+    void relayoutFiles();
+    void restoreBlock(InverterHistory_t& history);
+
+    static std::vector<HistorySeries_t> buildSeries(std::shared_ptr<InverterAbstract> inv);
+
+    void recordSample(InverterHistory_t& history, std::shared_ptr<InverterAbstract> inv, const uint32_t minute);
+    void appendSample(InverterHistory_t& history, const RingType_t type, const uint32_t minute, const std::vector<HistorySeries_t>& series, const int32_t* values);
+    static void startBlock(Ring_t& ring, const std::vector<HistorySeries_t>& series, const uint32_t minute, const uint8_t interval);
+    void closeBlock(InverterHistory_t& history, const RingType_t type);
+    void writeBlock(InverterHistory_t& history, const RingType_t type, const bool advance);
+
+    static uint32_t getStep(const BlockHeader_t* header);
+    static uint16_t getRecordedSlotCount(const InverterHistory_t& history, const RingType_t type);
+    static uint16_t getFirstSlot(const InverterHistory_t& history, const RingType_t type); // oldest complete block
+
+    // Positions the cursor at the oldest block of a ring. Returns false if neither a recorded history nor a file exists.
+    bool openRing(HistoryCursor_t& cursor, const RingType_t type);
+
+    // Copies the next block of the current ring which overlaps the range from cursor.start to to.
+    // Returns false after the last block.
+    bool copyNextBlock(HistoryCursor_t& cursor, const uint32_t to);
+
+    // Copies a block overlapping the given range into block. history is nullptr if the file is read without a recorded history. Requires _mutex.
+    static bool copyBlock(const InverterHistory_t* history, const RingType_t type, File& f, const uint16_t slot, const uint32_t from, const uint32_t to, std::vector<uint8_t>& block);
+
+    Task _loopTask;
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<InverterHistory_t>> _histories;
+    uint32_t _lastMinute = 0;
+    uint8_t _inverterCount = 0;
+};
+
+extern HistoryClass History;
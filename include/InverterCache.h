@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <vector>
+
+#define INVERTER_CACHE_DIR "/cache"
+#define INVERTER_CACHE_FILE_MAGIC 0x49434831 // "ICH1"
+#define INVERTER_CACHE_FILE_VERSION 1
+
+class InverterCacheClass {
+public:
+    InverterCacheClass();
+    void init(Scheduler& scheduler);
+
+private:
+    struct __attribute__((packed)) CacheFile_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint8_t devInfoAllLength;
+        uint8_t devInfoAll[DEV_INFO_SIZE];
+        uint8_t devInfoSimpleLength;
+        uint8_t devInfoSimple[DEV_INFO_SIZE];
+        uint8_t gridProfileLength;
+        uint8_t gridProfile[GRID_PROFILE_SIZE];
+        uint8_t hasLimit;
+        float limitPercent;
+    };
+
+    struct InverterState_t {
+        uint64_t serial = 0;
+        uint32_t devInfoUpdate = 0;
+        uint32_t gridProfileUpdate = 0;
+        uint32_t limitUpdate = 0;
+        uint32_t checksum = 0; // of the content written last
+    };
+
+    void loop();
+
+    void restore(InverterState_t& state, std::shared_ptr<InverterAbstract> inv);
+    void update(InverterState_t& state, std::shared_ptr<InverterAbstract> inv);
+
+    static String getFileName(const uint64_t serial);
+    static uint32_t getChecksum(const CacheFile_t& data);
+
+    Task _loopTask;
+
+    std::vector<InverterState_t> _states;
+};
+
+extern InverterCacheClass InverterCache;
@@ -1,22 +1,45 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <TaskSchedulerDeclarations.h>
+#include <atomic>
 #include <cstdint>
 
 #define INVERTER_UPDATE_SETTINGS_INTERVAL 60000l
 
+// The radios are initialized on the core not running the Arduino loop
+#if CONFIG_FREERTOS_UNICORE
+#define INVERTER_RADIO_INIT_CORE 0
+#else
+#define INVERTER_RADIO_INIT_CORE (ARDUINO_RUNNING_CORE == 0 ? 1 : 0)
+#endif
+#define INVERTER_RADIO_INIT_STACK_SIZE 4096
+
 class InverterSettingsClass {
 public:
     InverterSettingsClass();
     void init(Scheduler& scheduler);
 
+    // Returns true once the radio hardware is initialized
+    bool isRadioReady() const;
+
 private:
+    static void radioInitTask(void* parameter);
+    void initRadio();
+
+    // Changes arriving while the radios are initialized on the other core are merged and applied afterwards
+    void onConfigChange(const ConfigDiff_t& diff);
+    void applyConfigChange(const ConfigDiff_t& diff);
+
     void settingsLoop();
     void hoyLoop();
 
     Task _settingsTask;
     Task _hoyTask;
+
+    std::atomic<bool> _radioReady { false };
+    ConfigDiff_t _pendingDiff;
 };
 
 extern InverterSettingsClass InverterSettings;
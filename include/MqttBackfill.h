@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define MQTT_BACKFILL_TOPIC "backfill/"
+#define MQTT_BACKFILL_PSRAM_RECORDS 16384 // 448 KiB (28 bytes per record), used if PSRAM is available
+#define MQTT_BACKFILL_RAM_RECORDS 256 // 7 KiB
+#define MQTT_BACKFILL_REPLAY_INTERVAL 250 // ms
+#define MQTT_BACKFILL_REPLAY_BATCH 4 // records per interval
+#define MQTT_BACKFILL_TOTAL_SERIAL 0 // serial of the records containing the totals of all inverters
+
+struct MqttBackfillStats_t {
+    size_t Records; // waiting for the replay
+    size_t Capacity;
+    uint32_t Captured;
+    uint32_t Dropped; // oldest records overwritten because the buffer was full
+    uint32_t Replayed;
+};
+
+class MqttBackfillClass {
+public:
+    MqttBackfillClass();
+    void init(Scheduler& scheduler);
+
+    MqttBackfillStats_t getStats();
+
+private:
+    struct __attribute__((packed)) Record_t {
+        uint32_t Timestamp; // epoch seconds
+        uint64_t Serial;
+        float AcPower;
+        float DcPower;
+        float YieldDay;
+        float YieldTotal;
+    };
+    static_assert(sizeof(Record_t) == 28, "update the buffer sizes above");
+
+    struct LastUpdate_t {
+        uint64_t Serial;
+        uint32_t LastUpdate;
+    };
+
+    void loop();
+    void capture();
+    void replay();
+
+    void push(const Record_t& record); // requires _mutex
+    bool hasNewData(const uint64_t serial, const uint32_t lastUpdate);
+
+    Task _loopTask;
+    uint32_t _lastReplayMillis = 0;
+
+    std::vector<LastUpdate_t> _lastUpdates; // last captured or published data of every inverter
+
+    std::mutex _mutex;
+    std::vector<Record_t> _records; // ring buffer, allocated on the first outage
+    size_t _capacity = 0;
+    size_t _head = 0; // oldest record
+    size_t _count = 0;
+    uint32_t _captured = 0;
+    uint32_t _dropped = 0;
+    uint32_t _replayed = 0;
+};
+
+extern MqttBackfillClass MqttBackfill;
@@ -1,10 +1,18 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <ArduinoJson.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 #include <TimeoutHelper.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define HASS_DISCOVERY_STEP_INTERVAL 100 // ms, minimum time between two steps of a discovery pass
+#define HASS_RETAINED_SEED_TIME 2000 // ms to receive the retained configs from the broker after connecting
+#define HASS_RETAINED_SEED_MAX 1024 // maximum number of retained configs taken from the broker
 
 // mqtt discovery device classes
 enum DeviceClassType {
@@ -62,33 +70,62 @@ const byteAssign_fieldDeviceClass_t deviceFieldAssignment[] = {
 };
 #define DEVICE_CLS_ASSIGN_LIST_LEN (sizeof(deviceFieldAssignment) / sizeof(byteAssign_fieldDeviceClass_t))
 
+// Values of the last complete discovery pass
+struct HassDiscoveryStats_t {
+    uint32_t Published; // config documents sent to the broker
+    uint32_t Unchanged; // config documents skipped because the retained one is the same
+    uint32_t Bytes; // topics and payloads sent to the broker
+    uint32_t HeapPeak; // approximate maximum heap used by a step of the pass, includes allocations of other tasks meanwhile
+    uint32_t Duration; // ms
+};
+
 class MqttHandleHassClass {
 public:
     MqttHandleHassClass();
     void init(Scheduler& scheduler);
-    void publishConfig();
     void forceUpdate();
 
+    HassDiscoveryStats_t getDiscoveryStats() const;
+
 private:
     void loop();
-    static void publish(const String& subtopic, const String& payload);
-    static void publish(const String& subtopic, const JsonDocument& doc);
+    void onConfigChange(const ConfigDiff_t& diff);
+
+    // The retained configs on the broker are received after connecting, so an unchanged
+    // config is not published again with every reconnect
+    void startSeeding();
+    void stopSeeding(const bool merge);
+    void onRetainedConfig(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len);
+
+    // A discovery pass is published in steps: the DTU, then for every inverter its common entities
+    // and one step per channel. The next step is started once the MQTT outbox is empty.
+    void startDiscovery();
+    void publishDiscoveryStep();
+    void publishDtuConfig();
+    bool publishInverterConfig(std::shared_ptr<InverterAbstract> inv, const uint8_t part); // returns false if there is no such part
+
+    void publish(const String& subtopic, const String& payload);
+    void publish(const String& subtopic, const JsonDocument& doc);
 
     static void addCommonMetadata(JsonDocument& doc, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
 
     // Binary Sensor
-    static void publishBinarySensor(JsonDocument& doc, const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
-    static void publishDtuBinarySensor(const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
-    static void publishInverterBinarySensor(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
+    void publishBinarySensor(JsonDocument& doc, const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category, const String& value_template = "");
+    void publishDtuBinarySensor(const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
+    void publishInverterBinarySensor(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& payload_on, const String& payload_off, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
 
     // Sensor
-    static void publishSensor(JsonDocument& doc, const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
-    static void publishDtuSensor(const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
-    static void publishInverterSensor(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
+    void publishSensor(JsonDocument& doc, const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category, const String& value_template = "");
+    void publishDtuSensor(const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
+    void publishInverterSensor(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& unit_of_measure, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
 
-    static void publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear = false);
-    static void publishInverterButton(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& payload, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
-    static void publishInverterNumber(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& command_topic, const int16_t min, const int16_t max, float step, const String& unit_of_measure, const String& icon, const StateClassType state_class, const CategoryType category);
+    void publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear = false);
+    void publishInverterButton(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& payload, const String& icon, const DeviceClassType device_class, const StateClassType state_class, const CategoryType category);
+    void publishInverterNumber(std::shared_ptr<InverterAbstract> inv, const String& name, const String& state_topic, const String& command_topic, const int16_t min, const int16_t max, float step, const String& unit_of_measure, const String& icon, const StateClassType state_class, const CategoryType category);
+
+    // Returns the state topic of a value of the inverter below the MQTT prefix. In aggregated mode this is
+    // the topic of the document and value_template selects the value from the document.
+    static String getInverterStateTopic(std::shared_ptr<InverterAbstract> inv, const String& path, String& value_template);
 
     static void createInverterInfo(JsonDocument& doc, std::shared_ptr<InverterAbstract> inv);
     static void createDtuInfo(JsonDocument& doc);
@@ -100,9 +137,42 @@ private:
 
     Task _loopTask;
     TimeoutHelper _publishConfigTimeout;
+    TimeoutHelper _discoveryStepTimeout;
 
     bool _wasConnected = false;
     bool _updateForced = false;
+
+    // Position of the running discovery pass
+    bool _discoveryActive = false;
+    int16_t _discoveryInverter = -1; // -1 is the DTU
+    uint8_t _discoveryPart = 0;
+
+    // Last config document retained on the broker for every topic, taken from the broker with every connection
+    struct RetainedConfig_t {
+        uint32_t TopicHash;
+        uint32_t PayloadHash;
+    };
+    std::vector<RetainedConfig_t> _retainedConfigs; // sorted by TopicHash
+
+    // Retained configs received from the broker, filled by the MQTT task
+    bool _seeding = false;
+    String _seedTopic;
+    TimeoutHelper _seedTimeout;
+    std::mutex _seedMutex;
+    std::vector<RetainedConfig_t> _seededConfigs;
+
+    // Counters of the running pass
+    HassDiscoveryStats_t _pass = {};
+    uint32_t _passStartMillis = 0;
+    uint32_t _stepStartFreeHeap = 0;
+    uint32_t _passStartDropped = 0; // messages dropped by the MQTT outbox at the start of the pass
+    bool _passIncomplete = false; // a config was not accepted by the MQTT outbox
+
+    std::atomic<uint32_t> _lastPublished { 0 };
+    std::atomic<uint32_t> _lastUnchanged { 0 };
+    std::atomic<uint32_t> _lastBytes { 0 };
+    std::atomic<uint32_t> _lastHeapPeak { 0 };
+    std::atomic<uint32_t> _lastDuration { 0 };
 };
 
 extern MqttHandleHassClass MqttHandleHass;
@@ -2,11 +2,14 @@
 #pragma once
 
 #include "Configuration.h"
+#include <ArduinoJson.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 #include <espMqttClient.h>
 #include <frozen/map.h>
 #include <frozen/string.h>
+#include <atomic>
+#include <vector>
 
 class MqttHandleInverterClass {
 public:
@@ -15,17 +18,100 @@ public:
 
     static String getTopic(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
 
+    // Path of the field below the serial, the same for the topic and the aggregated document
+    static String getFieldPath(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+
+    // Topic of the aggregated document if Mqtt.Aggregated is enabled. The document contains
+    // one object for every level of the single topics (e.g. {"status":{"reachable":1}}).
+    static String getJsonTopic(std::shared_ptr<InverterAbstract> inv);
+
     void subscribeTopics();
     void unsubscribeTopics();
 
+    // Values not published because they did not change
+    uint32_t getSuppressedCount() const;
+
+    // Time needed to publish all inverters in µs
+    uint32_t getLastLoopDuration() const;
+
 private:
+    // Values which are not a field of the statistics, the same order as staticTopics in the source
+    enum class StaticTopic : uint8_t {
+        Name,
+        TxRequest,
+        TxReRequest,
+        RxSuccess,
+        RxFailNothing,
+        RxFailPartial,
+        RxFailCorrupt,
+        Rssi,
+        BootloaderVersion,
+        FwBuildVersion,
+        FwBuildDateTime,
+        HwPartNumber,
+        HwVersion,
+        LimitRelative,
+        LimitAbsolute,
+        Reachable,
+        Producing,
+        LastUpdate,
+        Count,
+    };
+
+    struct FieldTopic_t {
+        ChannelType_t Type;
+        ChannelNum_t Channel;
+        FieldId_t Field;
+        char ChannelKey[4]; // first level below the serial
+        uint8_t NameOffset; // position of the last level in Topic
+        String Topic;
+    };
+
+    // Complete topics of an inverter, built once so that publishing does not allocate strings
+    struct InverterTopics_t {
+        uint64_t Serial = 0;
+        String Static[static_cast<uint8_t>(StaticTopic::Count)];
+        std::vector<FieldTopic_t> ChannelNames; // Field is unused
+        std::vector<FieldTopic_t> Fields;
+        String Json;
+    };
+
+    void onConfigChange(const ConfigDiff_t& diff);
     void loop();
-    void publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
+    const InverterTopics_t& getInverterTopics(const uint8_t pos, std::shared_ptr<InverterAbstract> inv);
+    void buildInverterTopics(InverterTopics_t& topics, std::shared_ptr<InverterAbstract> inv);
+
+    void publish(const char* topic, const char* payload);
+
+    // Only a change of payloadHash causes an already published payload to be sent again
+    void publish(const char* topic, const char* payload, const uint32_t payloadHash);
+    void publishStatic(JsonDocument* doc, const InverterTopics_t& topics, const StaticTopic topic, const char* value, const bool isText = false);
+
+    // Publishes the value to the topic or adds it to the document if doc is not null
+    void publishValue(JsonDocument* doc, const String& topic, const char* section, const char* key, const char* value, const bool isText);
 
     Task _loopTask;
 
     uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
 
+    std::vector<InverterTopics_t> _inverterTopics; // same order as the inverters
+
+    // Last published value of every topic if Mqtt.PublishOnChange is enabled
+    struct PublishedValue_t {
+        uint32_t TopicHash;
+        uint32_t PayloadHash;
+        uint32_t Millis;
+    };
+    std::vector<PublishedValue_t> _publishedValues; // sorted by TopicHash
+    uint32_t _publishedConnectCount = 0;
+    uint32_t _publishedDropped = 0; // messages dropped by the MQTT outbox
+    bool _publishedSettingsChanged = false;
+    bool _publishOnChange = false; // copied from the configuration by every loop
+    uint32_t _publishMaxAge = 0; // ms
+    uint32_t _topicsRevision = 0; // configuration revision of _inverterTopics
+    std::atomic<uint32_t> _suppressedCount { 0 };
+    std::atomic<uint32_t> _lastLoopDuration { 0 };
+
     FieldId_t _publishFields[14] = {
         FLD_UDC,
         FLD_IDC,
@@ -1,22 +1,56 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include "NetworkSettings.h"
 #include <MqttSubscribeParser.h>
 #include <Ticker.h>
+#include <TaskSchedulerDeclarations.h>
 #include <espMqttClient.h>
-#include <mutex>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+#define MQTT_OUTBOX_BUDGET 24576 // bytes of topics and payloads waiting in the outbox, allocated while MQTT is enabled
+#define MQTT_OUTBOX_MAX_MESSAGES 256 // messages waiting in the outbox, allocated while MQTT is enabled
+#define MQTT_OUTBOX_INDEX_SIZE 512 // slots of the topic index, a power of two of at least twice MQTT_OUTBOX_MAX_MESSAGES
+#define MQTT_OUTBOX_MAX_PENDING 16 // messages handed to the client but not yet sent or acknowledged
+#define MQTT_OUTBOX_DRAIN_INTERVAL 20 // ms
+
+// Messages of a higher priority are handed to the client first and are evicted last
+enum class MqttPriority : uint8_t {
+    High, // LWT
+    Normal, // inverter values
+    Low, // diagnostics and Home Assistant discovery
+};
+#define MQTT_PRIORITY_COUNT 3
+
+struct MqttOutboxStats_t {
+    size_t Messages; // waiting in the outbox
+    size_t Bytes;
+    size_t Pending; // handed to the client but not yet sent or acknowledged
+    uint32_t Dropped; // did not fit into MQTT_OUTBOX_BUDGET or MQTT_OUTBOX_MAX_MESSAGES
+    uint32_t Coalesced; // replaced by a newer payload of the same topic before being sent
+};
+
 class MqttSettingsClass {
 public:
     MqttSettingsClass();
-    void init();
+    void init(Scheduler& scheduler);
     void performReconnect();
     bool getConnected();
-    void publish(const String& subtopic, const String& payload);
-    void publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0);
+
+    // Messages are queued in the outbox and handed to the client as long as it has less than
+    // MQTT_OUTBOX_MAX_PENDING messages in flight. A queued message is replaced by a newer one of the same topic.
+    // Returns false if the message did not fit into the outbox, there is no client or MQTT is disabled.
+    bool publish(const String& subtopic, const String& payload, const MqttPriority priority = MqttPriority::Normal);
+    bool publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0, const MqttPriority priority = MqttPriority::Normal);
+    bool publishGeneric(const char* topic, const char* payload, const bool retain, const uint8_t qos = 0, const MqttPriority priority = MqttPriority::Normal);
+
+    // Publishes to a topic which already contains the prefix, the payload is not trimmed
+    bool publishTopic(const char* topic, const char* payload, const MqttPriority priority = MqttPriority::Normal);
 
     void subscribe(const String& topic, const uint8_t qos, const OnMessageCallback& cb);
     void unsubscribe(const String& topic);
@@ -24,8 +58,43 @@ public:
     String getPrefix() const;
     String getClientId() const;
 
+    // Messages passed to the client, used to report the message rate to the broker
+    uint32_t getPublishCount();
+    uint32_t getPublishRate(); // messages per minute, measured over the last complete minute
+
+    // Incremented with every established connection
+    uint32_t getConnectCount() const;
+
+    MqttOutboxStats_t getOutboxStats();
+
 private:
+    // Topic and payload of a message are stored null terminated at Offset in _outboxArena.
+    // Entries are kept in the order of their arena regions, so compacting the arena keeps the order.
+    struct OutboxEntry_t {
+        uint32_t TopicHash;
+        uint16_t Offset;
+        uint16_t Capacity; // bytes reserved in the arena
+        uint16_t TopicLength;
+        uint16_t PayloadLength;
+        uint8_t Priority; // MqttPriority, MQTT_PRIORITY_COUNT if the entry was sent or evicted
+        bool Retain;
+        uint8_t Qos;
+    };
+
+    void loopOutbox();
+    void allocateOutbox(const bool enabled); // requires _clientLock
+    void drainOutbox(); // requires _clientLock
+    OutboxEntry_t* findEntry(const char* topic, const size_t topicLength, const uint32_t topicHash, const MqttPriority priority); // requires _clientLock
+    void indexEntry(const size_t position); // requires _clientLock
+    void rebuildIndex(); // requires _clientLock
+    bool makeRoom(const size_t size, const MqttPriority priority); // requires _clientLock
+    void removeEntry(OutboxEntry_t& entry); // requires _clientLock
+    void purgeEntries(); // requires _clientLock
+    void compactArena(); // requires _clientLock
+    void countPublish(); // requires _clientLock
+
     void NetworkEvent(network_event event);
+    void onConfigChange(const ConfigDiff_t& diff);
 
     void onMqttDisconnect(espMqttClientTypes::DisconnectReason reason);
     void onMqttConnect(const bool sessionPresent);
@@ -37,10 +106,31 @@ private:
     void createMqttClientObject();
 
     MqttClient* _mqttClient = nullptr;
+    std::shared_ptr<const CONFIG_T> _clientConfig; // referenced by _mqttClient
+    std::atomic<bool> _retain { false }; // of the current session, used for every publish
+    String _willTopic;
+    String _clientId;
     Ticker _mqttReconnectTimer;
     std::map<String, std::vector<uint8_t>> _fragments;
     MqttSubscribeParser _mqttSubscribeParser;
     std::mutex _clientLock;
+    Task _outboxTask;
+
+    // Protected by _clientLock
+    std::vector<uint8_t> _outboxArena;
+    size_t _outboxArenaEnd = 0; // new messages are stored behind this position
+    std::vector<OutboxEntry_t> _outbox; // oldest first, all priorities
+    std::vector<uint16_t> _outboxIndex; // open addressing by TopicHash, position in _outbox + 1, 0 if unused
+    size_t _outboxCount = 0; // entries not yet sent or evicted
+    size_t _outboxBytes = 0;
+    uint32_t _outboxDropped = 0;
+    uint32_t _outboxCoalesced = 0;
+    uint32_t _publishCount = 0;
+    uint32_t _publishRate = 0;
+    uint32_t _rateWindowStart = 0;
+    uint32_t _rateWindowCount = 0;
+
+    std::atomic<uint32_t> _connectCount { 0 };
 };
 
 extern MqttSettingsClass MqttSettings;
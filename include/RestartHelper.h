@@ -9,10 +9,14 @@ public:
     void init(Scheduler& scheduler);
     void triggerRestart();
 
+    // Removes all files (except the pin mapping) and restarts without saving anything
+    void triggerFactoryReset();
+
 private:
     void loop();
 
     Task _rebootTask;
+    bool _factoryReset = false;
 };
 
 extern RestartHelperClass RestartHelper;
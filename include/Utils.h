@@ -5,6 +5,11 @@
 #include <LittleFS.h>
 #include <cstdint>
 
+// LittleFS space which is kept free for the configuration. Caches, logs and histories
+// must not use it, so a full file system cannot prevent saving the configuration.
+#define LITTLEFS_CONFIG_RESERVE (16 * 1024)
+#define LITTLEFS_BLOCK_SIZE 4096
+
 class Utils {
 public:
     static uint32_t getChipId();
@@ -12,6 +17,7 @@ public:
     static int getTimezoneOffset();
     static bool checkJsonAlloc(const JsonDocument& doc, const char* function, const uint16_t line);
     static void removeAllFiles();
+    static bool hasFreeSpace(const size_t bytes, const bool useReserve = false);
     static String generateMd5FromFile(String file);
     static void skipBom(File& f);
 };
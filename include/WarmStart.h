@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <vector>
+
+#define WARMSTART_DIR "/warmstart"
+#define WARMSTART_FILE_MAGIC 0x57534e31 // "WSN1"
+#define WARMSTART_FILE_VERSION 1
+
+#define WARMSTART_CHECKPOINT_INTERVAL (10 * 60 * 1000) // ms
+
+class WarmStartClass {
+public:
+    WarmStartClass();
+    void init(Scheduler& scheduler);
+
+    // Writes the statistics of all inverters which changed since the last checkpoint. Called before a restart.
+    void checkpoint();
+
+private:
+    struct __attribute__((packed)) SnapshotFile_t {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t timestamp; // epoch seconds, 0 if the time was not valid
+        uint32_t rxFailureCount;
+        uint8_t statisticLength;
+        uint8_t statistic[STATISTIC_PACKET_SIZE];
+        float yieldDayOffset[CH_CNT];
+        float lastYieldDay[CH_CNT];
+    };
+
+    struct InverterState_t {
+        uint64_t serial = 0;
+        uint32_t lastUpdate = 0; // statistics update contained in the last checkpoint
+        bool yieldPending = false; // yield day correction waits for a valid time
+        uint32_t timestamp = 0;
+        float yieldDayOffset[CH_CNT] = {};
+        float lastYieldDay[CH_CNT] = {};
+    };
+
+    void loop();
+
+    void restore(InverterState_t& state, std::shared_ptr<InverterAbstract> inv);
+    void restoreYieldDayCorrection(InverterState_t& state, std::shared_ptr<InverterAbstract> inv);
+    void write(InverterState_t& state, std::shared_ptr<InverterAbstract> inv);
+
+    static String getFileName(const uint64_t serial);
+
+    Task _loopTask;
+
+    uint32_t _lastCheckpoint = 0;
+    std::vector<InverterState_t> _states;
+};
+
+extern WarmStartClass WarmStart;
@@ -1,14 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "WebApi_admission.h"
 #include "WebApi_device.h"
 #include "WebApi_devinfo.h"
 #include "WebApi_dtu.h"
+#include "WebApi_energy.h"
 #include "WebApi_errors.h"
 #include "WebApi_eventlog.h"
 #include "WebApi_file.h"
 #include "WebApi_firmware.h"
 #include "WebApi_gridprofile.h"
+#include "WebApi_history.h"
 #include "WebApi_i18n.h"
 #include "WebApi_inverter.h"
 #include "WebApi_limit.h"
@@ -20,6 +23,7 @@
 #include "WebApi_power.h"
 #include "WebApi_prometheus.h"
 #include "WebApi_security.h"
+#include "WebApi_sse_live.h"
 #include "WebApi_sysstatus.h"
 #include "WebApi_webapp.h"
 #include "WebApi_ws_console.h"
@@ -27,6 +31,16 @@
 #include <AsyncJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <functional>
+
+// Parts rendered by one call of the chunk callback if they are empty, so the TCP task is not blocked
+#define WEBAPI_CHUNKED_MAX_PARTS_PER_CALL 8
+
+// Writes part number `part` of a chunked response body into `out`.
+// Returns false after the last part has been written.
+// With gzip enabled, `out` compresses everything written to it.
+// Throws std::bad_alloc if the part cannot be rendered completely.
+using ChunkedPartGenerator = std::function<bool(Print& out, const size_t part)>;
 
 class WebApiClass {
 public:
@@ -37,24 +51,29 @@ public:
     static bool checkCredentials(AsyncWebServerRequest* request);
     static bool checkCredentialsReadonly(AsyncWebServerRequest* request);
 
-    static void sendTooManyRequests(AsyncWebServerRequest* request);
+    static void sendTooManyRequests(AsyncWebServerRequest* request, const uint16_t retryAfter = 60);
 
     static void writeConfig(JsonVariant& retMsg, const WebApiError code = WebApiError::GenericSuccess, const String& message = "Settings saved!");
 
     static bool parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document);
     static uint64_t parseSerialFromRequest(AsyncWebServerRequest* request, String param_name = "inv");
+    static bool acceptsEncoding(AsyncWebServerRequest* request, const char* encoding);
     static bool sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line);
+    static void sendChunkedResponse(AsyncWebServerRequest* request, const char* contentType, ChunkedPartGenerator&& generator, const bool gzip = false);
 
 private:
     AsyncWebServer _server;
 
+    WebApiAdmissionClass _webApiAdmission;
     WebApiDeviceClass _webApiDevice;
     WebApiDevInfoClass _webApiDevInfo;
     WebApiDtuClass _webApiDtu;
+    WebApiEnergyClass _webApiEnergy;
     WebApiEventlogClass _webApiEventlog;
     WebApiFileClass _webApiFile;
     WebApiFirmwareClass _webApiFirmware;
     WebApiGridProfileClass _webApiGridprofile;
+    WebApiHistoryClass _webApiHistory;
     WebApiI18nClass _webApiI18n;
     WebApiInverterClass _webApiInverter;
     WebApiLimitClass _webApiLimit;
@@ -66,6 +85,7 @@ private:
     WebApiPowerClass _webApiPower;
     WebApiPrometheusClass _webApiPrometheus;
     WebApiSecurityClass _webApiSecurity;
+    WebApiSseLiveClass _webApiSseLive;
     WebApiSysstatusClass _webApiSysstatus;
     WebApiWebappClass _webApiWebapp;
     WebApiWsConsoleClass _webApiWsConsole;
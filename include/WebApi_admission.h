@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define WEBAPI_ADMISSION_MAX_INFLIGHT 8
+#define WEBAPI_ADMISSION_HEAP_RESERVE (8 * 1024) // always keep this amount of contiguous heap for the rest of the system
+#define WEBAPI_ADMISSION_MAX_ENDPOINTS 48
+#define WEBAPI_ADMISSION_RETRY_AFTER 5
+#define WEBAPI_ADMISSION_SAMPLE_INTERVAL 20 // ms between samples of the free heap while requests are in flight
+
+class WebApiAdmissionClass {
+public:
+    WebApiAdmissionClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    struct EndpointStats_t {
+        uint32_t requests = 0;
+        uint32_t rejected = 0;
+        // Approximate, the free heap also changes by allocations of other tasks
+        uint32_t estimatedHeap = 0; // decaying peak of the heap used by a request of this endpoint
+        uint32_t peakHeap = 0;
+        uint32_t lastHeap = 0;
+    };
+
+    // Holds the in flight slot of a request until the request is destroyed. Meanwhile the lowest
+    // free heap is recorded, so streamed responses are charged for the memory they allocate while sending.
+    class InFlightGuard {
+    public:
+        // Requires _mutex
+        InFlightGuard(WebApiAdmissionClass& admission, EndpointStats_t& stats);
+        ~InFlightGuard();
+        InFlightGuard(const InFlightGuard&) = delete;
+        InFlightGuard& operator=(const InFlightGuard&) = delete;
+
+        uint32_t freeBefore;
+        uint32_t minFree;
+
+    private:
+        WebApiAdmissionClass& _admission;
+        EndpointStats_t& _stats;
+    };
+
+    void onAdmissionStatus(AsyncWebServerRequest* request);
+    void onRequest(AsyncWebServerRequest* request, ArMiddlewareNext next);
+    void sampleHeap();
+
+    EndpointStats_t& getStats(const String& url);
+
+    Task _sampleTask;
+
+    std::map<String, EndpointStats_t> _stats;
+    std::vector<InFlightGuard*> _guards;
+    uint32_t _inFlight = 0;
+    uint32_t _peakInFlight = 0;
+    uint32_t _rejected = 0;
+
+    std::mutex _mutex;
+};
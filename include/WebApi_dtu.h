@@ -6,13 +6,9 @@
 
 class WebApiDtuClass {
 public:
-    WebApiDtuClass();
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
     void onDtuAdminGet(AsyncWebServerRequest* request);
     void onDtuAdminPost(AsyncWebServerRequest* request);
-
-    Task _applyDataTask;
-    void applyDataTaskCb();
 };
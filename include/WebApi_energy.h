@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+#define ENERGY_DEFAULT_COUNT 24
+#define ENERGY_MAX_COUNT 400
+
+class WebApiEnergyClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    void onEnergyData(AsyncWebServerRequest* request);
+};
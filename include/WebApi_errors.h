@@ -64,6 +64,7 @@ enum WebApiError {
     MqttLwtQos,
     MqttClientIdLength,
     MqttHassTopicTrailingSlash,
+    MqttPublishMaxAge,
 
     NetworkBase = 8000,
     NetworkIpInvalid,
@@ -2,12 +2,19 @@
 #pragma once
 
 #include <ESPAsyncWebServer.h>
+#include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 
+#define EVENTLOG_HISTORY_DEFAULT_LIMIT 50
+#define EVENTLOG_HISTORY_MAX_LIMIT 200
+
 class WebApiEventlogClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
     void onEventlogStatus(AsyncWebServerRequest* request);
+    void onEventlogHistory(AsyncWebServerRequest* request);
+
+    static AlarmMessageLocale_t parseLocale(AsyncWebServerRequest* request);
 };
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "History.h"
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+#define HISTORY_DEFAULT_RANGE (24 * 60 * 60)
+#define HISTORY_DEFAULT_POINTS 300
+#define HISTORY_MAX_POINTS 1000
+#define HISTORY_EXPORT_SAMPLES 15 // samples rendered per response part
+
+class WebApiHistoryClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    enum ExportFormat_t {
+        EXPORT_CSV = 0,
+        EXPORT_LINE_PROTOCOL,
+        EXPORT_NDJSON,
+    };
+
+    void onHistoryData(AsyncWebServerRequest* request);
+    void onHistoryExport(AsyncWebServerRequest* request);
+
+    static void printSample(Print& out, const ExportFormat_t format, const char* serial, const uint32_t timestamp, const uint8_t seriesCount, const HistorySeries_t* series, const float* values);
+};
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -9,6 +10,8 @@ public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
+    static void generateInverterJsonResponse(JsonObject& obj, const uint8_t id);
+
     void onInverterList(AsyncWebServerRequest* request);
     void onInverterAdd(AsyncWebServerRequest* request);
     void onInverterEdit(AsyncWebServerRequest* request);
@@ -1,21 +1,76 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
+#include <StreamString.h>
 #include <TaskSchedulerDeclarations.h>
-#include <map>
+#include <mutex>
+#include <vector>
+
+#define PROMETHEUS_CACHE_MAX_AGE (60 * 1000) // release the cache if nobody scraped for a minute
+#define PROMETHEUS_INVERTER_CACHE_MAX_SIZE (8 * 1024) // larger inverter blocks are rendered on every scrape instead of being kept
 
 class WebApiPrometheusClass {
 public:
+    WebApiPrometheusClass();
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
     void onPrometheusMetricsGet(AsyncWebServerRequest* request);
 
-    void addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
+    void generateSystemMetrics(Print& out);
+
+    // Families of the inverter metrics in the order of the response
+    enum InverterFamily_t : uint8_t {
+        LAST_UPDATE = 0,
+        LIMIT_RELATIVE,
+        LIMIT_ABSOLUTE,
+        PANEL_INFO,
+        MAX_POWER,
+        YIELD_TOTAL_OFFSET,
+        FIELD_FAMILIES, // one family per field name follows
+    };
+
+    struct Family_t {
+        String Name;
+        const char* Help; // nullptr for field families, their help is the unit
+        const char* Type;
+        const char* Field; // name of the field for field families
+    };
+
+    // Samples of one inverter, grouped by family. The last update changes with every poll and
+    // is therefore not part of it.
+    struct InverterBlock_t {
+        uint64_t Serial = 0;
+        uint8_t Position = 0;
+        uint32_t Signature = 0;
+        bool Valid = false; // false if the block exceeded PROMETHEUS_INVERTER_CACHE_MAX_SIZE
+        StreamString Text;
+        std::vector<uint16_t> Offsets; // start of every family in Text followed by the end
+    };
+
+    void buildFamilies();
+
+    // Renders the blocks of all inverters whose data changed. Requires _mutex.
+    void updateInverterBlocks();
+    void renderBlock(InverterBlock_t& block, std::shared_ptr<InverterAbstract> inv, const uint8_t position, const uint32_t signature);
+    void renderFamily(Print& out, std::shared_ptr<InverterAbstract> inv, const uint8_t position, const size_t family);
+    void printFamily(Print& out, const size_t family, const std::vector<String>& families, const String& serialLabel);
+    uint32_t getInverterSignature(std::shared_ptr<InverterAbstract> inv, const uint8_t position) const;
+    static String getLabels(std::shared_ptr<InverterAbstract> inv, const uint8_t position);
+    const char* getFieldUnit(const char* family) const;
+    void releaseCache();
+
+    static void printFiltered(Print& out, const char* text, const size_t length, const std::vector<String>& families, const String& serialLabel);
+
+    Task _cacheTask;
 
-    void addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+    std::vector<Family_t> _families;
+    std::vector<InverterBlock_t> _blocks; // same order as the inverters
+    uint32_t _lastScrape = 0;
+    std::mutex _mutex;
 
     enum MetricType_t {
         NONE = 0,
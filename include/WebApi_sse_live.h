@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Configuration.h"
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <mutex>
+
+#define SSE_LIVE_MAX_CLIENTS 4
+#define SSE_LIVE_RECONNECT (5 * 1000)
+
+// Event ids consist of a random epoch in the upper bits and a counter in the lower bits.
+// A new epoch is chosen at boot and when the counter overflows.
+#define SSE_LIVE_COUNTER_BITS 20
+#define SSE_LIVE_COUNTER_MASK ((1UL << SSE_LIVE_COUNTER_BITS) - 1)
+
+class WebApiSseLiveClass {
+public:
+    WebApiSseLiveClass();
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+    void reload();
+
+private:
+    void onConnect(AsyncEventSourceClient* client);
+    void onDisconnect(AsyncEventSourceClient* client);
+
+    static String generateInverterEvent(std::shared_ptr<InverterAbstract> inv);
+    static String generateTotalEvent();
+
+    void sendToClients(const String& message, const char* event, const uint32_t id);
+
+    uint32_t getEventId() const;
+    uint32_t nextEventId();
+    void startEpoch();
+
+    AsyncEventSource _events;
+    AsyncAuthenticationMiddleware _simpleDigestAuth;
+
+    uint32_t _epoch = 0;
+    uint32_t _eventCounter = 0;
+    uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    uint32_t _lastEventId[INV_MAX_COUNT] = { 0 };
+
+    std::mutex _mutex;
+
+    Task _sendDataTask;
+    void sendDataTaskCb();
+};
@@ -9,5 +9,24 @@ public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
-    void responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String& contentType, const String& contentEncoding, const uint8_t* content, size_t len);
+    struct WebappAsset_t {
+        const uint8_t* start;
+        const uint8_t* end;
+        String etag;
+    };
+
+    static WebappAsset_t makeAsset(const uint8_t* start, const uint8_t* end, const char* contentHash);
+
+    void responseAsset(AsyncWebServerRequest* request, const String& contentType, const WebappAsset_t& gzipAsset, const WebappAsset_t* brotliAsset = nullptr);
+    void responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String& contentType, const String& contentEncoding, const WebappAsset_t& asset, const bool varyEncoding = false);
+
+    WebappAsset_t _indexHtml;
+    WebappAsset_t _faviconIco;
+    WebappAsset_t _faviconPng;
+    WebappAsset_t _appJs;
+    WebappAsset_t _siteWebmanifest;
+#ifdef WEBAPP_HAS_BROTLI
+    WebappAsset_t _indexHtmlBr;
+    WebappAsset_t _appJsBr;
+#endif
 };
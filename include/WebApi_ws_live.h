@@ -6,6 +6,8 @@
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <map>
+#include <vector>
 
 class WebApiWsLiveClass {
 public:
@@ -13,22 +15,33 @@ public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
     void reload();
 
-private:
     static void generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateCommonJsonResponse(JsonVariant& root);
 
+private:
+    struct Subscription_t {
+        bool allInverters = true;
+        std::vector<uint64_t> serials; // only used if allInverters is false. Empty means totals only
+    };
+
     static void addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic = "");
     static void addTotalField(JsonObject& root, const String& name, const float value, const String& unit, const uint8_t digits);
 
     void onLivedataStatus(AsyncWebServerRequest* request);
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void onSubscribe(AsyncWebSocketClient* client, const uint8_t* data, const size_t len);
+
+    std::vector<uint32_t> getSubscribers(const uint64_t serial) const;
+    void sendToSubscribers(const std::vector<uint32_t>& clientIds, const String& buffer);
 
     AsyncWebSocket _ws;
     AsyncAuthenticationMiddleware _simpleDigestAuth;
 
     uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
 
+    std::map<uint32_t, Subscription_t> _subscriptions; // key is the websocket client id
+
     std::mutex _mutex;
 
     Task _wsCleanupTask;
@@ -81,6 +81,9 @@
 #define MQTT_LWT_QOS 2U
 #define MQTT_PUBLISH_INTERVAL 5U
 #define MQTT_CLEAN_SESSION true
+#define MQTT_PUBLISH_ON_CHANGE false
+#define MQTT_PUBLISH_MAX_AGE 300U
+#define MQTT_AGGREGATED false
 
 #define DTU_SERIAL 0x99978563412U
 #define DTU_POLL_INTERVAL 5U
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+#include "GzipPrint.h"
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <rom/miniz.h>
+
+// Less probes than the default of 128, the data is compressed while the response is sent
+#define GZIP_PRINT_DEFLATE_FLAGS 32
+
+GzipPrint::GzipPrint(Print& out)
+    : _out(out)
+{
+}
+
+GzipPrint::~GzipPrint()
+{
+    heap_caps_free(_compressor);
+}
+
+bool GzipPrint::begin()
+{
+    _compressor = heap_caps_malloc(sizeof(tdefl_compressor), MALLOC_CAP_SPIRAM);
+    if (_compressor == nullptr) {
+        return false;
+    }
+
+    // Raw deflate stream without zlib header, the gzip framing is written here
+    if (tdefl_init(static_cast<tdefl_compressor*>(_compressor), &GzipPrint::putBuffer, this, GZIP_PRINT_DEFLATE_FLAGS) != TDEFL_STATUS_OKAY) {
+        heap_caps_free(_compressor);
+        _compressor = nullptr;
+        return false;
+    }
+
+    // Deflate, no flags, no modification time, unknown OS
+    static const uint8_t header[10] = { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff };
+    _out.write(header, sizeof(header));
+    return true;
+}
+
+size_t GzipPrint::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t GzipPrint::write(const uint8_t* buffer, size_t size)
+{
+    if (_compressor == nullptr || _finished) {
+        return 0;
+    }
+
+    if (tdefl_compress_buffer(static_cast<tdefl_compressor*>(_compressor), buffer, size, TDEFL_NO_FLUSH) != TDEFL_STATUS_OKAY) {
+        return 0;
+    }
+
+    _crc = esp_rom_crc32_le(_crc, buffer, size);
+    _inputSize += size;
+    return size;
+}
+
+void GzipPrint::finish()
+{
+    if (_compressor == nullptr || _finished) {
+        return;
+    }
+    _finished = true;
+
+    tdefl_compress_buffer(static_cast<tdefl_compressor*>(_compressor), nullptr, 0, TDEFL_FINISH);
+    heap_caps_free(_compressor);
+    _compressor = nullptr;
+
+    // CRC32 and size of the uncompressed data, little endian
+    uint8_t trailer[8];
+    for (uint8_t i = 0; i < 4; i++) {
+        trailer[i] = (_crc >> (i * 8)) & 0xff;
+        trailer[4 + i] = (_inputSize >> (i * 8)) & 0xff;
+    }
+    _out.write(trailer, sizeof(trailer));
+}
+
+int GzipPrint::putBuffer(const void* buffer, int length, void* user)
+{
+    auto gzip = static_cast<GzipPrint*>(user);
+    return gzip->_out.write(static_cast<const uint8_t*>(buffer), length) == static_cast<size_t>(length);
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Print.h>
+#include <stdint.h>
+
+// Compresses everything written to it into a gzip stream which is written to the output.
+// Uses the deflate encoder (tdefl) of the miniz library in ROM. Its state needs about
+// 160 kB, so it is only allocated in PSRAM.
+class GzipPrint : public Print {
+public:
+    explicit GzipPrint(Print& out);
+    ~GzipPrint();
+
+    // Allocates the encoder and writes the gzip header. Returns false without PSRAM or if out of memory.
+    bool begin();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Compresses all remaining data and writes the gzip trailer
+    void finish();
+
+private:
+    static int putBuffer(const void* buffer, int length, void* user);
+
+    Print& _out;
+
+    void* _compressor = nullptr; // tdefl_compressor
+    uint32_t _crc = 0;
+    uint32_t _inputSize = 0;
+    bool _finished = false;
+};
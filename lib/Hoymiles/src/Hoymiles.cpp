@@ -69,6 +69,9 @@ void HoymilesClass::loop()
         if (iv->getEnablePolling() || iv->getEnableCommands()) {
             ESP_LOGI(TAG, "Fetch inverter: %s", iv->serialString().c_str());
 
+            // Data restored from cache is only revalidated if no other requests are waiting
+            const bool radioIdle = iv->getRadio()->getQueueSize() == 0;
+
             if (!iv->isReachable()) {
                 iv->sendChangeChannelRequest();
             }
@@ -110,6 +113,20 @@ void HoymilesClass::loop()
                         iv->sendDevInfoRequest();
                     }
                 }
+
+                // Revalidate cached data, one request per cycle until the inverter confirmed it
+                if (radioIdle && iv->Statistics()->getLastUpdate() > 0) {
+                    if (iv->DevInfo()->startRevalidation()) {
+                        ESP_LOGI(TAG, "Revalidate cached device info");
+                        iv->sendDevInfoRequest();
+                    } else if (iv->GridProfile()->startRevalidation()) {
+                        ESP_LOGI(TAG, "Revalidate cached grid profile");
+                        iv->sendGridOnProFileParaRequest();
+                    } else if (iv->SystemConfigPara()->startRevalidation()) {
+                        ESP_LOGI(TAG, "Revalidate cached limit");
+                        iv->sendSystemConfigParaRequest();
+                    }
+                }
             }
 
             // Set limit if required
@@ -135,6 +135,10 @@ void HoymilesRadio::handleReceivedPackage()
                 // Statistics: TX Requests
                 inv->RadioStats.TxRequestData++;
 
+                if (_firstRequestMillis == 0) {
+                    _firstRequestMillis = millis();
+                }
+
                 sendEsbPacket(*cmd);
             } else {
                 ESP_LOGE(TAG, "TX: Invalid inverter found");
@@ -149,6 +153,11 @@ bool HoymilesRadio::isInitialized() const
     return _isInitialized;
 }
 
+uint32_t HoymilesRadio::getFirstRequestMillis() const
+{
+    return _firstRequestMillis;
+}
+
 void HoymilesRadio::removeCommands(InverterAbstract* inv)
 {
     _commandQueue.removeAllEntriesForInverter(inv);
@@ -28,6 +28,9 @@ public:
     uint32_t getQueueSize() const;
     bool isInitialized() const;
 
+    // Returns the millis() timestamp of the first request sent, 0 if nothing was sent yet
+    uint32_t getFirstRequestMillis() const;
+
     void removeCommands(InverterAbstract* inv);
     uint8_t countSimilarCommands(std::shared_ptr<CommandAbstract> cmd);
 
@@ -88,6 +91,7 @@ protected:
     CommandQueue _commandQueue;
     bool _isInitialized = false;
     bool _busyFlag = false;
+    uint32_t _firstRequestMillis = 0;
 
     TimeoutHelper _rxTimeout;
 };
@@ -63,6 +63,16 @@ const char* InverterAbstract::name() const
     return _name;
 }
 
+void InverterAbstract::setConfigIndex(const uint8_t index)
+{
+    _configIndex = index;
+}
+
+uint8_t InverterAbstract::getConfigIndex() const
+{
+    return _configIndex;
+}
+
 bool InverterAbstract::isProducing()
 {
     float totalAc = 0;
@@ -36,6 +36,11 @@ public:
     const String& serialString() const;
     void setName(const char* name);
     const char* name() const;
+
+    // Position of the inverter in the configuration of the application, UINT8_MAX if unknown
+    void setConfigIndex(const uint8_t index);
+    uint8_t getConfigIndex() const;
+
     virtual String typeName() const = 0;
     virtual const byteAssign_t* getByteAssignment() const = 0;
     virtual uint8_t getByteAssignmentSize() const = 0;
@@ -122,6 +127,7 @@ private:
     serial_u _serial;
     String _serialString;
     char _name[MAX_NAME_LENGTH] = "";
+    uint8_t _configIndex = UINT8_MAX;
     fragment_t _rxFragmentBuffer[MAX_RF_FRAGMENT_COUNT];
     uint8_t _rxFragmentMaxPacketId = 0;
     uint8_t _rxFragmentLastPacketId = 0;
@@ -1,18 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
-#include <array>
 #include <cstdint>
 
 #define ALARM_LOG_ENTRY_COUNT 15
 #define ALARM_LOG_ENTRY_SIZE 12
 #define ALARM_LOG_PAYLOAD_SIZE (ALARM_LOG_ENTRY_COUNT * ALARM_LOG_ENTRY_SIZE + 4)
 
-#define ALARM_MSG_COUNT 131
-
 struct AlarmLogEntry_t {
     uint16_t MessageId;
-    String Message;
+    const char* Message; // points to a constant string, no need to free
     time_t StartTime;
     time_t EndTime;
 };
@@ -28,14 +25,6 @@ enum class AlarmMessageLocale_t {
     FR
 };
 
-typedef struct {
-    AlarmMessageType_t InverterType;
-    uint16_t MessageId;
-    const char* Message_en;
-    const char* Message_de;
-    const char* Message_fr;
-} AlarmMessage_t;
-
 class AlarmLogParser : public Parser {
 public:
     AlarmLogParser();
@@ -44,6 +33,7 @@ public:
 
     uint8_t getEntryCount() const;
     void getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN);
+    const char* getMessage(const uint16_t messageId, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN) const;
 
     void setLastAlarmRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastAlarmRequestSuccess() const;
@@ -51,8 +41,7 @@ public:
     void setMessageType(const AlarmMessageType_t type);
 
 private:
-    static int getTimezoneOffset();
-    String getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale) const;
+    int getTimezoneOffset();
 
     uint8_t _payloadAlarmLog[ALARM_LOG_PAYLOAD_SIZE];
     uint8_t _alarmLogLength = 0;
@@ -61,5 +50,8 @@ private:
 
     AlarmMessageType_t _messageType = AlarmMessageType_t::ALL;
 
-    static const std::array<const AlarmMessage_t, ALARM_MSG_COUNT> _alarmMessages;
+    // Cached result of getTimezoneOffset()
+    int _timezoneOffset = 0;
+    uint32_t _timezoneHour = 0;
+    char _timezoneName[64] = "";
 };
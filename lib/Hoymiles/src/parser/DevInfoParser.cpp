@@ -152,6 +152,22 @@ void DevInfoParser::setLastUpdateSimple(const uint32_t lastUpdate)
     setLastUpdate(lastUpdate);
 }
 
+std::vector<uint8_t> DevInfoParser::getRawDataAll() const
+{
+    HOY_SEMAPHORE_TAKE();
+    std::vector<uint8_t> ret(_payloadDevInfoAll, _payloadDevInfoAll + _devInfoAllLength);
+    HOY_SEMAPHORE_GIVE();
+    return ret;
+}
+
+std::vector<uint8_t> DevInfoParser::getRawDataSimple() const
+{
+    HOY_SEMAPHORE_TAKE();
+    std::vector<uint8_t> ret(_payloadDevInfoSimple, _payloadDevInfoSimple + _devInfoSimpleLength);
+    HOY_SEMAPHORE_GIVE();
+    return ret;
+}
+
 uint16_t DevInfoParser::getFwBuildVersion() const
 {
     HOY_SEMAPHORE_TAKE();
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
+#include <vector>
 
 #define DEV_INFO_SIZE 20
 
@@ -19,6 +20,9 @@ public:
     uint32_t getLastUpdateSimple() const;
     void setLastUpdateSimple(const uint32_t lastUpdate);
 
+    std::vector<uint8_t> getRawDataAll() const;
+    std::vector<uint8_t> getRawDataSimple() const;
+
     uint16_t getFwBuildVersion() const;
     time_t getFwBuildDateTime() const;
     String getFwBuildDateTimeStr() const;
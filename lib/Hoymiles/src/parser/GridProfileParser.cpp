@@ -20,6 +20,7 @@ ID   Source Addr   Target Addr   Idx  Profile ID   Profile Version   Section ID
 The number of values depends on the respective section and its version. After the last value of a section follows the next section id.
 */
 #include "GridProfileParser.h"
+#include <algorithm>
 #include <cstring>
 #include <esp_log.h>
 #include <frozen/map.h>
@@ -137,7 +138,7 @@ constexpr frozen::map<uint8_t, GridProfileItemDefinition_t, 0x42> itemDefinition
     { 0xff, make_value("Unknown Value", "", 1) },
 };
 
-const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParser::_profileValues = { {
+constexpr std::array<GridProfileValue_t, SECTION_VALUE_COUNT> profileValues = { {
     // Voltage (H/LVRT)
     // Version 0x00
     { 0x00, 0x00, 0x01 },
@@ -365,6 +366,64 @@ const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParse
     { 0xb0, 0x00, 0x38 },
 } };
 
+struct GridProfileSectionIndex_t {
+    uint8_t Section;
+    uint8_t Version;
+    uint8_t Start; // position of the first value in profileValues
+    uint8_t Size; // number of values
+};
+
+constexpr size_t countSections()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < profileValues.size(); i++) {
+        if (i == 0 || profileValues[i].Section != profileValues[i - 1].Section || profileValues[i].Version != profileValues[i - 1].Version) {
+            count++;
+        }
+    }
+    return count;
+}
+
+constexpr std::array<GridProfileSectionIndex_t, countSections()> buildSectionIndex()
+{
+    std::array<GridProfileSectionIndex_t, countSections()> index = {};
+    size_t count = 0;
+    for (size_t i = 0; i < profileValues.size(); i++) {
+        if (i == 0 || profileValues[i].Section != profileValues[i - 1].Section || profileValues[i].Version != profileValues[i - 1].Version) {
+            index[count++] = { profileValues[i].Section, profileValues[i].Version, static_cast<uint8_t>(i), 0 };
+        }
+        index[count - 1].Size++;
+    }
+    return index;
+}
+
+constexpr bool isSectionIndexSorted(const std::array<GridProfileSectionIndex_t, countSections()>& index)
+{
+    for (size_t i = 1; i < index.size(); i++) {
+        if ((index[i - 1].Section << 8 | index[i - 1].Version) >= (index[i].Section << 8 | index[i].Version)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// (section, version) -> (start, size), built at compile time from profileValues
+constexpr auto sectionIndex = buildSectionIndex();
+static_assert(isSectionIndexSorted(sectionIndex), "profileValues must be ordered by section and version");
+
+static const GridProfileSectionIndex_t* findSection(const uint8_t section_id, const uint8_t section_version)
+{
+    auto it = std::lower_bound(sectionIndex.begin(), sectionIndex.end(), (section_id << 8 | section_version),
+        [](const GridProfileSectionIndex_t& entry, const uint16_t key) {
+            return (entry.Section << 8 | entry.Version) < key;
+        });
+
+    if (it == sectionIndex.end() || it->Section != section_id || it->Version != section_version) {
+        return nullptr;
+    }
+    return &*it;
+}
+
 GridProfileParser::GridProfileParser()
     : Parser()
 {
@@ -417,79 +476,57 @@ std::vector<uint8_t> GridProfileParser::getRawData() const
     return ret;
 }
 
-std::list<GridProfileSection_t> GridProfileParser::getProfile() const
+bool GridProfileParser::visitSection(const uint8_t index, const GridProfileSectionVisitor& sectionVisitor, const GridProfileItemVisitor& itemVisitor) const
 {
-    std::list<GridProfileSection_t> l;
-
-    if (_gridProfileLength > 4) {
-        uint16_t pos = 4;
-        do {
-            const uint8_t section_id = _payloadGridProfile[pos];
-            const uint8_t section_version = _payloadGridProfile[pos + 1];
-            const int16_t section_start = getSectionStart(section_id, section_version);
-            const uint8_t section_size = getSectionSize(section_id, section_version);
-            pos += 2;
+    // Work on a copy so the visitors are not called while holding the semaphore
+    uint8_t payload[GRID_PROFILE_SIZE];
+    HOY_SEMAPHORE_TAKE();
+    const uint8_t length = _gridProfileLength;
+    memcpy(payload, _payloadGridProfile, GRID_PROFILE_SIZE);
+    HOY_SEMAPHORE_GIVE();
 
-            GridProfileSection_t section;
-            try {
-                section.SectionName = profileSection.at(section_id).data();
-            } catch (const std::out_of_range&) {
-                section.SectionName = "Unknown";
-                break;
-            }
+    uint16_t pos = 4;
+    for (uint8_t current = 0; pos + 1 < length; current++) {
+        const uint8_t section_id = payload[pos];
+        const uint8_t section_version = payload[pos + 1];
+        pos += 2;
+
+        auto sectionName = profileSection.find(section_id);
+        auto section = findSection(section_id, section_version);
+        if (sectionName == profileSection.end() || section == nullptr) {
+            // The size of unknown sections is unknown as well, so nothing behind can be decoded
+            return false;
+        }
 
-            if (section_start == -1) {
-                section.SectionName = "Unknown";
-                break;
-            }
+        if (current < index) {
+            pos += section->Size * 2;
+            continue;
+        }
 
-            for (uint8_t val_id = 0; val_id < section_size; val_id++) {
-                auto itemDefinition = itemDefinitions.at(_profileValues[section_start + val_id].ItemDefinition);
+        if (sectionVisitor) {
+            sectionVisitor(sectionName->second.data());
+        }
 
-                float value = static_cast<int16_t>((_payloadGridProfile[pos] << 8) | _payloadGridProfile[pos + 1]);
-                value /= itemDefinition.Divider;
+        for (uint8_t val_id = 0; val_id < section->Size && pos + 1 < length; val_id++) {
+            const auto& itemDefinition = itemDefinitions.at(profileValues[section->Start + val_id].ItemDefinition);
 
-                GridProfileItem_t v;
-                v.Name = itemDefinition.Name.data();
-                v.Unit = itemDefinition.Unit.data();
-                v.Value = value;
-                section.items.push_back(v);
+            if (itemVisitor) {
+                float value = static_cast<int16_t>((payload[pos] << 8) | payload[pos + 1]);
+                value /= itemDefinition.Divider;
 
-                pos += 2;
+                itemVisitor(itemDefinition.Name.data(), itemDefinition.Unit.data(), value);
             }
 
-            l.push_back(section);
+            pos += 2;
+        }
 
-        } while (pos < _gridProfileLength);
+        return true;
     }
 
-    return l;
+    return false;
 }
 
 bool GridProfileParser::containsValidData() const
 {
     return _gridProfileLength > 6;
 }
-
-uint8_t GridProfileParser::getSectionSize(const uint8_t section_id, const uint8_t section_version)
-{
-    uint8_t count = 0;
-    for (auto& values : _profileValues) {
-        if (values.Section == section_id && values.Version == section_version) {
-            count++;
-        }
-    }
-    return count;
-}
-
-int16_t GridProfileParser::getSectionStart(const uint8_t section_id, const uint8_t section_version)
-{
-    int16_t count = -1;
-    for (auto& values : _profileValues) {
-        count++;
-        if (values.Section == section_id && values.Version == section_version) {
-            break;
-        }
-    }
-    return count;
-}
@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
-#include <list>
+#include <array>
+#include <functional>
+#include <vector>
 
 #define GRID_PROFILE_SIZE 141
 #define PROFILE_TYPE_COUNT 10
@@ -19,16 +21,9 @@ struct GridProfileValue_t {
     uint8_t ItemDefinition;
 };
 
-struct GridProfileItem_t {
-    String Name;
-    String Unit;
-    float Value;
-};
-
-struct GridProfileSection_t {
-    String SectionName;
-    std::list<GridProfileItem_t> items;
-};
+// Names and units point to constant strings
+using GridProfileSectionVisitor = std::function<void(const char* name)>;
+using GridProfileItemVisitor = std::function<void(const char* name, const char* unit, const float value)>;
 
 class GridProfileParser : public Parser {
 public:
@@ -41,17 +36,15 @@ public:
 
     std::vector<uint8_t> getRawData() const;
 
-    std::list<GridProfileSection_t> getProfile() const;
+    // Calls sectionVisitor and then itemVisitor for every value of the section at the given position
+    // of the profile. Returns false if there is no such section. Both visitors may be empty.
+    bool visitSection(const uint8_t index, const GridProfileSectionVisitor& sectionVisitor, const GridProfileItemVisitor& itemVisitor) const;
 
     bool containsValidData() const;
 
 private:
-    static uint8_t getSectionSize(const uint8_t section_id, const uint8_t section_version);
-    static int16_t getSectionStart(const uint8_t section_id, const uint8_t section_version);
-
     uint8_t _payloadGridProfile[GRID_PROFILE_SIZE] = {};
     uint8_t _gridProfileLength = 0;
 
     static const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> _profileTypes;
-    static const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> _profileValues;
 };
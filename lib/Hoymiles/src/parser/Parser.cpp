@@ -18,6 +18,27 @@ uint32_t Parser::getLastUpdate() const
 void Parser::setLastUpdate(const uint32_t lastUpdate)
 {
     _lastUpdate = lastUpdate;
+    _cached = false;
+}
+
+bool Parser::isCached() const
+{
+    return _cached;
+}
+
+void Parser::setCached(const bool cached)
+{
+    _cached = cached;
+    _revalidations = 0;
+}
+
+bool Parser::startRevalidation()
+{
+    if (!_cached || _revalidations >= PARSER_MAX_REVALIDATIONS) {
+        return false;
+    }
+    _revalidations++;
+    return true;
 }
 
 void Parser::beginAppendFragment()
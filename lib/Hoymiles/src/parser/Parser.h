@@ -3,6 +3,8 @@
 #include <Arduino.h>
 #include <cstdint>
 
+#define PARSER_MAX_REVALIDATIONS 5
+
 #define HOY_SEMAPHORE_TAKE() \
     do {                     \
     } while (xSemaphoreTake(_xSemaphore, portMAX_DELAY) != pdPASS)
@@ -23,9 +25,20 @@ public:
     void beginAppendFragment();
     void endAppendFragment();
 
+    // True if the data was restored from a cache and was not yet confirmed by the inverter.
+    // Cleared by every setLastUpdate() call.
+    bool isCached() const;
+    void setCached(const bool cached);
+
+    // Returns true if a request to confirm the cached data should be sent and counts it.
+    // Gives up after PARSER_MAX_REVALIDATIONS requests, e.g. if the inverter doesn't support it.
+    bool startRevalidation();
+
 protected:
     SemaphoreHandle_t _xSemaphore;
 
 private:
     uint32_t _lastUpdate = 0;
+    bool _cached = false;
+    uint8_t _revalidations = 0;
 };
\ No newline at end of file
@@ -78,6 +78,14 @@ void StatisticsParser::setByteAssignment(const byteAssign_t* byteAssignment, con
     }
 }
 
+std::vector<uint8_t> StatisticsParser::getRawData() const
+{
+    HOY_SEMAPHORE_TAKE();
+    std::vector<uint8_t> ret(_payloadStatistic, _payloadStatistic + _statisticLength);
+    HOY_SEMAPHORE_GIVE();
+    return ret;
+}
+
 uint8_t StatisticsParser::getExpectedByteCount()
 {
     return _expectedByteCount;
@@ -331,6 +339,11 @@ uint32_t StatisticsParser::getRxFailureCount() const
     return _rxFailureCount;
 }
 
+void StatisticsParser::setRxFailureCount(const uint32_t count)
+{
+    _rxFailureCount = count;
+}
+
 void StatisticsParser::zeroRuntimeData()
 {
     zeroFields(runtimeFields);
@@ -367,6 +380,21 @@ void StatisticsParser::setYieldDayCorrection(const bool enabled)
     _enableYieldDayCorrection = enabled;
 }
 
+float StatisticsParser::getLastYieldDay(const ChannelNum_t channel) const
+{
+    if (channel >= CH_CNT) {
+        return 0;
+    }
+    return _lastYieldDay[static_cast<uint8_t>(channel)];
+}
+
+void StatisticsParser::setLastYieldDay(const ChannelNum_t channel, const float value)
+{
+    if (channel < CH_CNT) {
+        _lastYieldDay[static_cast<uint8_t>(channel)] = value;
+    }
+}
+
 void StatisticsParser::zeroFields(const FieldId_t* fields)
 {
     // Loop all channels
@@ -3,6 +3,7 @@
 #include "Parser.h"
 #include <cstdint>
 #include <list>
+#include <vector>
 
 #define STATISTIC_PACKET_SIZE (7 * 16)
 
@@ -111,6 +112,8 @@ public:
 
     void setByteAssignment(const byteAssign_t* byteAssignment, const uint8_t size);
 
+    std::vector<uint8_t> getRawData() const;
+
     // Returns 1 based amount of expected bytes of statistic data
     uint8_t getExpectedByteCount();
 
@@ -139,6 +142,7 @@ public:
     void resetRxFailureCount();
     void incrementRxFailureCount();
     uint32_t getRxFailureCount() const;
+    void setRxFailureCount(const uint32_t count);
 
     void zeroRuntimeData();
     void zeroDailyData();
@@ -154,6 +158,10 @@ public:
     bool getYieldDayCorrection() const;
     void setYieldDayCorrection(const bool enabled);
 
+    // Last yield day value used to detect a reset of the inverter's daily counter
+    float getLastYieldDay(const ChannelNum_t channel) const;
+    void setLastYieldDay(const ChannelNum_t channel, const float value);
+
 private:
     void zeroFields(const FieldId_t* fields);
 
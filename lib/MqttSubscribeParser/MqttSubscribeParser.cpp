@@ -3,169 +3,153 @@
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
 #include "MqttSubscribeParser.h"
+#include <cstring>
 
 void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qos, const OnMessageCallback& cb)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+
     cb_filter_t cbf;
     cbf.topic = topic;
     cbf.qos = qos;
     cbf.cb = cb;
-    _callbacks.push_back(cbf);
+
+    auto callbacks = std::atomic_load(&_tree)->callbacks;
+    callbacks.push_back(cbf);
+    publish_tree(std::move(callbacks));
 }
 
 void MqttSubscribeParser::unregister_callback(const std::string& topic)
 {
-    for (auto it = _callbacks.begin(); it != _callbacks.end();) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto callbacks = std::atomic_load(&_tree)->callbacks;
+    for (auto it = callbacks.begin(); it != callbacks.end();) {
         if ((*it).topic == topic) {
-            it = _callbacks.erase(it);
+            it = callbacks.erase(it);
         } else {
             ++it;
         }
     }
+
+    publish_tree(std::move(callbacks));
 }
 
 void MqttSubscribeParser::handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len)
 {
-    bool result = false;
-    for (const auto& cb : _callbacks) {
-        if (mosquitto_topic_matches_sub(cb.topic.c_str(), topic, &result) == MOSQ_ERR_SUCCESS) {
-            if (result) {
-                cb.cb(properties, topic, payload, len);
-            }
-        }
+    if (topic == nullptr || topic[0] == 0) {
+        return;
     }
+
+    // Keeps the tree alive even if it is replaced while the callbacks are running
+    const auto tree = std::atomic_load(&_tree);
+    match(*tree, tree->root, topic, true, properties, topic, payload, len);
 }
 
 std::vector<cb_filter_t> MqttSubscribeParser::get_callbacks()
 {
-    return _callbacks;
+    return std::atomic_load(&_tree)->callbacks;
 }
 
-/* Does a topic match a subscription? */
-int MqttSubscribeParser::mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result)
+void MqttSubscribeParser::publish_tree(std::vector<cb_filter_t> callbacks)
 {
-    size_t spos;
-
-    if (!result)
-        return MOSQ_ERR_INVAL;
-    *result = false;
-
-    if (!sub || !topic || sub[0] == 0 || topic[0] == 0) {
-        return MOSQ_ERR_INVAL;
+    auto tree = std::make_shared<tree_t>();
+    tree->callbacks = std::move(callbacks);
+    for (size_t i = 0; i < tree->callbacks.size(); i++) {
+        insert(*tree, i);
     }
+    std::atomic_store(&_tree, std::shared_ptr<const tree_t>(std::move(tree)));
+}
 
-    if ((sub[0] == '$' && topic[0] != '$')
-        || (topic[0] == '$' && sub[0] != '$')) {
-
-        return MOSQ_ERR_SUCCESS;
+void MqttSubscribeParser::insert(tree_t& tree, const size_t index)
+{
+    const std::string& sub = tree.callbacks[index].topic;
+    if (sub.empty()) {
+        return;
     }
 
-    spos = 0;
+    topic_node_t* node = &tree.root;
+    size_t pos = 0;
+    while (true) {
+        const size_t end = sub.find('/', pos);
+        const std::string level = sub.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
 
-    while (sub[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
-        }
-        if (sub[0] != topic[0] || topic[0] == 0) { /* Check for wildcard matches */
-            if (sub[0] == '+') {
-                /* Check for bad "+foo" or "a/+foo" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for bad "foo+" or "foo+/a" subscription */
-                if (sub[1] != 0 && sub[1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                while (topic[0] != 0 && topic[0] != '/') {
-                    if (topic[0] == '+' || topic[0] == '#') {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    topic++;
-                }
-                if (topic[0] == 0 && sub[0] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else if (sub[0] == '#') {
-                /* Check for bad "foo#" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for # not the final character of the sub, e.g. "#foo" */
-                if (sub[1] != 0) {
-                    return MOSQ_ERR_INVAL;
-                } else {
-                    while (topic[0] != 0) {
-                        if (topic[0] == '+' || topic[0] == '#') {
-                            return MOSQ_ERR_INVAL;
-                        }
-                        topic++;
-                    }
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else {
-                /* Check for e.g. foo/bar matching foo/+/# */
-                if (topic[0] == 0
-                    && spos > 0
-                    && sub[-1] == '+'
-                    && sub[0] == '/'
-                    && sub[1] == '#') {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-
-                /* There is no match at this point, but is the sub invalid? */
-                while (sub[0] != 0) {
-                    if (sub[0] == '#' && sub[1] != 0) {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    spos++;
-                    sub++;
-                }
-
-                /* Valid input, but no match */
-                return MOSQ_ERR_SUCCESS;
+        if (level == "#") {
+            // '#' has to be the last level
+            if (end != std::string::npos) {
+                return;
+            }
+            if (!node->multi_level) {
+                node->multi_level.reset(new topic_node_t);
             }
+            node = node->multi_level.get();
+        } else if (level == "+") {
+            if (!node->single_level) {
+                node->single_level.reset(new topic_node_t);
+            }
+            node = node->single_level.get();
         } else {
-            /* sub[spos] == topic[tpos] */
-            if (topic[1] == 0) {
-                /* Check for e.g. foo matching foo/# */
-                if (sub[1] == '/'
-                    && sub[2] == '#'
-                    && sub[3] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
+            // Wildcards are only valid as a complete level
+            if (level.find_first_of("+#") != std::string::npos) {
+                return;
+            }
+            auto it = node->children.begin();
+            while (it != node->children.end() && it->level != level) {
+                ++it;
             }
-            spos++;
-            sub++;
-            topic++;
-            if (sub[0] == 0 && topic[0] == 0) {
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
-            } else if (topic[0] == 0 && sub[0] == '+' && sub[1] == 0) {
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
+            if (it == node->children.end()) {
+                node->children.emplace_back();
+                node->children.back().level = level;
+                it = node->children.end() - 1;
             }
+            node = &*it;
         }
+
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 1;
+    }
+
+    node->callbacks.push_back(index);
+}
+
+void MqttSubscribeParser::match(const tree_t& tree, const topic_node_t& node, const char* level, const bool first_level,
+    const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len)
+{
+    // Wildcards in the first level do not match topics starting with '$'
+    const bool wildcards = !(first_level && level != nullptr && level[0] == '$');
+
+    // '#' matches the remaining levels including none, e.g. "foo/#" matches "foo"
+    if (node.multi_level && wildcards) {
+        dispatch(tree, *node.multi_level, properties, topic, payload, len);
     }
-    if ((topic[0] != 0 || sub[0] != 0)) {
-        *result = false;
+
+    if (level == nullptr) {
+        dispatch(tree, node, properties, topic, payload, len);
+        return;
     }
-    while (topic[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+
+    const char* separator = strchr(level, '/');
+    const size_t level_len = separator != nullptr ? separator - level : strlen(level);
+    const char* next = separator != nullptr ? separator + 1 : nullptr;
+
+    for (const auto& child : node.children) {
+        if (child.level.length() == level_len && memcmp(child.level.data(), level, level_len) == 0) {
+            match(tree, child, next, false, properties, topic, payload, len);
+            break;
         }
-        topic++;
     }
 
-    return MOSQ_ERR_SUCCESS;
+    if (node.single_level && wildcards) {
+        match(tree, *node.single_level, next, false, properties, topic, payload, len);
+    }
+}
+
+void MqttSubscribeParser::dispatch(const tree_t& tree, const topic_node_t& node,
+    const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len)
+{
+    for (const size_t index : node.callbacks) {
+        tree.callbacks[index].cb(properties, topic, payload, len);
+    }
 }
@@ -3,6 +3,8 @@
 
 #include <cstdint>
 #include <espMqttClient.h>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -22,12 +24,31 @@ public:
     std::vector<cb_filter_t> get_callbacks();
 
 private:
-    int mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result);
-
-    std::vector<cb_filter_t> _callbacks;
+    // One node per topic level of the subscriptions. A message is matched by walking its
+    // levels down the tree, which does not allocate and does not depend on the number of subscriptions.
+    struct topic_node_t {
+        std::string level;
+        std::vector<topic_node_t> children; // exact levels
+        std::unique_ptr<topic_node_t> single_level; // '+'
+        std::unique_ptr<topic_node_t> multi_level; // '#'
+        std::vector<size_t> callbacks; // index in callbacks of the subscriptions ending at this node
+    };
 
-    enum mosq_err_t {
-        MOSQ_ERR_SUCCESS = 0,
-        MOSQ_ERR_INVAL = 3,
+    // Messages are handled on the MQTT client task while callbacks are (un)registered on the main
+    // loop. The tree is therefore never modified: changes build a new tree which replaces the old one,
+    // and handle_message keeps a reference to the tree it is walking.
+    struct tree_t {
+        std::vector<cb_filter_t> callbacks;
+        topic_node_t root;
     };
+
+    void publish_tree(std::vector<cb_filter_t> callbacks);
+    static void insert(tree_t& tree, const size_t index);
+    static void match(const tree_t& tree, const topic_node_t& node, const char* level, const bool first_level,
+        const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len);
+    static void dispatch(const tree_t& tree, const topic_node_t& node,
+        const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len);
+
+    std::mutex _mutex; // serializes the writers
+    std::shared_ptr<const tree_t> _tree = std::make_shared<const tree_t>();
 };
@@ -39,6 +39,8 @@ std::optional<uint8_t> SpiManager::to_arduino(spi_host_device_t host_device)
 
 bool SpiManager::register_bus(spi_host_device_t host_device)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     for (int i = 0; i < SPI_MANAGER_NUM_BUSES; ++i) {
         if (available_buses[i])
             continue;
@@ -52,6 +54,8 @@ bool SpiManager::register_bus(spi_host_device_t host_device)
 
 bool SpiManager::claim_bus(spi_host_device_t& host_device)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     for (int i = SPI_MANAGER_NUM_BUSES - 1; i >= 0; --i) {
         if (!available_buses[i])
             continue;
@@ -68,6 +72,8 @@ bool SpiManager::claim_bus(spi_host_device_t& host_device)
 
 std::optional<uint8_t> SpiManager::claim_bus_arduino()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     spi_host_device_t host_device;
     if (!claim_bus(host_device))
         return std::nullopt;
@@ -78,6 +84,8 @@ std::optional<uint8_t> SpiManager::claim_bus_arduino()
 
 spi_device_handle_t SpiManager::alloc_device(const std::string& bus_id, const std::shared_ptr<SpiBusConfig>& bus_config, spi_device_interface_config_t& device_config)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     std::shared_ptr<SpiBus> shared_bus = get_shared_bus(bus_id);
     if (!shared_bus)
         return nullptr;
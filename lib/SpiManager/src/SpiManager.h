@@ -8,6 +8,7 @@
 
 #include <array>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <utility>
 
@@ -36,6 +37,9 @@ private:
 
     std::array<std::optional<spi_host_device_t>, SPI_MANAGER_NUM_BUSES> available_buses;
     std::array<std::shared_ptr<SpiBus>, SPI_MANAGER_NUM_BUSES> shared_buses;
+
+    // Buses may be claimed from several tasks during startup
+    std::recursive_mutex mutex;
 };
 
 extern SpiManager SpiManagerInst;
@@ -0,0 +1,66 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Copyright (C) 2026 Thomas Basler and others
+#
+# Precomputes the ETags of all embedded webapp files so the firmware does not
+# have to hash them on every request. Brotli variants (*.br) listed in
+# board_build.embed_files are created by the webapp build. Environments which
+# list them serve index.html and app.js brotli compressed as well.
+#
+import hashlib
+import os
+import re
+import sys
+
+Import("env")
+
+
+def updateFileIfChanged(filename, content):
+    mustUpdate = True
+    try:
+        with open(filename, "rb") as fp:
+            if fp.read() == content:
+                mustUpdate = False
+    except:
+        pass
+    if mustUpdate:
+        with open(filename, "wb") as fp:
+            fp.write(content)
+    return mustUpdate
+
+
+def getEmbedFiles():
+    files = env.GetProjectOption("board_build.embed_files", "")
+    return [f.strip() for f in files.splitlines() if f.strip() != ""]
+
+
+def main():
+    lines = "/* Generated file within build process - Do NOT edit */\n"
+
+    files = getEmbedFiles()
+    missing = [f for f in files if not os.path.exists(os.path.join(env["PROJECT_DIR"], f))]
+    if len(missing) > 0:
+        sys.stderr.write("Error: Embedded webapp files not found: " + ", ".join(missing) + "\n")
+        sys.stderr.write("Build the webapp (yarn build in webapp/) or remove the files from board_build.embed_files\n")
+        env.Exit(1)
+
+    # The firmware references all brotli variants together
+    hasBrotli = any(f.endswith(".br") for f in files)
+
+    for file in files:
+        fullPath = os.path.join(env["PROJECT_DIR"], file)
+        with open(fullPath, "rb") as fp:
+            etag = hashlib.md5(fp.read()).hexdigest()
+
+        # Same naming scheme as the symbols created for the embedded file itself
+        symbol = re.sub(r"[^a-zA-Z0-9]", "_", file)
+        lines += 'const char *_etag_%s = "%s";\n' % (symbol, etag)
+
+    targetfile = os.path.join(env.subst("$BUILD_DIR"), "__compiled_webapp.c")
+    updateFileIfChanged(targetfile, bytes(lines, "utf-8"))
+    env.AppendUnique(PIOBUILDFILES=[targetfile])
+
+    if hasBrotli:
+        env.Append(CPPDEFINES=[("WEBAPP_HAS_BROTLI", 1)])
+
+main()
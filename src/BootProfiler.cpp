@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Records how long the stages of the startup took. The stages of setup() run one after another,
+stages running in a separate task (e.g. the radio initialization) are added when they finish
+and may overlap with them. All times are milliseconds since boot.
+*/
+#include "BootProfiler.h"
+#include <Arduino.h>
+#include <algorithm>
+
+#undef TAG
+static const char* TAG = "bootprofiler";
+
+BootProfilerClass BootProfiler;
+
+void BootProfilerClass::begin()
+{
+    _stageStart = 0;
+    endStage("startup");
+}
+
+void BootProfilerClass::init()
+{
+    using std::placeholders::_1;
+
+    NetworkSettings.onEvent(std::bind(&BootProfilerClass::onNetworkEvent, this, _1), network_event::NETWORK_GOT_IP);
+
+    if (NetworkSettings.isConnected()) {
+        onNetworkEvent(network_event::NETWORK_GOT_IP);
+    }
+}
+
+void BootProfilerClass::onNetworkEvent(network_event event)
+{
+    // Only the first IP counts
+    uint32_t expected = 0;
+    _gotIpMillis.compare_exchange_strong(expected, millis());
+}
+
+void BootProfilerClass::endStage(const char* name)
+{
+    const uint32_t now = millis();
+    addStage(name, _stageStart);
+    _stageStart = now;
+}
+
+void BootProfilerClass::addStage(const char* name, const uint32_t start)
+{
+    const uint32_t duration = millis() - start;
+    ESP_LOGD(TAG, "%s: %" PRIu32 " ms", name, duration);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stages.push_back({ name, start, duration });
+}
+
+void BootProfilerClass::setWebStarted()
+{
+    _webStartedMillis = millis();
+}
+
+uint32_t BootProfilerClass::getWebReadyMillis() const
+{
+    const uint32_t webStarted = _webStartedMillis;
+    const uint32_t gotIp = _gotIpMillis;
+    if (webStarted == 0 || gotIp == 0) {
+        return 0;
+    }
+    return std::max(webStarted, gotIp);
+}
+
+void BootProfilerClass::visitStages(const std::function<void(const Stage_t& stage)>& visitor) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& stage : _stages) {
+        visitor(stage);
+    }
+}
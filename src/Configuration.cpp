@@ -2,49 +2,94 @@
 /*
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
+
+/*
+The configuration is stored in sections, one MessagePack file per section in CONFIG_DIR.
+Every file starts with the CRC32 of its content. A save only rewrites the sections whose
+serialized content has changed, each one by writing a temporary file which is renamed
+afterwards. Saves are delayed by CONFIG_WRITE_DELAY to coalesce bursts of changes.
+
+The sections use the same keys as the JSON representation. CONFIG_FILENAME is only used
+to import a configuration written by older firmware versions or restored from a backup,
+and as the name of the JSON export.
+
+A WriteGuard compares the configuration before and after the change. The main loop passes
+the differences to the callbacks registered with onChange(), so subsystems only apply what
+actually changed instead of reinitializing (e.g. a new channel name does not reconnect MQTT).
+
+The configuration is published as immutable snapshots. A WriteGuard edits a private copy and
+its destructor publishes the copy, so readers never wait for a writer and never see a partial
+change. get() returns a reference counted snapshot. A superseded snapshot is released together
+with its last reader, so readers in other tasks (web handlers, radio init) can keep it as long
+as they need. get() is not lock free: std::atomic_load of a shared_ptr takes a short internal
+lock and changes the reference count. Code running for every value (e.g. MQTT publishing)
+fetches the snapshot once per loop or connection. The save counter changes with every save
+and is kept outside the snapshots.
+*/
 #include "Configuration.h"
 #include "NetworkSettings.h"
 #include "Utils.h"
 #include "defaults.h"
 #include <ArduinoJson.h>
+#include <Hoymiles.h>
 #include <LittleFS.h>
+#include <algorithm>
 #include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <iterator>
 #include <nvs_flash.h>
+#include <vector>
 
 #undef TAG
 static const char* TAG = "configuration";
 
-CONFIG_T config;
-
-static std::condition_variable sWriterCv;
 static std::mutex sWriterMutex;
-static unsigned sWriterCount = 0;
+static ConfigDiff_t sPendingDiff; // protected by sWriterMutex
 
-void ConfigurationClass::init(Scheduler& scheduler)
-{
-    scheduler.addTask(_loopTask);
-    _loopTask.setCallback(std::bind(&ConfigurationClass::loop, this));
-    _loopTask.setIterations(TASK_FOREVER);
-    _loopTask.enable();
+// The current snapshot, accessed with std::atomic_load/atomic_store
+static std::shared_ptr<const CONFIG_T> sConfig;
+static std::atomic<uint32_t> sRevision { 0 };
+static std::atomic<uint32_t> sSaveCount { 0 };
 
-    memset(&config, 0x0, sizeof(config));
+// Replaces the current snapshot. Requires sWriterMutex.
+static void publishSnapshot(std::unique_ptr<CONFIG_T> config)
+{
+    std::atomic_store(&sConfig, std::shared_ptr<const CONFIG_T>(std::move(config)));
+    sRevision++;
 }
 
-bool ConfigurationClass::write()
-{
-    File f = LittleFS.open(CONFIG_FILENAME, "w");
-    if (!f) {
-        return false;
-    }
-    config.Cfg.SaveCount++;
+struct ConfigSection_t {
+    const char* Name;
+    uint8_t Count; // number of files, e.g. one per inverter slot
+    void (*Serialize)(const CONFIG_T& config, JsonObject root, const uint8_t index);
+    void (*Deserialize)(CONFIG_T& config, JsonObject root, const uint8_t index);
+    bool (*IsUsed)(const CONFIG_T& config, const uint8_t index); // sections which are not used have no file, nullptr if always used
+};
 
-    JsonDocument doc;
+// Sections sharing a parent object must not replace each other's content
+static JsonObject getOrAddObject(JsonObject parent, const char* key)
+{
+    JsonObject obj = parent[key].as<JsonObject>();
+    return obj.isNull() ? parent[key].to<JsonObject>() : obj;
+}
 
-    JsonObject cfg = doc["cfg"].to<JsonObject>();
+static void serializeCfg(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject cfg = root["cfg"].to<JsonObject>();
     cfg["version"] = config.Cfg.Version;
-    cfg["save_count"] = config.Cfg.SaveCount;
+    cfg["save_count"] = sSaveCount.load();
+}
+
+static void deserializeCfg(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject cfg = root["cfg"];
+    config.Cfg.Version = cfg["version"] | CONFIG_VERSION;
+    sSaveCount = cfg["save_count"] | 0;
+}
 
-    JsonObject wifi = doc["wifi"].to<JsonObject>();
+static void serializeNetwork(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject wifi = root["wifi"].to<JsonObject>();
     wifi["ssid"] = config.WiFi.Ssid;
     wifi["password"] = config.WiFi.Password;
     wifi["ip"] = IPAddress(config.WiFi.Ip).toString();
@@ -56,157 +101,21 @@ bool ConfigurationClass::write()
     wifi["hostname"] = config.WiFi.Hostname;
     wifi["aptimeout"] = config.WiFi.ApTimeout;
 
-    JsonObject mdns = doc["mdns"].to<JsonObject>();
+    JsonObject mdns = root["mdns"].to<JsonObject>();
     mdns["enabled"] = config.Mdns.Enabled;
 
-    JsonObject syslog = doc["syslog"].to<JsonObject>();
+    JsonObject syslog = root["syslog"].to<JsonObject>();
     syslog["enabled"] = config.Syslog.Enabled;
     syslog["hostname"] = config.Syslog.Hostname;
     syslog["port"] = config.Syslog.Port;
-
-    JsonObject ntp = doc["ntp"].to<JsonObject>();
-    ntp["server"] = config.Ntp.Server;
-    ntp["timezone_descr"] = config.Ntp.TimezoneDescr;
-    ntp["latitude"] = config.Ntp.Latitude;
-    ntp["longitude"] = config.Ntp.Longitude;
-    ntp["sunsettype"] = config.Ntp.SunsetType;
-
-    JsonObject mqtt = doc["mqtt"].to<JsonObject>();
-    mqtt["enabled"] = config.Mqtt.Enabled;
-    mqtt["hostname"] = config.Mqtt.Hostname;
-    mqtt["port"] = config.Mqtt.Port;
-    mqtt["clientid"] = config.Mqtt.ClientId;
-    mqtt["username"] = config.Mqtt.Username;
-    mqtt["password"] = config.Mqtt.Password;
-    mqtt["topic"] = config.Mqtt.Topic;
-    mqtt["retain"] = config.Mqtt.Retain;
-    mqtt["publish_interval"] = config.Mqtt.PublishInterval;
-    mqtt["clean_session"] = config.Mqtt.CleanSession;
-
-    JsonObject mqtt_lwt = mqtt["lwt"].to<JsonObject>();
-    mqtt_lwt["topic"] = config.Mqtt.Lwt.Topic;
-    mqtt_lwt["value_online"] = config.Mqtt.Lwt.Value_Online;
-    mqtt_lwt["value_offline"] = config.Mqtt.Lwt.Value_Offline;
-    mqtt_lwt["qos"] = config.Mqtt.Lwt.Qos;
-
-    JsonObject mqtt_tls = mqtt["tls"].to<JsonObject>();
-    mqtt_tls["enabled"] = config.Mqtt.Tls.Enabled;
-    mqtt_tls["root_ca_cert"] = config.Mqtt.Tls.RootCaCert;
-    mqtt_tls["certlogin"] = config.Mqtt.Tls.CertLogin;
-    mqtt_tls["client_cert"] = config.Mqtt.Tls.ClientCert;
-    mqtt_tls["client_key"] = config.Mqtt.Tls.ClientKey;
-
-    JsonObject mqtt_hass = mqtt["hass"].to<JsonObject>();
-    mqtt_hass["enabled"] = config.Mqtt.Hass.Enabled;
-    mqtt_hass["retain"] = config.Mqtt.Hass.Retain;
-    mqtt_hass["topic"] = config.Mqtt.Hass.Topic;
-    mqtt_hass["individual_panels"] = config.Mqtt.Hass.IndividualPanels;
-    mqtt_hass["expire"] = config.Mqtt.Hass.Expire;
-
-    JsonObject dtu = doc["dtu"].to<JsonObject>();
-    dtu["serial"] = config.Dtu.Serial;
-    dtu["poll_interval"] = config.Dtu.PollInterval;
-    dtu["nrf_pa_level"] = config.Dtu.Nrf.PaLevel;
-    dtu["cmt_pa_level"] = config.Dtu.Cmt.PaLevel;
-    dtu["cmt_frequency"] = config.Dtu.Cmt.Frequency;
-    dtu["cmt_country_mode"] = config.Dtu.Cmt.CountryMode;
-
-    JsonObject security = doc["security"].to<JsonObject>();
-    security["password"] = config.Security.Password;
-    security["allow_readonly"] = config.Security.AllowReadonly;
-
-    JsonObject device = doc["device"].to<JsonObject>();
-    device["pinmapping"] = config.Dev_PinMapping;
-
-    JsonObject display = device["display"].to<JsonObject>();
-    display["powersafe"] = config.Display.PowerSafe;
-    display["screensaver"] = config.Display.ScreenSaver;
-    display["rotation"] = config.Display.Rotation;
-    display["contrast"] = config.Display.Contrast;
-    display["locale"] = config.Display.Locale;
-    display["diagram_duration"] = config.Display.Diagram.Duration;
-    display["diagram_mode"] = config.Display.Diagram.Mode;
-
-    JsonArray leds = device["led"].to<JsonArray>();
-    for (uint8_t i = 0; i < PINMAPPING_LED_COUNT; i++) {
-        JsonObject led = leds.add<JsonObject>();
-        led["brightness"] = config.Led_Single[i].Brightness;
-    }
-
-    JsonArray inverters = doc["inverters"].to<JsonArray>();
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        JsonObject inv = inverters.add<JsonObject>();
-        inv["serial"] = config.Inverter[i].Serial;
-        inv["name"] = config.Inverter[i].Name;
-        inv["order"] = config.Inverter[i].Order;
-        inv["poll_enable"] = config.Inverter[i].Poll_Enable;
-        inv["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
-        inv["command_enable"] = config.Inverter[i].Command_Enable;
-        inv["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
-        inv["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
-        inv["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
-        inv["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
-        inv["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
-        inv["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
-
-        JsonArray channel = inv["channel"].to<JsonArray>();
-        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            JsonObject chanData = channel.add<JsonObject>();
-            chanData["name"] = config.Inverter[i].channel[c].Name;
-            chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
-            chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
-        }
-    }
-
-    JsonObject logging = doc["logging"].to<JsonObject>();
-    logging["default"] = config.Logging.Default;
-    JsonArray modules = logging["modules"].to<JsonArray>();
-    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
-        JsonObject module = modules.add<JsonObject>();
-        module["level"] = config.Logging.Modules[i].Level;
-        module["name"] = config.Logging.Modules[i].Name;
-    }
-
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return false;
-    }
-
-    // Serialize JSON to file
-    if (serializeJson(doc, f) == 0) {
-        ESP_LOGE(TAG, "Failed to write file");
-        return false;
-    }
-
-    f.close();
-    return true;
 }
 
-bool ConfigurationClass::read()
+static void deserializeNetwork(CONFIG_T& config, JsonObject root, const uint8_t index)
 {
-    File f = LittleFS.open(CONFIG_FILENAME, "r", false);
-    Utils::skipBom(f);
-
-    JsonDocument doc;
-
-    // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f);
-    if (error) {
-        ESP_LOGW(TAG, "Failed to read file, using default configuration");
-    }
-
-    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
-        return false;
-    }
-
-    JsonObject cfg = doc["cfg"];
-    config.Cfg.Version = cfg["version"] | CONFIG_VERSION;
-    config.Cfg.SaveCount = cfg["save_count"] | 0;
-
-    JsonObject wifi = doc["wifi"];
+    JsonObject wifi = root["wifi"];
     strlcpy(config.WiFi.Ssid, wifi["ssid"] | WIFI_SSID, sizeof(config.WiFi.Ssid));
     strlcpy(config.WiFi.Password, wifi["password"] | WIFI_PASSWORD, sizeof(config.WiFi.Password));
     strlcpy(config.WiFi.Hostname, wifi["hostname"] | APP_HOSTNAME, sizeof(config.WiFi.Hostname));
-
     IPAddress wifi_ip;
     wifi_ip.fromString(wifi["ip"] | "");
     config.WiFi.Ip[0] = wifi_ip[0];
@@ -245,22 +154,69 @@ bool ConfigurationClass::read()
     config.WiFi.Dhcp = wifi["dhcp"] | WIFI_DHCP;
     config.WiFi.ApTimeout = wifi["aptimeout"] | ACCESS_POINT_TIMEOUT;
 
-    JsonObject mdns = doc["mdns"];
+    JsonObject mdns = root["mdns"];
     config.Mdns.Enabled = mdns["enabled"] | MDNS_ENABLED;
 
-    JsonObject syslog = doc["syslog"];
+    JsonObject syslog = root["syslog"];
     config.Syslog.Enabled = syslog["enabled"] | SYSLOG_ENABLED;
     strlcpy(config.Syslog.Hostname, syslog["hostname"] | "", sizeof(config.Syslog.Hostname));
     config.Syslog.Port = syslog["port"] | SYSLOG_PORT;
+}
 
-    JsonObject ntp = doc["ntp"];
+static void serializeNtp(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject ntp = root["ntp"].to<JsonObject>();
+    ntp["server"] = config.Ntp.Server;
+    ntp["timezone_descr"] = config.Ntp.TimezoneDescr;
+    ntp["latitude"] = config.Ntp.Latitude;
+    ntp["longitude"] = config.Ntp.Longitude;
+    ntp["sunsettype"] = config.Ntp.SunsetType;
+}
+
+static void deserializeNtp(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject ntp = root["ntp"];
     strlcpy(config.Ntp.Server, ntp["server"] | NTP_SERVER, sizeof(config.Ntp.Server));
     strlcpy(config.Ntp.TimezoneDescr, ntp["timezone_descr"] | NTP_TIMEZONEDESCR, sizeof(config.Ntp.TimezoneDescr));
     config.Ntp.Latitude = ntp["latitude"] | NTP_LATITUDE;
     config.Ntp.Longitude = ntp["longitude"] | NTP_LONGITUDE;
     config.Ntp.SunsetType = ntp["sunsettype"] | NTP_SUNSETTYPE;
+}
+
+static void serializeMqtt(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject mqtt = getOrAddObject(root, "mqtt");
+    mqtt["enabled"] = config.Mqtt.Enabled;
+    mqtt["hostname"] = config.Mqtt.Hostname;
+    mqtt["port"] = config.Mqtt.Port;
+    mqtt["clientid"] = config.Mqtt.ClientId;
+    mqtt["username"] = config.Mqtt.Username;
+    mqtt["password"] = config.Mqtt.Password;
+    mqtt["topic"] = config.Mqtt.Topic;
+    mqtt["retain"] = config.Mqtt.Retain;
+    mqtt["publish_interval"] = config.Mqtt.PublishInterval;
+    mqtt["clean_session"] = config.Mqtt.CleanSession;
+    mqtt["publish_on_change"] = config.Mqtt.PublishOnChange;
+    mqtt["publish_max_age"] = config.Mqtt.PublishMaxAge;
+    mqtt["aggregated"] = config.Mqtt.Aggregated;
 
-    JsonObject mqtt = doc["mqtt"];
+    JsonObject mqtt_lwt = mqtt["lwt"].to<JsonObject>();
+    mqtt_lwt["topic"] = config.Mqtt.Lwt.Topic;
+    mqtt_lwt["value_online"] = config.Mqtt.Lwt.Value_Online;
+    mqtt_lwt["value_offline"] = config.Mqtt.Lwt.Value_Offline;
+    mqtt_lwt["qos"] = config.Mqtt.Lwt.Qos;
+
+    JsonObject mqtt_hass = mqtt["hass"].to<JsonObject>();
+    mqtt_hass["enabled"] = config.Mqtt.Hass.Enabled;
+    mqtt_hass["retain"] = config.Mqtt.Hass.Retain;
+    mqtt_hass["topic"] = config.Mqtt.Hass.Topic;
+    mqtt_hass["individual_panels"] = config.Mqtt.Hass.IndividualPanels;
+    mqtt_hass["expire"] = config.Mqtt.Hass.Expire;
+}
+
+static void deserializeMqtt(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject mqtt = root["mqtt"];
     config.Mqtt.Enabled = mqtt["enabled"] | MQTT_ENABLED;
     strlcpy(config.Mqtt.Hostname, mqtt["hostname"] | MQTT_HOST, sizeof(config.Mqtt.Hostname));
     config.Mqtt.Port = mqtt["port"] | MQTT_PORT;
@@ -271,6 +227,9 @@ bool ConfigurationClass::read()
     config.Mqtt.Retain = mqtt["retain"] | MQTT_RETAIN;
     config.Mqtt.PublishInterval = mqtt["publish_interval"] | MQTT_PUBLISH_INTERVAL;
     config.Mqtt.CleanSession = mqtt["clean_session"] | MQTT_CLEAN_SESSION;
+    config.Mqtt.PublishOnChange = mqtt["publish_on_change"] | MQTT_PUBLISH_ON_CHANGE;
+    config.Mqtt.PublishMaxAge = mqtt["publish_max_age"] | MQTT_PUBLISH_MAX_AGE;
+    config.Mqtt.Aggregated = mqtt["aggregated"] | MQTT_AGGREGATED;
 
     JsonObject mqtt_lwt = mqtt["lwt"];
     strlcpy(config.Mqtt.Lwt.Topic, mqtt_lwt["topic"] | MQTT_LWT_TOPIC, sizeof(config.Mqtt.Lwt.Topic));
@@ -278,33 +237,96 @@ bool ConfigurationClass::read()
     strlcpy(config.Mqtt.Lwt.Value_Offline, mqtt_lwt["value_offline"] | MQTT_LWT_OFFLINE, sizeof(config.Mqtt.Lwt.Value_Offline));
     config.Mqtt.Lwt.Qos = mqtt_lwt["qos"] | MQTT_LWT_QOS;
 
+    JsonObject mqtt_hass = mqtt["hass"];
+    config.Mqtt.Hass.Enabled = mqtt_hass["enabled"] | MQTT_HASS_ENABLED;
+    config.Mqtt.Hass.Retain = mqtt_hass["retain"] | MQTT_HASS_RETAIN;
+    config.Mqtt.Hass.Expire = mqtt_hass["expire"] | MQTT_HASS_EXPIRE;
+    config.Mqtt.Hass.IndividualPanels = mqtt_hass["individual_panels"] | MQTT_HASS_INDIVIDUALPANELS;
+    strlcpy(config.Mqtt.Hass.Topic, mqtt_hass["topic"] | MQTT_HASS_TOPIC, sizeof(config.Mqtt.Hass.Topic));
+}
+
+static void serializeMqttTls(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject mqtt = getOrAddObject(root, "mqtt");
+    JsonObject mqtt_tls = mqtt["tls"].to<JsonObject>();
+    mqtt_tls["enabled"] = config.Mqtt.Tls.Enabled;
+    mqtt_tls["root_ca_cert"] = config.Mqtt.Tls.RootCaCert;
+    mqtt_tls["certlogin"] = config.Mqtt.Tls.CertLogin;
+    mqtt_tls["client_cert"] = config.Mqtt.Tls.ClientCert;
+    mqtt_tls["client_key"] = config.Mqtt.Tls.ClientKey;
+}
+
+static void deserializeMqttTls(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject mqtt = root["mqtt"];
     JsonObject mqtt_tls = mqtt["tls"];
     config.Mqtt.Tls.Enabled = mqtt_tls["enabled"] | MQTT_TLS;
     strlcpy(config.Mqtt.Tls.RootCaCert, mqtt_tls["root_ca_cert"] | MQTT_ROOT_CA_CERT, sizeof(config.Mqtt.Tls.RootCaCert));
     config.Mqtt.Tls.CertLogin = mqtt_tls["certlogin"] | MQTT_TLSCERTLOGIN;
     strlcpy(config.Mqtt.Tls.ClientCert, mqtt_tls["client_cert"] | MQTT_TLSCLIENTCERT, sizeof(config.Mqtt.Tls.ClientCert));
     strlcpy(config.Mqtt.Tls.ClientKey, mqtt_tls["client_key"] | MQTT_TLSCLIENTKEY, sizeof(config.Mqtt.Tls.ClientKey));
+}
 
-    JsonObject mqtt_hass = mqtt["hass"];
-    config.Mqtt.Hass.Enabled = mqtt_hass["enabled"] | MQTT_HASS_ENABLED;
-    config.Mqtt.Hass.Retain = mqtt_hass["retain"] | MQTT_HASS_RETAIN;
-    config.Mqtt.Hass.Expire = mqtt_hass["expire"] | MQTT_HASS_EXPIRE;
-    config.Mqtt.Hass.IndividualPanels = mqtt_hass["individual_panels"] | MQTT_HASS_INDIVIDUALPANELS;
-    strlcpy(config.Mqtt.Hass.Topic, mqtt_hass["topic"] | MQTT_HASS_TOPIC, sizeof(config.Mqtt.Hass.Topic));
+static void serializeDtu(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject dtu = root["dtu"].to<JsonObject>();
+    dtu["serial"] = config.Dtu.Serial;
+    dtu["poll_interval"] = config.Dtu.PollInterval;
+    dtu["nrf_pa_level"] = config.Dtu.Nrf.PaLevel;
+    dtu["cmt_pa_level"] = config.Dtu.Cmt.PaLevel;
+    dtu["cmt_frequency"] = config.Dtu.Cmt.Frequency;
+    dtu["cmt_country_mode"] = config.Dtu.Cmt.CountryMode;
+}
 
-    JsonObject dtu = doc["dtu"];
+static void deserializeDtu(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject dtu = root["dtu"];
     config.Dtu.Serial = dtu["serial"] | DTU_SERIAL;
     config.Dtu.PollInterval = dtu["poll_interval"] | DTU_POLL_INTERVAL;
     config.Dtu.Nrf.PaLevel = dtu["nrf_pa_level"] | DTU_NRF_PA_LEVEL;
     config.Dtu.Cmt.PaLevel = dtu["cmt_pa_level"] | DTU_CMT_PA_LEVEL;
     config.Dtu.Cmt.Frequency = dtu["cmt_frequency"] | DTU_CMT_FREQUENCY;
     config.Dtu.Cmt.CountryMode = dtu["cmt_country_mode"] | DTU_CMT_COUNTRY_MODE;
+}
 
-    JsonObject security = doc["security"];
+static void serializeSecurity(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject security = root["security"].to<JsonObject>();
+    security["password"] = config.Security.Password;
+    security["allow_readonly"] = config.Security.AllowReadonly;
+}
+
+static void deserializeSecurity(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject security = root["security"];
     strlcpy(config.Security.Password, security["password"] | ACCESS_POINT_PASSWORD, sizeof(config.Security.Password));
     config.Security.AllowReadonly = security["allow_readonly"] | SECURITY_ALLOW_READONLY;
+}
+
+static void serializeDevice(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject device = root["device"].to<JsonObject>();
+    device["pinmapping"] = config.Dev_PinMapping;
 
-    JsonObject device = doc["device"];
+    JsonObject display = device["display"].to<JsonObject>();
+    display["powersafe"] = config.Display.PowerSafe;
+    display["screensaver"] = config.Display.ScreenSaver;
+    display["rotation"] = config.Display.Rotation;
+    display["contrast"] = config.Display.Contrast;
+    display["locale"] = config.Display.Locale;
+    display["diagram_duration"] = config.Display.Diagram.Duration;
+    display["diagram_mode"] = config.Display.Diagram.Mode;
+
+    JsonArray leds = device["led"].to<JsonArray>();
+    for (uint8_t i = 0; i < PINMAPPING_LED_COUNT; i++) {
+        JsonObject led = leds.add<JsonObject>();
+        led["brightness"] = config.Led_Single[i].Brightness;
+    }
+}
+
+static void deserializeDevice(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject device = root["device"];
     strlcpy(config.Dev_PinMapping, device["pinmapping"] | DEV_PINMAPPING, sizeof(config.Dev_PinMapping));
 
     JsonObject display = device["display"];
@@ -321,33 +343,81 @@ bool ConfigurationClass::read()
         JsonObject led = leds[i].as<JsonObject>();
         config.Led_Single[i].Brightness = led["brightness"] | LED_BRIGHTNESS;
     }
+}
 
-    JsonArray inverters = doc["inverters"];
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        JsonObject inv = inverters[i].as<JsonObject>();
-        config.Inverter[i].Serial = inv["serial"] | 0ULL;
-        strlcpy(config.Inverter[i].Name, inv["name"] | "", sizeof(config.Inverter[i].Name));
-        config.Inverter[i].Order = inv["order"] | 0;
-
-        config.Inverter[i].Poll_Enable = inv["poll_enable"] | true;
-        config.Inverter[i].Poll_Enable_Night = inv["poll_enable_night"] | true;
-        config.Inverter[i].Command_Enable = inv["command_enable"] | true;
-        config.Inverter[i].Command_Enable_Night = inv["command_enable_night"] | true;
-        config.Inverter[i].ReachableThreshold = inv["reachable_threshold"] | REACHABLE_THRESHOLD;
-        config.Inverter[i].ZeroRuntimeDataIfUnrechable = inv["zero_runtime"] | false;
-        config.Inverter[i].ZeroYieldDayOnMidnight = inv["zero_day"] | false;
-        config.Inverter[i].ClearEventlogOnMidnight = inv["clear_eventlog"] | false;
-        config.Inverter[i].YieldDayCorrection = inv["yieldday_correction"] | false;
-
-        JsonArray channel = inv["channel"];
-        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            config.Inverter[i].channel[c].MaxChannelPower = channel[c]["max_power"] | 0;
-            config.Inverter[i].channel[c].YieldTotalOffset = channel[c]["yield_total_offset"] | 0.0f;
-            strlcpy(config.Inverter[i].channel[c].Name, channel[c]["name"] | "", sizeof(config.Inverter[i].channel[c].Name));
-        }
+static void serializeInverter(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonArray inverters = root["inverters"].as<JsonArray>();
+    if (inverters.isNull()) {
+        inverters = root["inverters"].to<JsonArray>();
+    }
+    while (inverters.size() <= index) {
+        inverters.add<JsonObject>();
+    }
+
+    JsonObject inv = inverters[index];
+    inv["serial"] = config.Inverter[index].Serial;
+    inv["name"] = config.Inverter[index].Name;
+    inv["order"] = config.Inverter[index].Order;
+    inv["poll_enable"] = config.Inverter[index].Poll_Enable;
+    inv["poll_enable_night"] = config.Inverter[index].Poll_Enable_Night;
+    inv["command_enable"] = config.Inverter[index].Command_Enable;
+    inv["command_enable_night"] = config.Inverter[index].Command_Enable_Night;
+    inv["reachable_threshold"] = config.Inverter[index].ReachableThreshold;
+    inv["zero_runtime"] = config.Inverter[index].ZeroRuntimeDataIfUnrechable;
+    inv["zero_day"] = config.Inverter[index].ZeroYieldDayOnMidnight;
+    inv["clear_eventlog"] = config.Inverter[index].ClearEventlogOnMidnight;
+    inv["yieldday_correction"] = config.Inverter[index].YieldDayCorrection;
+
+    JsonArray channel = inv["channel"].to<JsonArray>();
+    for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
+        JsonObject chanData = channel.add<JsonObject>();
+        chanData["name"] = config.Inverter[index].channel[c].Name;
+        chanData["max_power"] = config.Inverter[index].channel[c].MaxChannelPower;
+        chanData["yield_total_offset"] = config.Inverter[index].channel[c].YieldTotalOffset;
+    }
+}
+
+static void deserializeInverter(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject inv = root["inverters"][index].as<JsonObject>();
+    config.Inverter[index].Serial = inv["serial"] | 0ULL;
+    strlcpy(config.Inverter[index].Name, inv["name"] | "", sizeof(config.Inverter[index].Name));
+    config.Inverter[index].Order = inv["order"] | 0;
+
+    config.Inverter[index].Poll_Enable = inv["poll_enable"] | true;
+    config.Inverter[index].Poll_Enable_Night = inv["poll_enable_night"] | true;
+    config.Inverter[index].Command_Enable = inv["command_enable"] | true;
+    config.Inverter[index].Command_Enable_Night = inv["command_enable_night"] | true;
+    config.Inverter[index].ReachableThreshold = inv["reachable_threshold"] | REACHABLE_THRESHOLD;
+    config.Inverter[index].ZeroRuntimeDataIfUnrechable = inv["zero_runtime"] | false;
+    config.Inverter[index].ZeroYieldDayOnMidnight = inv["zero_day"] | false;
+    config.Inverter[index].ClearEventlogOnMidnight = inv["clear_eventlog"] | false;
+    config.Inverter[index].YieldDayCorrection = inv["yieldday_correction"] | false;
+
+    JsonArray channel = inv["channel"];
+    for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
+        config.Inverter[index].channel[c].MaxChannelPower = channel[c]["max_power"] | 0;
+        config.Inverter[index].channel[c].YieldTotalOffset = channel[c]["yield_total_offset"] | 0.0f;
+        strlcpy(config.Inverter[index].channel[c].Name, channel[c]["name"] | "", sizeof(config.Inverter[index].channel[c].Name));
+    }
+}
+
+static void serializeLogging(const CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject logging = root["logging"].to<JsonObject>();
+    logging["default"] = config.Logging.Default;
+    JsonArray modules = logging["modules"].to<JsonArray>();
+    for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
+        JsonObject module = modules.add<JsonObject>();
+        module["level"] = config.Logging.Modules[i].Level;
+        module["name"] = config.Logging.Modules[i].Name;
     }
+}
 
-    JsonObject logging = doc["logging"];
+static void deserializeLogging(CONFIG_T& config, JsonObject root, const uint8_t index)
+{
+    JsonObject logging = root["logging"];
     config.Logging.Default = logging["default"] | ESP_LOG_ERROR;
     JsonArray modules = logging["modules"];
     for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
@@ -355,13 +425,462 @@ bool ConfigurationClass::read()
         strlcpy(config.Logging.Modules[i].Name, module["name"] | "", sizeof(config.Logging.Modules[i].Name));
         config.Logging.Modules[i].Level = module["level"] | ESP_LOG_VERBOSE;
     }
+}
+
+static bool isInverterUsed(const CONFIG_T& config, const uint8_t index)
+{
+    return config.Inverter[index].Serial != 0;
+}
+
+static constexpr ConfigSection_t configSections[] = {
+    { "cfg", 1, serializeCfg, deserializeCfg, nullptr },
+    { "network", 1, serializeNetwork, deserializeNetwork, nullptr },
+    { "ntp", 1, serializeNtp, deserializeNtp, nullptr },
+    { "mqtt", 1, serializeMqtt, deserializeMqtt, nullptr },
+    { "mqtt_tls", 1, serializeMqttTls, deserializeMqttTls, nullptr },
+    { "dtu", 1, serializeDtu, deserializeDtu, nullptr },
+    { "security", 1, serializeSecurity, deserializeSecurity, nullptr },
+    { "device", 1, serializeDevice, deserializeDevice, nullptr },
+    { "inverter", INV_MAX_COUNT, serializeInverter, deserializeInverter, isInverterUsed },
+    { "logging", 1, serializeLogging, deserializeLogging, nullptr },
+};
+
+static constexpr size_t getSectionFileCount()
+{
+    size_t count = 0;
+    for (auto& section : configSections) {
+        count += section.Count;
+    }
+    return count;
+}
+
+// Checksum of every section file as last read or written. 0 if there is no file.
+static constexpr uint32_t SECTION_CRC_UNKNOWN = UINT32_MAX;
+static uint32_t sSectionCrc[getSectionFileCount()] = {};
+
+static String getSectionFileName(const ConfigSection_t& section, const uint8_t index)
+{
+    String fileName = CONFIG_DIR "/" + String(section.Name);
+    if (section.Count > 1) {
+        fileName += index;
+    }
+    return fileName + ".msgpack";
+}
+
+// Reads the section file into doc. Returns false if it is missing or invalid.
+static bool readSectionFile(const ConfigSection_t& section, const uint8_t index, JsonDocument& doc, uint32_t& crc)
+{
+    const String fileName = getSectionFileName(section, index);
+    File f = LittleFS.open(fileName, "r", false);
+    if (!f) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(f.size());
+    const size_t len = f.read(buffer.data(), buffer.size());
+    f.close();
+
+    uint32_t storedCrc = 0;
+    if (len != buffer.size() || len <= sizeof(storedCrc)) {
+        ESP_LOGE(TAG, "Failed to read %s", fileName.c_str());
+        return false;
+    }
+
+    memcpy(&storedCrc, buffer.data(), sizeof(storedCrc));
+    crc = esp_rom_crc32_le(0, buffer.data() + sizeof(storedCrc), len - sizeof(storedCrc));
+    if (crc != storedCrc) {
+        ESP_LOGE(TAG, "Checksum mismatch in %s", fileName.c_str());
+        return false;
+    }
+
+    const DeserializationError error = deserializeMsgPack(doc, buffer.data() + sizeof(storedCrc), len - sizeof(storedCrc));
+    if (error) {
+        ESP_LOGE(TAG, "Failed to read %s: %s", fileName.c_str(), error.c_str());
+        return false;
+    }
+
+    return Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__);
+}
+
+// Returns the checksum of the section file
+static uint32_t readSection(const ConfigSection_t& section, const uint8_t index, CONFIG_T& config)
+{
+    JsonDocument doc;
+    uint32_t crc = 0;
+
+    if (!readSectionFile(section, index, doc, crc)) {
+        // Missing sections use their default values. Invalid ones are written on the next save.
+        const bool exists = LittleFS.exists(getSectionFileName(section, index));
+        doc.clear();
+        crc = exists ? SECTION_CRC_UNKNOWN : 0;
+    }
+
+    section.Deserialize(config, doc.as<JsonObject>(), index);
+    return crc;
+}
+
+// Writes the section if its content differs from the file. crc is the checksum of the file and is updated.
+static bool writeSection(const ConfigSection_t& section, const uint8_t index, const CONFIG_T& config, uint32_t& crc, size_t& bytesWritten)
+{
+    bytesWritten = 0;
+    const String fileName = getSectionFileName(section, index);
+
+    if (section.IsUsed != nullptr && !section.IsUsed(config, index)) {
+        if (crc != 0 && LittleFS.exists(fileName)) {
+            LittleFS.remove(fileName);
+        }
+        crc = 0;
+        return true;
+    }
+
+    JsonDocument doc;
+    section.Serialize(config, doc.to<JsonObject>(), index);
+
+    if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(sizeof(uint32_t) + measureMsgPack(doc));
+    serializeMsgPack(doc, buffer.data() + sizeof(uint32_t), buffer.size() - sizeof(uint32_t));
+
+    const uint32_t newCrc = esp_rom_crc32_le(0, buffer.data() + sizeof(uint32_t), buffer.size() - sizeof(uint32_t));
+    if (newCrc == crc) {
+        return true;
+    }
+    memcpy(buffer.data(), &newCrc, sizeof(newCrc));
+
+    const String tmpName = fileName + ".tmp";
+    if (!Utils::hasFreeSpace(buffer.size(), true)) {
+        return false;
+    }
 
+    File f = LittleFS.open(tmpName, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", tmpName.c_str());
+        return false;
+    }
+    const size_t len = f.write(buffer.data(), buffer.size());
     f.close();
 
+    if (len != buffer.size() || !LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to write %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return false;
+    }
+
+    crc = newCrc;
+    bytesWritten = len;
+    return true;
+}
+
+static void mergeArray(JsonArray dst, JsonArrayConst src);
+
+// Deep merges src into dst. Used to combine all sections into one document.
+static void mergeObject(JsonObject dst, JsonObjectConst src)
+{
+    for (JsonPairConst kv : src) {
+        if (kv.value().is<JsonObjectConst>()) {
+            JsonObject child = dst[kv.key()].as<JsonObject>();
+            mergeObject(child.isNull() ? dst[kv.key()].to<JsonObject>() : child, kv.value().as<JsonObjectConst>());
+        } else if (kv.value().is<JsonArrayConst>()) {
+            JsonArray child = dst[kv.key()].as<JsonArray>();
+            mergeArray(child.isNull() ? dst[kv.key()].to<JsonArray>() : child, kv.value().as<JsonArrayConst>());
+        } else {
+            dst[kv.key()] = kv.value();
+        }
+    }
+}
+
+static void mergeArray(JsonArray dst, JsonArrayConst src)
+{
+    size_t i = 0;
+    for (JsonVariantConst value : src) {
+        while (dst.size() <= i) {
+            dst.add<JsonVariant>();
+        }
+
+        if (value.is<JsonObjectConst>()) {
+            JsonObject child = dst[i].as<JsonObject>();
+            mergeObject(child.isNull() ? dst[i].to<JsonObject>() : child, value.as<JsonObjectConst>());
+        } else if (value.is<JsonArrayConst>()) {
+            JsonArray child = dst[i].as<JsonArray>();
+            mergeArray(child.isNull() ? dst[i].to<JsonArray>() : child, value.as<JsonArrayConst>());
+        } else if (!value.isNull()) {
+            dst[i] = value;
+        }
+        i++;
+    }
+}
+
+// Loads the stored configuration as one document, including keys which are unknown to this firmware
+static bool loadDocument(JsonDocument& doc)
+{
+    if (LittleFS.exists(CONFIG_FILENAME)) {
+        File f = LittleFS.open(CONFIG_FILENAME, "r", false);
+        if (!f) {
+            ESP_LOGE(TAG, "Failed to open file");
+            return false;
+        }
+
+        Utils::skipBom(f);
+
+        // Deserialize the JSON document
+        const DeserializationError error = deserializeJson(doc, f);
+        f.close();
+        if (error) {
+            ESP_LOGE(TAG, "Failed to read file: %s", error.c_str());
+            return false;
+        }
+
+        return Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__);
+    }
+
+    JsonObject root = doc.to<JsonObject>();
+    for (auto& section : configSections) {
+        for (uint8_t i = 0; i < section.Count; i++) {
+            JsonDocument sectionDoc;
+            uint32_t crc;
+            if (readSectionFile(section, i, sectionDoc, crc)) {
+                mergeObject(root, sectionDoc.as<JsonObjectConst>());
+            }
+        }
+    }
+
+    return Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__);
+}
+
+// Builds the JSON representation of the complete configuration
+static bool serializeAll(JsonDocument& doc, const CONFIG_T& config)
+{
+    JsonObject root = doc.to<JsonObject>();
+    for (auto& section : configSections) {
+        for (uint8_t i = 0; i < section.Count; i++) {
+            section.Serialize(config, root, i);
+        }
+    }
+
+    return Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__);
+}
+
+ConfigDiff_t ConfigDiff_t::compare(const CONFIG_T& previous, const CONFIG_T& current)
+{
+    ConfigDiff_t diff;
+
+    const auto& pm = previous.Mqtt;
+    const auto& cm = current.Mqtt;
+    diff.MqttConnection = pm.Enabled != cm.Enabled
+        || strcmp(pm.Hostname, cm.Hostname)
+        || pm.Port != cm.Port
+        || strcmp(pm.ClientId, cm.ClientId)
+        || strcmp(pm.Username, cm.Username)
+        || strcmp(pm.Password, cm.Password)
+        || strcmp(pm.Topic, cm.Topic)
+        || pm.Retain != cm.Retain
+        || pm.CleanSession != cm.CleanSession
+        || strcmp(pm.Lwt.Topic, cm.Lwt.Topic)
+        || strcmp(pm.Lwt.Value_Online, cm.Lwt.Value_Online)
+        || strcmp(pm.Lwt.Value_Offline, cm.Lwt.Value_Offline)
+        || pm.Lwt.Qos != cm.Lwt.Qos
+        || pm.Tls.Enabled != cm.Tls.Enabled
+        || strcmp(pm.Tls.RootCaCert, cm.Tls.RootCaCert)
+        || pm.Tls.CertLogin != cm.Tls.CertLogin
+        || strcmp(pm.Tls.ClientCert, cm.Tls.ClientCert)
+        || strcmp(pm.Tls.ClientKey, cm.Tls.ClientKey);
+    diff.MqttHass = pm.Hass.Enabled != cm.Hass.Enabled
+        || pm.Hass.Retain != cm.Hass.Retain
+        || strcmp(pm.Hass.Topic, cm.Hass.Topic)
+        || pm.Hass.IndividualPanels != cm.Hass.IndividualPanels
+        || pm.Hass.Expire != cm.Hass.Expire
+        || pm.Aggregated != cm.Aggregated; // changes the state topics
+    diff.MqttPublish = pm.PublishInterval != cm.PublishInterval
+        || pm.PublishOnChange != cm.PublishOnChange
+        || pm.PublishMaxAge != cm.PublishMaxAge
+        || pm.Aggregated != cm.Aggregated;
+
+    diff.DtuSerial = previous.Dtu.Serial != current.Dtu.Serial;
+    diff.DtuPollInterval = previous.Dtu.PollInterval != current.Dtu.PollInterval;
+    diff.DtuNrfPaLevel = previous.Dtu.Nrf.PaLevel != current.Dtu.Nrf.PaLevel;
+    diff.DtuCmtPaLevel = previous.Dtu.Cmt.PaLevel != current.Dtu.Cmt.PaLevel;
+    diff.DtuCmtCountryMode = previous.Dtu.Cmt.CountryMode != current.Dtu.Cmt.CountryMode;
+    diff.DtuCmtFrequency = previous.Dtu.Cmt.Frequency != current.Dtu.Cmt.Frequency;
+
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        const auto& pi = previous.Inverter[i];
+        const auto& ci = current.Inverter[i];
+
+        diff.InverterSerial[i] = pi.Serial != ci.Serial;
+        diff.InverterName[i] = strcmp(pi.Name, ci.Name) != 0;
+        diff.InverterSettings[i] = pi.Poll_Enable != ci.Poll_Enable
+            || pi.Poll_Enable_Night != ci.Poll_Enable_Night
+            || pi.Command_Enable != ci.Command_Enable
+            || pi.Command_Enable_Night != ci.Command_Enable_Night
+            || pi.ReachableThreshold != ci.ReachableThreshold
+            || pi.ZeroRuntimeDataIfUnrechable != ci.ZeroRuntimeDataIfUnrechable
+            || pi.ZeroYieldDayOnMidnight != ci.ZeroYieldDayOnMidnight
+            || pi.ClearEventlogOnMidnight != ci.ClearEventlogOnMidnight
+            || pi.YieldDayCorrection != ci.YieldDayCorrection;
+
+        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
+            if (pi.channel[c].MaxChannelPower != ci.channel[c].MaxChannelPower
+                || pi.channel[c].YieldTotalOffset != ci.channel[c].YieldTotalOffset) {
+                diff.InverterChannel[i] = true;
+            }
+        }
+    }
+
+    return diff;
+}
+
+bool ConfigDiff_t::any() const
+{
+    return MqttConnection || MqttHass || MqttPublish
+        || DtuSerial || DtuPollInterval || DtuNrfPaLevel || DtuCmtPaLevel || DtuCmtCountryMode || DtuCmtFrequency
+        || InverterSerial.any() || InverterName.any() || InverterSettings.any() || InverterChannel.any();
+}
+
+void ConfigDiff_t::merge(const ConfigDiff_t& other)
+{
+    MqttConnection |= other.MqttConnection;
+    MqttHass |= other.MqttHass;
+    MqttPublish |= other.MqttPublish;
+    DtuSerial |= other.DtuSerial;
+    DtuPollInterval |= other.DtuPollInterval;
+    DtuNrfPaLevel |= other.DtuNrfPaLevel;
+    DtuCmtPaLevel |= other.DtuCmtPaLevel;
+    DtuCmtCountryMode |= other.DtuCmtCountryMode;
+    DtuCmtFrequency |= other.DtuCmtFrequency;
+    InverterSerial |= other.InverterSerial;
+    InverterName |= other.InverterName;
+    InverterSettings |= other.InverterSettings;
+    InverterChannel |= other.InverterChannel;
+}
+
+void ConfigurationClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.setCallback(std::bind(&ConfigurationClass::loop, this));
+    _loopTask.setIterations(TASK_FOREVER);
+    _loopTask.enable();
+
+    std::lock_guard<std::mutex> lock(sWriterMutex);
+    publishSnapshot(std::make_unique<CONFIG_T>());
+}
+
+void ConfigurationClass::write()
+{
+    // Coalesce bursts of saves. The sections are written by loop().
+    _writeRequestMillis = millis();
+    _writePending = true;
+}
+
+bool ConfigurationClass::flush()
+{
+    if (!_writePending) {
+        return true;
+    }
+    _writePending = false;
+
+    std::lock_guard<std::mutex> lock(sWriterMutex);
+    if (_writesDiscarded) {
+        return true;
+    }
+
+    const bool success = writeSections(*get());
+
+    _writeFailed = !success;
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to save configuration");
+    }
+    return success;
+}
+
+bool ConfigurationClass::hasWriteFailed() const
+{
+    return _writeFailed;
+}
+
+void ConfigurationClass::discardWrites()
+{
+    std::lock_guard<std::mutex> lock(sWriterMutex);
+    _writesDiscarded = true;
+    _writePending = false;
+
+    // The sections no longer match the files, rewrite all of them if they are ever written again
+    std::fill(std::begin(sSectionCrc), std::end(sSectionCrc), SECTION_CRC_UNKNOWN);
+}
+
+bool ConfigurationClass::writeSections(const CONFIG_T& config)
+{
+    if (!LittleFS.exists(CONFIG_DIR)) {
+        LittleFS.mkdir(CONFIG_DIR);
+    }
+
+    bool success = true;
+    size_t sectionsWritten = 0;
+    size_t bytesWritten = 0;
+
+    // The first section contains the save counter. It is written last, if any other section has changed.
+    size_t fileIndex = getSectionFileCount();
+    for (size_t s = std::size(configSections) - 1; s > 0; s--) {
+        const auto& section = configSections[s];
+        fileIndex -= section.Count;
+
+        for (uint8_t i = 0; i < section.Count; i++) {
+            size_t bytes;
+            if (!writeSection(section, i, config, sSectionCrc[fileIndex + i], bytes)) {
+                success = false;
+            } else if (bytes > 0) {
+                sectionsWritten++;
+                bytesWritten += bytes;
+            }
+        }
+    }
+
+    if (sectionsWritten > 0) {
+        sSaveCount++;
+    }
+
+    size_t bytes;
+    if (!writeSection(configSections[0], 0, config, sSectionCrc[0], bytes)) {
+        success = false;
+    } else if (bytes > 0) {
+        sectionsWritten++;
+        bytesWritten += bytes;
+    }
+
+    ESP_LOGI(TAG, "Saved configuration: %u sections, %u bytes written, %" PRIu32 " bytes heap free",
+        sectionsWritten, bytesWritten, ESP.getFreeHeap());
+
+    // The imported file is replaced by the sections
+    if (success && LittleFS.exists(CONFIG_FILENAME)) {
+        LittleFS.remove(CONFIG_FILENAME);
+    }
+
+    return success;
+}
+
+bool ConfigurationClass::read()
+{
+    auto config = std::make_unique<CONFIG_T>();
+
+    if (LittleFS.exists(CONFIG_FILENAME)) {
+        // Written by older firmware versions or restored from a backup
+        if (!importJson(*config)) {
+            return false;
+        }
+    } else {
+        size_t fileIndex = 0;
+        for (auto& section : configSections) {
+            for (uint8_t i = 0; i < section.Count; i++) {
+                sSectionCrc[fileIndex++] = readSection(section, i, *config);
+            }
+        }
+    }
+
     // Check for default DTU serial
-    if (config.Dtu.Serial == DTU_SERIAL) {
+    if (config->Dtu.Serial == DTU_SERIAL) {
         const uint64_t dtuId = Utils::generateDtuSerial();
-        config.Dtu.Serial = dtuId;
+        config->Dtu.Serial = dtuId;
         write();
         ESP_LOGI(TAG, "DTU serial check: Generated new serial based on ESP chip id: %0" PRIx32 "%08" PRIx32 "",
             static_cast<uint32_t>((dtuId >> 32) & 0xFFFFFFFF),
@@ -370,17 +889,14 @@ bool ConfigurationClass::read()
         ESP_LOGI(TAG, "DTU serial check: Using existing serial");
     }
 
+    std::lock_guard<std::mutex> lock(sWriterMutex);
+    publishSnapshot(std::move(config));
     return true;
 }
 
-void ConfigurationClass::migrate()
+bool ConfigurationClass::importJson(CONFIG_T& config)
 {
     File f = LittleFS.open(CONFIG_FILENAME, "r", false);
-    if (!f) {
-        ESP_LOGE(TAG, "Failed to open file, cancel migration");
-        return;
-    }
-
     Utils::skipBom(f);
 
     JsonDocument doc;
@@ -388,11 +904,59 @@ void ConfigurationClass::migrate()
     // Deserialize the JSON document
     const DeserializationError error = deserializeJson(doc, f);
     if (error) {
-        ESP_LOGE(TAG, "Failed to read file, cancel migration: %s", error.c_str());
-        return;
+        ESP_LOGW(TAG, "Failed to read file, using default configuration");
     }
 
     if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+        return false;
+    }
+
+    for (auto& section : configSections) {
+        for (uint8_t i = 0; i < section.Count; i++) {
+            section.Deserialize(config, doc.as<JsonObject>(), i);
+        }
+    }
+
+    f.close();
+
+    // Replace all existing sections. If a migration is required, it writes them afterwards.
+    std::fill(std::begin(sSectionCrc), std::end(sSectionCrc), SECTION_CRC_UNKNOWN);
+    if (config.Cfg.Version == CONFIG_VERSION) {
+        writeSections(config);
+    }
+
+    ESP_LOGI(TAG, "Imported %s", CONFIG_FILENAME);
+    return true;
+}
+
+bool ConfigurationClass::exportJson(Print& out)
+{
+    JsonDocument doc;
+    if (!serializeAll(doc, *get())) {
+        return false;
+    }
+
+    return serializeJson(doc, out) > 0;
+}
+
+size_t ConfigurationClass::getExportSize()
+{
+    JsonDocument doc;
+    if (!serializeAll(doc, *get())) {
+        return 0;
+    }
+
+    return measureJson(doc);
+}
+
+void ConfigurationClass::migrate()
+{
+    auto migrated = std::make_unique<CONFIG_T>(*get());
+    CONFIG_T& config = *migrated;
+
+    JsonDocument doc;
+    if (!loadDocument(doc)) {
+        ESP_LOGE(TAG, "Failed to read configuration, cancel migration");
         return;
     }
 
@@ -459,16 +1023,24 @@ void ConfigurationClass::migrate()
         config.Logging.Modules[0].Level = ESP_LOG_ERROR;
     }
 
-    f.close();
-
     config.Cfg.Version = CONFIG_VERSION;
-    write();
+    writeSections(config);
     read();
 }
 
-CONFIG_T const& ConfigurationClass::get()
+std::shared_ptr<const CONFIG_T> ConfigurationClass::get()
 {
-    return config;
+    return std::atomic_load(&sConfig);
+}
+
+uint32_t ConfigurationClass::getRevision() const
+{
+    return sRevision;
+}
+
+uint32_t ConfigurationClass::getSaveCount() const
+{
+    return sSaveCount;
 }
 
 ConfigurationClass::WriteGuard ConfigurationClass::getWriteGuard()
@@ -476,30 +1048,45 @@ ConfigurationClass::WriteGuard ConfigurationClass::getWriteGuard()
     return WriteGuard();
 }
 
-INVERTER_CONFIG_T* ConfigurationClass::getFreeInverterSlot()
+std::shared_ptr<const INVERTER_CONFIG_T> ConfigurationClass::getInverterConfig(const uint64_t serial)
 {
+    const auto config = get();
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial == 0) {
-            return &config.Inverter[i];
+        if (config->Inverter[i].Serial == serial) {
+            // Shares the ownership of the snapshot
+            return std::shared_ptr<const INVERTER_CONFIG_T>(config, &config->Inverter[i]);
         }
     }
 
     return nullptr;
 }
 
-INVERTER_CONFIG_T* ConfigurationClass::getInverterConfig(const uint64_t serial)
+std::shared_ptr<const INVERTER_CONFIG_T> ConfigurationClass::getInverterConfig(const InverterAbstract& inv)
+{
+    const auto config = get();
+    const uint8_t index = inv.getConfigIndex();
+    if (index < INV_MAX_COUNT && config->Inverter[index].Serial == inv.serial()) {
+        return std::shared_ptr<const INVERTER_CONFIG_T>(config, &config->Inverter[index]);
+    }
+
+    return getInverterConfig(inv.serial());
+}
+
+INVERTER_CONFIG_T* ConfigurationClass::WriteGuard::getFreeInverterSlot()
 {
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial == serial) {
-            return &config.Inverter[i];
+        if (_config->Inverter[i].Serial == 0) {
+            return &_config->Inverter[i];
         }
     }
 
     return nullptr;
 }
 
-void ConfigurationClass::deleteInverterById(const uint8_t id)
+void ConfigurationClass::WriteGuard::deleteInverterById(const uint8_t id)
 {
+    CONFIG_T& config = *_config;
+
     config.Inverter[id].Serial = 0ULL;
     strlcpy(config.Inverter[id].Name, "", sizeof(config.Inverter[id].Name));
     config.Inverter[id].Order = 0;
@@ -522,8 +1109,9 @@ void ConfigurationClass::deleteInverterById(const uint8_t id)
 
 int8_t ConfigurationClass::getIndexForLogModule(const String& moduleName) const
 {
+    const auto config = Configuration.get();
     for (uint8_t i = 0; i < LOG_MODULE_COUNT; i++) {
-        if (strcmp(config.Logging.Modules[i].Name, moduleName.c_str()) == 0) {
+        if (strcmp(config->Logging.Modules[i].Name, moduleName.c_str()) == 0) {
             return i;
         }
     }
@@ -533,33 +1121,55 @@ int8_t ConfigurationClass::getIndexForLogModule(const String& moduleName) const
 
 void ConfigurationClass::loop()
 {
-    std::unique_lock<std::mutex> lock(sWriterMutex);
-    if (sWriterCount == 0) {
+    if (_writePending && millis() - _writeRequestMillis > CONFIG_WRITE_DELAY) {
+        flush();
+    }
+
+    ConfigDiff_t diff;
+    {
+        std::lock_guard<std::mutex> lock(sWriterMutex);
+        diff = sPendingDiff;
+        sPendingDiff = ConfigDiff_t();
+    }
+
+    if (!diff.any()) {
         return;
     }
 
-    sWriterCv.notify_all();
-    sWriterCv.wait(lock, [] { return sWriterCount == 0; });
+    for (auto& cb : _changeCallbacks) {
+        cb(diff);
+    }
+}
+
+void ConfigurationClass::onChange(const ConfigChangeCb& cb)
+{
+    _changeCallbacks.push_back(cb);
 }
 
 CONFIG_T& ConfigurationClass::WriteGuard::getConfig()
 {
-    return config;
+    return *_config;
 }
 
 ConfigurationClass::WriteGuard::WriteGuard()
     : _lock(sWriterMutex)
+    , _config(std::make_unique<CONFIG_T>(*Configuration.get()))
 {
-    sWriterCount++;
-    sWriterCv.wait(_lock);
 }
 
 ConfigurationClass::WriteGuard::~WriteGuard()
 {
-    sWriterCount--;
-    if (sWriterCount == 0) {
-        sWriterCv.notify_all();
+    const auto previous = Configuration.get();
+
+    // The diff does not cover sections without a change callback (e.g. network or display),
+    // those are compared bytewise. The copy has the same padding as the previous snapshot.
+    const ConfigDiff_t diff = ConfigDiff_t::compare(*previous, *_config);
+    if (!diff.any() && memcmp(previous.get(), _config.get(), sizeof(CONFIG_T)) == 0) {
+        return;
     }
+
+    sPendingDiff.merge(diff);
+    publishSnapshot(std::move(_config));
 }
 
 ConfigurationClass Configuration;
@@ -56,7 +56,7 @@ void DatastoreClass::loop()
             continue;
         }
 
-        auto cfg = Configuration.getInverterConfig(inv->serial());
+        auto cfg = Configuration.getInverterConfig(*inv);
         if (cfg == nullptr) {
             continue;
         }
@@ -74,13 +74,13 @@ void DisplayGraphicClass::init(Scheduler& scheduler)
     _loopTask.setInterval(_period);
     _loopTask.enable();
 
-    auto& config = Configuration.get();
-    setDiagramMode(static_cast<DiagramMode_t>(config.Display.Diagram.Mode));
-    setOrientation(config.Display.Rotation);
-    enablePowerSafe = config.Display.PowerSafe;
-    enableScreensaver = config.Display.ScreenSaver;
-    setContrast(config.Display.Contrast);
-    setLocale(config.Display.Locale);
+    const auto config = Configuration.get();
+    setDiagramMode(static_cast<DiagramMode_t>(config->Display.Diagram.Mode));
+    setOrientation(config->Display.Rotation);
+    enablePowerSafe = config->Display.PowerSafe;
+    enableScreensaver = config->Display.ScreenSaver;
+    setContrast(config->Display.Contrast);
+    setLocale(config->Display.Locale);
     setStartupDisplay();
 }
 
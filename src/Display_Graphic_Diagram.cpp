@@ -49,13 +49,13 @@ void DisplayGraphicDiagramClass::dataPointLoop()
 
 uint32_t DisplayGraphicDiagramClass::getSecondsPerDot()
 {
-    return Configuration.get().Display.Diagram.Duration / _chartWidth;
+    return Configuration.get()->Display.Diagram.Duration / _chartWidth;
 }
 
 void DisplayGraphicDiagramClass::updatePeriod()
 {
     //  Calculate seconds per datapoint
-    _dataPointTask.setInterval(Configuration.get().Display.Diagram.Duration * TASK_SECOND / MAX_DATAPOINTS);
+    _dataPointTask.setInterval(Configuration.get()->Display.Diagram.Duration * TASK_SECOND / MAX_DATAPOINTS);
 }
 
 void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height, bool isFullscreen)
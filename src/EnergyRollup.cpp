@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Accumulates the produced energy of every inverter (and the sum of all inverters) into
+hourly, daily, monthly and yearly buckets.
+
+The energy is derived from the total yield counter (FLD_YT) of the inverter, so no sample
+is lost if the DTU misses some polls. Every inverter has one file with a fixed size ring of
+buckets per resolution. A bucket is addressed by period % ring size, so reading any period
+does not require scanning. Energy is collected in RAM and only written when the hour
+changes or before a restart. Files are replaced atomically by writing a temporary file
+and renaming it.
+*/
+#include "EnergyRollup.h"
+#include "Utils.h"
+#include <Hoymiles.h>
+#include <LittleFS.h>
+#include <algorithm>
+
+#undef TAG
+static const char* TAG = "energy";
+
+EnergyRollupClass EnergyRollup;
+
+EnergyRollupClass::EnergyRollupClass()
+    : _loopTask(1 * TASK_MINUTE, TASK_FOREVER, std::bind(&EnergyRollupClass::loop, this))
+{
+}
+
+void EnergyRollupClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(ENERGY_DIR)) {
+        LittleFS.mkdir(ENERGY_DIR);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+uint32_t EnergyRollupClass::getPeriod(const EnergyResolution_t resolution, const time_t time)
+{
+    if (resolution == ENERGY_HOUR) {
+        return time / 3600;
+    }
+
+    struct tm tm;
+    localtime_r(&time, &tm);
+
+    switch (resolution) {
+    case ENERGY_DAY: {
+        // Days since 1970-01-01 of the local date
+        const int32_t y = tm.tm_year + 1900 - (tm.tm_mon < 2 ? 1 : 0);
+        const int32_t era = y / 400;
+        const int32_t yoe = y - era * 400;
+        const int32_t m = tm.tm_mon + 1;
+        const int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + tm.tm_mday - 1;
+        const int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+    case ENERGY_MONTH:
+        return (tm.tm_year - 70) * 12 + tm.tm_mon;
+    default:
+        return tm.tm_year - 70;
+    }
+}
+
+time_t EnergyRollupClass::getPeriodStart(const EnergyResolution_t resolution, const uint32_t period)
+{
+    if (resolution == ENERGY_HOUR) {
+        return static_cast<time_t>(period) * 3600;
+    }
+
+    // mktime normalizes out of range days and months
+    struct tm tm = {};
+    tm.tm_year = 70;
+    tm.tm_mday = 1;
+    tm.tm_isdst = -1;
+
+    switch (resolution) {
+    case ENERGY_DAY:
+        tm.tm_mday += period;
+        break;
+    case ENERGY_MONTH:
+        tm.tm_mon += period;
+        break;
+    default:
+        tm.tm_year += period;
+        break;
+    }
+
+    return mktime(&tm);
+}
+
+void EnergyRollupClass::loop()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    const time_t now = time(nullptr);
+    uint32_t period[4];
+    for (uint8_t r = ENERGY_HOUR; r <= ENERGY_YEAR; r++) {
+        period[r] = getPeriod(static_cast<EnergyResolution_t>(r), now);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Inverters which stopped producing (e.g. at night) don't call addEnergy()
+    closePeriods(period);
+
+    float fleetEnergy = 0;
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr || inv->Statistics()->getLastUpdate() == 0
+            || !inv->Statistics()->hasChannelFieldValue(TYPE_AC, CH0, FLD_YT)) {
+            continue;
+        }
+
+        // Zero if the statistics were cleared, e.g. at midnight or when the inverter is not reachable
+        const float yieldTotal = inv->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_YT);
+        if (yieldTotal <= 0) {
+            continue;
+        }
+
+        auto& pending = getPending(inv->serial());
+
+        if (!pending.synced) {
+            // Continue from the value stored before the restart to include energy produced in the meantime
+            pending.synced = true;
+            pending.lastYieldTotal = readFile(inv->serial(), _file) ? _file.lastYieldTotal : 0;
+            if (pending.lastYieldTotal <= 0) {
+                pending.lastYieldTotal = yieldTotal;
+                continue;
+            }
+        }
+
+        const float energy = (yieldTotal - pending.lastYieldTotal) * 1000;
+        pending.lastYieldTotal = yieldTotal;
+
+        if (energy < 0 || energy > ENERGY_MAX_DELTA) {
+            ESP_LOGW(TAG, "Ignored implausible yield change of %.0f Wh for %s", energy, getFileName(inv->serial()).c_str());
+            continue;
+        }
+
+        addEnergy(pending, period, energy);
+        fleetEnergy += energy;
+    }
+
+    addEnergy(getPending(ENERGY_FLEET_SERIAL), period, fleetEnergy);
+}
+
+EnergyRollupClass::Pending_t& EnergyRollupClass::getPending(const uint64_t serial)
+{
+    for (auto& pending : _pending) {
+        if (pending.serial == serial) {
+            return pending;
+        }
+    }
+
+    Pending_t pending;
+    pending.serial = serial;
+    pending.synced = (serial == ENERGY_FLEET_SERIAL);
+    _pending.push_back(pending);
+    return _pending.back();
+}
+
+void EnergyRollupClass::addEnergy(Pending_t& pending, const uint32_t* period, const float energy)
+{
+    if (pending.period[ENERGY_HOUR] != 0 && memcmp(pending.period, period, sizeof(pending.period)) != 0) {
+        writePending(pending);
+    }
+
+    memcpy(pending.period, period, sizeof(pending.period));
+    pending.energy += energy;
+}
+
+void EnergyRollupClass::closePeriods(const uint32_t* period)
+{
+    for (auto& pending : _pending) {
+        if (pending.period[ENERGY_HOUR] == 0 || memcmp(pending.period, period, sizeof(pending.period)) == 0) {
+            continue;
+        }
+
+        // Keep the energy and retry with the next loop if the file could not be written
+        if (pending.energy > 0 && !writePending(pending)) {
+            continue;
+        }
+
+        memcpy(pending.period, period, sizeof(pending.period));
+    }
+}
+
+String EnergyRollupClass::getFileName(const uint64_t serial)
+{
+    if (serial == ENERGY_FLEET_SERIAL) {
+        return ENERGY_DIR "/fleet.bin";
+    }
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), ENERGY_DIR "/%0" PRIx32 "%08" PRIx32 ".bin",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF));
+    return fileName;
+}
+
+bool EnergyRollupClass::readFile(const uint64_t serial, RollupFile_t& data)
+{
+    File f = LittleFS.open(getFileName(serial), "r");
+    if (!f) {
+        return false;
+    }
+
+    const size_t len = f.read(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+    f.close();
+
+    return len == sizeof(data) && data.magic == ENERGY_FILE_MAGIC && data.version == ENERGY_FILE_VERSION;
+}
+
+float* EnergyRollupClass::getBuckets(RollupFile_t& data, const EnergyResolution_t resolution, size_t& size)
+{
+    switch (resolution) {
+    case ENERGY_HOUR:
+        size = ENERGY_HOURS;
+        return data.hours;
+    case ENERGY_DAY:
+        size = ENERGY_DAYS;
+        return data.days;
+    case ENERGY_MONTH:
+        size = ENERGY_MONTHS;
+        return data.months;
+    default:
+        size = ENERGY_YEARS;
+        return data.years;
+    }
+}
+
+void EnergyRollupClass::advance(float* buckets, const size_t size, uint32_t& lastPeriod, const uint32_t period)
+{
+    if (period <= lastPeriod) {
+        return;
+    }
+
+    // Clear all buckets between the last written period and the new one
+    const uint32_t count = std::min<uint32_t>(period - lastPeriod, size);
+    for (uint32_t i = 1; i <= count; i++) {
+        buckets[(lastPeriod + i) % size] = 0;
+    }
+    lastPeriod = period;
+}
+
+bool EnergyRollupClass::writePending(Pending_t& pending)
+{
+    if (!readFile(pending.serial, _file)) {
+        memset(&_file, 0, sizeof(_file));
+        _file.magic = ENERGY_FILE_MAGIC;
+        _file.version = ENERGY_FILE_VERSION;
+    }
+
+    for (uint8_t r = ENERGY_HOUR; r <= ENERGY_YEAR; r++) {
+        size_t size;
+        float* buckets = getBuckets(_file, static_cast<EnergyResolution_t>(r), size);
+        advance(buckets, size, _file.lastPeriod[r], pending.period[r]);
+
+        // The clock may have been set back. Only add if the bucket is still part of the ring.
+        if (pending.period[r] <= _file.lastPeriod[r] && _file.lastPeriod[r] - pending.period[r] < size) {
+            buckets[pending.period[r] % size] += pending.energy;
+        }
+    }
+    _file.lastYieldTotal = pending.lastYieldTotal;
+
+    const String fileName = getFileName(pending.serial);
+    const String tmpName = fileName + ".tmp";
+
+    if (!Utils::hasFreeSpace(sizeof(_file))) {
+        return false;
+    }
+
+    File f = LittleFS.open(tmpName, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", tmpName.c_str());
+        return false;
+    }
+    const size_t len = f.write(reinterpret_cast<const uint8_t*>(&_file), sizeof(_file));
+    f.close();
+
+    if (len != sizeof(_file) || !LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to write %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return false;
+    }
+
+    pending.energy = 0;
+    return true;
+}
+
+void EnergyRollupClass::flushAll()
+{
+    for (auto& pending : _pending) {
+        if (pending.period[ENERGY_HOUR] != 0) {
+            writePending(pending);
+        }
+    }
+}
+
+void EnergyRollupClass::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    flushAll();
+}
+
+bool EnergyRollupClass::getEnergy(const uint64_t serial, const EnergyResolution_t resolution, const uint32_t firstPeriod, const size_t count, float* values)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const bool found = readFile(serial, _file);
+
+    const Pending_t* pending = nullptr;
+    for (auto& p : _pending) {
+        if (p.serial == serial) {
+            pending = &p;
+            break;
+        }
+    }
+
+    if (!found && pending == nullptr) {
+        return false;
+    }
+
+    size_t size;
+    const float* buckets = getBuckets(_file, resolution, size);
+    const uint32_t lastPeriod = _file.lastPeriod[resolution];
+
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t period = firstPeriod + i;
+        values[i] = 0;
+
+        if (found && period <= lastPeriod && lastPeriod - period < size) {
+            values[i] = buckets[period % size];
+        }
+        if (pending != nullptr && pending->period[resolution] == period) {
+            values[i] += pending->energy;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Keeps the alarm log of every inverter beyond the ALARM_LOG_ENTRY_COUNT entries which are
+reported by the inverter itself.
+
+Every event is stored as a fixed size record in a file per inverter. Records are appended in
+chronological order of their start time, so range queries use a binary search over the file.
+An event is identified by its message id and start time. Events which are reported again are
+ignored, while an end time reported later updates the existing record in place.
+If a file exceeds its share of EVENTSTORE_FLASH_BUDGET, the oldest quarter is removed.
+*/
+#include "EventStore.h"
+#include "Utils.h"
+#include <Hoymiles.h>
+#include <algorithm>
+
+#undef TAG
+static const char* TAG = "eventstore";
+
+EventStoreClass EventStore;
+
+EventStoreClass::EventStoreClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&EventStoreClass::loop, this))
+{
+}
+
+void EventStoreClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(EVENTSTORE_DIR)) {
+        LittleFS.mkdir(EVENTSTORE_DIR);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void EventStoreClass::loop()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    const uint32_t now = time(nullptr);
+    const uint32_t midnight = now - now % 86400;
+    const int timezoneOffset = Utils::getTimezoneOffset();
+
+    // The inverter reports times as seconds since midnight (UTC). Times in the future belong to the previous day.
+    auto toEpoch = [now, midnight, timezoneOffset](const time_t reported) -> uint32_t {
+        uint32_t epoch = midnight + (reported - timezoneOffset);
+        if (epoch > now + 300) {
+            epoch -= 86400;
+        }
+        return epoch;
+    };
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        const uint32_t lastUpdate = inv->EventLog()->getLastUpdate();
+        if (lastUpdate == 0) {
+            continue;
+        }
+
+        auto events = getInverterEvents(inv->serial(), true);
+        if (events == nullptr || events->lastUpdate == lastUpdate) {
+            continue;
+        }
+        events->lastUpdate = lastUpdate;
+
+        std::vector<StoredEvent_t> entries;
+        const uint8_t count = inv->EventLog()->getEntryCount();
+        for (uint8_t e = 0; e < count; e++) {
+            AlarmLogEntry_t entry;
+            inv->EventLog()->getLogEntry(e, entry);
+
+            StoredEvent_t event = {};
+            event.messageId = entry.MessageId;
+            event.startTime = toEpoch(entry.StartTime);
+            if (entry.EndTime > 0) {
+                event.endTime = toEpoch(entry.EndTime);
+                if (event.endTime < event.startTime) {
+                    event.endTime += 86400;
+                }
+            }
+            entries.push_back(event);
+        }
+
+        std::stable_sort(entries.begin(), entries.end(), [](const StoredEvent_t& a, const StoredEvent_t& b) {
+            return a.startTime < b.startTime;
+        });
+
+        for (auto& event : entries) {
+            storeEvent(*events, event);
+        }
+    }
+}
+
+String EventStoreClass::getFileName(const uint64_t serial)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), EVENTSTORE_DIR "/%0" PRIx32 "%08" PRIx32 ".bin",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF));
+    return fileName;
+}
+
+size_t EventStoreClass::getMaxRecords()
+{
+    const size_t inverterCount = std::max<size_t>(Hoymiles.getNumInverters(), 1);
+    return std::max<size_t>(EVENTSTORE_FLASH_BUDGET / sizeof(StoredEvent_t) / inverterCount, EVENTSTORE_MIN_RECORDS);
+}
+
+EventStoreClass::InverterEvents_t* EventStoreClass::getInverterEvents(const uint64_t serial, const bool create)
+{
+    for (auto& events : _events) {
+        if (events.serial == serial) {
+            return &events;
+        }
+    }
+
+    if (!create) {
+        return nullptr;
+    }
+
+    InverterEvents_t events;
+    events.serial = serial;
+    openFile(events);
+
+    _events.push_back(std::move(events));
+    return &_events.back();
+}
+
+bool EventStoreClass::readRecord(File& f, const size_t index, StoredEvent_t& event)
+{
+    f.seek(sizeof(FileHeader_t) + index * sizeof(StoredEvent_t));
+    return f.read(reinterpret_cast<uint8_t*>(&event), sizeof(event)) == sizeof(event);
+}
+
+void EventStoreClass::openFile(InverterEvents_t& events)
+{
+    const String fileName = getFileName(events.serial);
+    FileHeader_t header = {};
+
+    File f = LittleFS.open(fileName, "r");
+    if (f) {
+        if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)
+            && header.magic == EVENTSTORE_FILE_MAGIC && header.version == EVENTSTORE_FILE_VERSION) {
+
+            events.recordCount = (f.size() - sizeof(FileHeader_t)) / sizeof(StoredEvent_t);
+
+            // Load the newest records to recognize events which are still in the inverter's log
+            const size_t first = events.recordCount > EVENTSTORE_RECENT_COUNT ? events.recordCount - EVENTSTORE_RECENT_COUNT : 0;
+            for (size_t i = first; i < events.recordCount; i++) {
+                RecentEvent_t recent;
+                recent.index = i;
+                if (!readRecord(f, i, recent.event)) {
+                    events.recordCount = i;
+                    break;
+                }
+                events.recent.push_back(recent);
+            }
+            f.close();
+            return;
+        }
+        f.close();
+    }
+
+    header.magic = EVENTSTORE_FILE_MAGIC;
+    header.version = EVENTSTORE_FILE_VERSION;
+
+    f = LittleFS.open(fileName, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to create %s", fileName.c_str());
+        return;
+    }
+    f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    f.close();
+    events.recordCount = 0;
+}
+
+void EventStoreClass::storeEvent(InverterEvents_t& events, const StoredEvent_t& event)
+{
+    for (auto& recent : events.recent) {
+        if (recent.event.messageId != event.messageId || recent.event.startTime != event.startTime) {
+            continue;
+        }
+
+        // Known event. Only write if it has ended in the meantime.
+        if (event.endTime != 0 && recent.event.endTime != event.endTime) {
+            File f = LittleFS.open(getFileName(events.serial), "r+");
+            if (f) {
+                f.seek(sizeof(FileHeader_t) + recent.index * sizeof(StoredEvent_t));
+                f.write(reinterpret_cast<const uint8_t*>(&event), sizeof(event));
+                f.close();
+                recent.event.endTime = event.endTime;
+            }
+        }
+        return;
+    }
+
+    // Keep the file sorted by start time
+    if (!events.recent.empty() && event.startTime < events.recent.back().event.startTime) {
+        ESP_LOGW(TAG, "Ignored event %" PRIu16 " of %s as it is older than the last stored event",
+            event.messageId, getFileName(events.serial).c_str());
+        return;
+    }
+
+    if (!Utils::hasFreeSpace(sizeof(event))) {
+        return;
+    }
+
+    File f = LittleFS.open(getFileName(events.serial), "a");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", getFileName(events.serial).c_str());
+        return;
+    }
+    f.write(reinterpret_cast<const uint8_t*>(&event), sizeof(event));
+    f.close();
+
+    events.recent.push_back({ events.recordCount, event });
+    if (events.recent.size() > EVENTSTORE_RECENT_COUNT) {
+        events.recent.erase(events.recent.begin());
+    }
+    events.recordCount++;
+
+    if (events.recordCount > getMaxRecords()) {
+        compact(events);
+    }
+}
+
+void EventStoreClass::compact(InverterEvents_t& events)
+{
+    const String fileName = getFileName(events.serial);
+    const String tmpName = fileName + ".tmp";
+
+    const size_t keep = getMaxRecords() * 3 / 4;
+    const size_t drop = events.recordCount - keep;
+
+    if (!Utils::hasFreeSpace(sizeof(FileHeader_t) + keep * sizeof(StoredEvent_t))) {
+        return;
+    }
+
+    File src = LittleFS.open(fileName, "r");
+    File dst = LittleFS.open(tmpName, "w");
+    if (!src || !dst) {
+        ESP_LOGE(TAG, "Failed to compact %s", fileName.c_str());
+        return;
+    }
+
+    FileHeader_t header = {};
+    header.magic = EVENTSTORE_FILE_MAGIC;
+    header.version = EVENTSTORE_FILE_VERSION;
+    dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    src.seek(sizeof(FileHeader_t) + drop * sizeof(StoredEvent_t));
+    uint8_t buffer[20 * sizeof(StoredEvent_t)];
+    size_t len;
+    while ((len = src.read(buffer, sizeof(buffer))) > 0) {
+        dst.write(buffer, len);
+    }
+    src.close();
+    dst.close();
+
+    if (!LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to compact %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return;
+    }
+
+    events.recordCount = keep;
+    for (auto& recent : events.recent) {
+        recent.index -= drop;
+    }
+
+    ESP_LOGI(TAG, "Removed %u old events from %s", drop, fileName.c_str());
+}
+
+size_t EventStoreClass::lowerBound(File& f, const size_t count, const uint32_t time)
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        StoredEvent_t event;
+        if (!readRecord(f, mid, event)) {
+            return mid;
+        }
+        if (event.startTime < time) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+size_t EventStoreClass::forEachEvent(const uint64_t serial, const uint32_t from, const uint32_t to, const size_t offset, const size_t limit, const StoredEventVisitor& visitor)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto events = getInverterEvents(serial, LittleFS.exists(getFileName(serial)));
+    if (events == nullptr || events->recordCount == 0) {
+        return 0;
+    }
+
+    File f = LittleFS.open(getFileName(serial), "r");
+    if (!f) {
+        return 0;
+    }
+
+    const size_t first = lowerBound(f, events->recordCount, from);
+    const size_t last = to == UINT32_MAX ? events->recordCount : lowerBound(f, events->recordCount, to + 1);
+    const size_t total = last > first ? last - first : 0;
+
+    StoredEvent_t event;
+    for (size_t i = first + offset; i < last && i < first + offset + limit; i++) {
+        if (!readRecord(f, i, event)) {
+            break;
+        }
+        visitor(event);
+    }
+    f.close();
+
+    return total;
+}
@@ -0,0 +1,855 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Records AC power, AC voltage, temperature and DC power/voltage of every inverter with a
+resolution of one minute.
+
+The samples are collected in blocks of HISTORY_BLOCK_SIZE bytes. Each value is stored as
+zigzag varint encoded delta to its previous sample, which results in one byte per value
+most of the time. A completed block is appended to a ring buffer file per inverter in
+LittleFS.
+
+Seven days of one minute samples need about 10 kB per series, e.g. 110 kB for an inverter
+with four inputs, which does not fit into the 192 kB LittleFS partition together with the
+configuration. Therefore two rings are stored per inverter:
+- <serial>.bin contains the one minute samples. HISTORY_FLASH_BUDGET is split between all
+  inverters, so it covers the last hours to days depending on the inverter count.
+- <serial>.avg contains averages over HISTORY_AVERAGE_INTERVAL minutes. It is sized from the
+  number of series to cover HISTORY_RETENTION, limited by the share of HISTORY_AVERAGE_BUDGET.
+  This covers 7 days for up to two inverters with four inputs. A block of averages takes
+  hours to complete, so the block which is currently recorded is written to its slot with
+  every sample and is continued after a reboot.
+Readers get the one minute samples where available and the averages before.
+
+If PSRAM is available, a second ring in PSRAM keeps the one minute samples of the last 7
+days since the last reboot.
+
+If inverters are added or removed, the files are resized and the files of removed
+inverters are deleted.
+*/
+#include "History.h"
+#include "Utils.h"
+#include <LittleFS.h>
+#include <algorithm>
+
+#undef TAG
+static const char* TAG = "history";
+
+HistoryClass History;
+
+static size_t encodeValue(const int32_t value, uint8_t* buffer)
+{
+    uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    size_t len = 0;
+    do {
+        uint8_t b = zigzag & 0x7f;
+        zigzag >>= 7;
+        if (zigzag != 0) {
+            b |= 0x80;
+        }
+        buffer[len++] = b;
+    } while (zigzag != 0);
+    return len;
+}
+
+static bool decodeValue(const uint8_t*& data, const uint8_t* end, int32_t& value)
+{
+    uint32_t zigzag = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (data >= end) {
+            return false;
+        }
+        const uint8_t b = *data++;
+        zigzag |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            value = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+HistoryClass::HistoryClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&HistoryClass::loop, this))
+{
+}
+
+void HistoryClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(HISTORY_DIR)) {
+        LittleFS.mkdir(HISTORY_DIR);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void HistoryClass::loop()
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+
+    const uint32_t minute = time(nullptr) / 60;
+    if (minute == _lastMinute) {
+        return;
+    }
+    _lastMinute = minute;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (Hoymiles.getNumInverters() != _inverterCount) {
+        _inverterCount = Hoymiles.getNumInverters();
+        relayoutFiles();
+    }
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+
+        // Don't record anything until the first data was received after boot
+        if (inv == nullptr || inv->Statistics()->getLastUpdate() == 0) {
+            continue;
+        }
+
+        auto history = getInverterHistory(inv->serial(), true);
+        if (history == nullptr) {
+            continue;
+        }
+
+        recordSample(*history, inv, minute);
+    }
+}
+
+String HistoryClass::getFileName(const uint64_t serial, const RingType_t type)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), HISTORY_DIR "/%0" PRIx32 "%08" PRIx32 "%s",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF),
+        type == RING_AVERAGES ? ".avg" : ".bin");
+    return fileName;
+}
+
+HistoryClass::InverterHistory_t* HistoryClass::getInverterHistory(const uint64_t serial, const bool create)
+{
+    for (auto& history : _histories) {
+        if (history->serial == serial) {
+            return history.get();
+        }
+    }
+
+    if (!create) {
+        return nullptr;
+    }
+
+    try {
+        auto history = std::make_unique<InverterHistory_t>();
+        history->serial = serial;
+        openFile(*history, RING_MINUTES);
+        openFile(*history, RING_AVERAGES);
+
+        _histories.push_back(std::move(history));
+        return _histories.back().get();
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Cannot allocate history for %s. Reason: \"%s\".", getFileName(serial, RING_MINUTES).c_str(), bad_alloc.what());
+    }
+
+    return nullptr;
+}
+
+uint16_t HistoryClass::getSlotCount(const RingType_t type, const size_t seriesCount)
+{
+    // Split the flash budget between all inverters
+    const size_t inverterCount = std::max<size_t>(Hoymiles.getNumInverters(), 1);
+    if (type == RING_MINUTES) {
+        return std::max<size_t>(HISTORY_FLASH_BUDGET / HISTORY_BLOCK_SIZE / inverterCount, HISTORY_FLASH_MIN_SLOTS);
+    }
+
+    // Enough blocks for the retention plus the block which is currently recorded
+    const size_t samplesPerBlock = getSamplesPerBlock(seriesCount);
+    const size_t samples = HISTORY_RETENTION / 60 / HISTORY_AVERAGE_INTERVAL;
+    const size_t required = (samples + samplesPerBlock - 1) / samplesPerBlock + 1;
+    const size_t share = HISTORY_AVERAGE_BUDGET / HISTORY_BLOCK_SIZE / inverterCount;
+
+    return std::max<size_t>(std::min(required, share), HISTORY_FLASH_MIN_SLOTS);
+}
+
+size_t HistoryClass::getSamplesPerBlock(const size_t seriesCount)
+{
+    return std::max<size_t>((HISTORY_BLOCK_SIZE - sizeof(BlockHeader_t)) / (std::max<size_t>(seriesCount, 1) * HISTORY_AVERAGE_VALUE_SIZE), 1);
+}
+
+void HistoryClass::openFile(InverterHistory_t& history, const RingType_t type)
+{
+    const String fileName = getFileName(history.serial, type);
+    const size_t seriesCount = getSeries(history.serial).size();
+    const uint16_t slotCount = getSlotCount(type, seriesCount);
+    auto& ring = history.rings[type];
+    FileHeader_t header = {};
+
+    File f = LittleFS.open(fileName, "r");
+    if (f) {
+        f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header));
+        f.close();
+    }
+
+    if (header.magic == HISTORY_FILE_MAGIC && header.version == HISTORY_FILE_VERSION
+        && header.slotCount > 0 && header.nextSlot < header.slotCount) {
+
+        ring.slots = header.slotCount;
+        ring.nextSlot = header.nextSlot;
+
+        if (type == RING_AVERAGES) {
+            restoreBlock(history);
+        }
+
+        // The number of inverters changed since the file was created
+        if (ring.slots != slotCount) {
+            resizeFile(history, type, slotCount);
+        }
+
+    } else {
+        header = {};
+        header.magic = HISTORY_FILE_MAGIC;
+        header.version = HISTORY_FILE_VERSION;
+        header.slotCount = slotCount;
+
+        // The invalid file is replaced, its space can be reused
+        if (LittleFS.exists(fileName)) {
+            LittleFS.remove(fileName);
+        }
+        if (!Utils::hasFreeSpace(sizeof(header) + header.slotCount * HISTORY_BLOCK_SIZE)) {
+            return;
+        }
+
+        f = LittleFS.open(fileName, "w");
+        if (!f) {
+            ESP_LOGE(TAG, "Failed to create %s", fileName.c_str());
+            return;
+        }
+
+        // Allocate all slots now so the history cannot run out of space later
+        f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        uint8_t empty[64] = {};
+        for (size_t i = 0; i < header.slotCount * HISTORY_BLOCK_SIZE / sizeof(empty); i++) {
+            f.write(empty, sizeof(empty));
+        }
+        f.close();
+
+        ring.slots = header.slotCount;
+        ring.nextSlot = 0;
+
+        ESP_LOGI(TAG, "Created %s with %" PRIu16 " blocks", fileName.c_str(), header.slotCount);
+    }
+
+    if (type == RING_AVERAGES) {
+        // Less than HISTORY_RETENTION if too many inverters share the budget
+        const uint32_t hours = (ring.slots - 1) * getSamplesPerBlock(seriesCount) * HISTORY_AVERAGE_INTERVAL / 60;
+        ESP_LOGI(TAG, "%s covers about %" PRIu32 " hours", fileName.c_str(), hours);
+    }
+
+    if (type != RING_MINUTES || !psramFound()) {
+        return;
+    }
+
+    // Copy all blocks from flash (oldest first) into the larger PSRAM ring
+    history.ramSlots.assign(HISTORY_RAM_SLOTS * HISTORY_BLOCK_SIZE, 0);
+    history.ramNextSlot = 0;
+
+    f = LittleFS.open(fileName, "r");
+    if (!f) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < ring.slots && i < HISTORY_RAM_SLOTS; i++) {
+        const uint16_t slot = (ring.nextSlot + i) % ring.slots;
+        uint8_t* block = &history.ramSlots[history.ramNextSlot * HISTORY_BLOCK_SIZE];
+
+        f.seek(sizeof(FileHeader_t) + slot * HISTORY_BLOCK_SIZE);
+        if (f.read(block, HISTORY_BLOCK_SIZE) != HISTORY_BLOCK_SIZE) {
+            memset(block, 0, HISTORY_BLOCK_SIZE);
+            break;
+        }
+
+        if (reinterpret_cast<BlockHeader_t*>(block)->sampleCount == 0) {
+            continue;
+        }
+
+        history.ramNextSlot = (history.ramNextSlot + 1) % HISTORY_RAM_SLOTS;
+    }
+    f.close();
+}
+
+void HistoryClass::resizeFile(InverterHistory_t& history, const RingType_t type, const uint16_t slotCount)
+{
+    const String fileName = getFileName(history.serial, type);
+    const String tmpName = fileName + ".tmp";
+    auto& ring = history.rings[type];
+
+    if (!Utils::hasFreeSpace(sizeof(FileHeader_t) + slotCount * HISTORY_BLOCK_SIZE)) {
+        return;
+    }
+
+    File src = LittleFS.open(fileName, "r");
+    File dst = LittleFS.open(tmpName, "w");
+    if (!src || !dst) {
+        ESP_LOGE(TAG, "Failed to resize %s", fileName.c_str());
+        return;
+    }
+
+    FileHeader_t header = {};
+    header.magic = HISTORY_FILE_MAGIC;
+    header.version = HISTORY_FILE_VERSION;
+    header.slotCount = slotCount;
+    dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    // The slot at nextSlot of the averages contains the block which is currently recorded, it is written last
+    const uint16_t reserved = type == RING_AVERAGES ? 1 : 0;
+
+    // Keep the newest blocks, oldest first
+    std::vector<uint8_t> block(HISTORY_BLOCK_SIZE);
+    const uint16_t keep = std::min(ring.slots - reserved, slotCount - reserved);
+    uint16_t written = 0;
+    for (uint16_t i = ring.slots - keep; i < ring.slots; i++) {
+        const uint16_t slot = (ring.nextSlot + i) % ring.slots;
+        src.seek(sizeof(FileHeader_t) + slot * HISTORY_BLOCK_SIZE);
+        if (src.read(block.data(), HISTORY_BLOCK_SIZE) != HISTORY_BLOCK_SIZE
+            || reinterpret_cast<const BlockHeader_t*>(block.data())->sampleCount == 0) {
+            continue;
+        }
+        dst.write(block.data(), HISTORY_BLOCK_SIZE);
+        written++;
+    }
+    src.close();
+
+    header.nextSlot = written % slotCount;
+    if (reserved > 0 && !ring.current.empty()) {
+        dst.write(ring.current.data(), HISTORY_BLOCK_SIZE);
+        written++;
+    }
+
+    std::fill(block.begin(), block.end(), 0);
+    for (uint16_t i = written; i < slotCount; i++) {
+        dst.write(block.data(), HISTORY_BLOCK_SIZE);
+    }
+
+    dst.seek(0);
+    dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    const size_t size = dst.size();
+    dst.close();
+
+    if (size != sizeof(FileHeader_t) + slotCount * HISTORY_BLOCK_SIZE || !LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to resize %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return;
+    }
+
+    ring.slots = slotCount;
+    ring.nextSlot = header.nextSlot;
+    ESP_LOGI(TAG, "Resized %s to %" PRIu16 " blocks", fileName.c_str(), slotCount);
+}
+
+void HistoryClass::relayoutFiles()
+{
+    // Delete the files of removed inverters first to make room for the larger files of the others
+    File dir = LittleFS.open(HISTORY_DIR);
+    if (dir) {
+        bool isDir = false;
+        String file = dir.getNextFileName(&isDir);
+        while (file != "") {
+            const uint64_t serial = strtoull(file.substring(file.lastIndexOf('/') + 1).c_str(), nullptr, 16);
+            if (!isDir && Hoymiles.getInverterBySerial(serial) == nullptr) {
+                LittleFS.remove(file);
+                ESP_LOGI(TAG, "Removed %s", file.c_str());
+            }
+            file = dir.getNextFileName(&isDir);
+        }
+        dir.close();
+    }
+
+    _histories.erase(std::remove_if(_histories.begin(), _histories.end(),
+                         [](const std::unique_ptr<InverterHistory_t>& history) { return Hoymiles.getInverterBySerial(history->serial) == nullptr; }),
+        _histories.end());
+
+    for (auto& history : _histories) {
+        const size_t seriesCount = getSeries(history->serial).size();
+        for (uint8_t type = 0; type < RING_COUNT; type++) {
+            const uint16_t slotCount = getSlotCount(static_cast<RingType_t>(type), seriesCount);
+            if (history->rings[type].slots > 0 && history->rings[type].slots != slotCount) {
+                resizeFile(*history, static_cast<RingType_t>(type), slotCount);
+            }
+        }
+    }
+}
+
+void HistoryClass::restoreBlock(InverterHistory_t& history)
+{
+    auto& ring = history.rings[RING_AVERAGES];
+    const uint16_t previousSlot = (ring.nextSlot + ring.slots - 1) % ring.slots;
+
+    File f = LittleFS.open(getFileName(history.serial, RING_AVERAGES), "r");
+    if (!f) {
+        return;
+    }
+
+    BlockHeader_t previous = {};
+    std::vector<uint8_t> block(HISTORY_BLOCK_SIZE);
+
+    f.seek(sizeof(FileHeader_t) + previousSlot * HISTORY_BLOCK_SIZE);
+    const bool valid = f.read(reinterpret_cast<uint8_t*>(&previous), sizeof(previous)) == sizeof(previous)
+        && f.seek(sizeof(FileHeader_t) + ring.nextSlot * HISTORY_BLOCK_SIZE)
+        && f.read(block.data(), HISTORY_BLOCK_SIZE) == HISTORY_BLOCK_SIZE;
+    f.close();
+
+    auto header = reinterpret_cast<const BlockHeader_t*>(block.data());
+    if (!valid || header->sampleCount == 0 || header->interval != HISTORY_AVERAGE_INTERVAL
+        || header->seriesCount > HISTORY_MAX_SERIES || sizeof(BlockHeader_t) + header->dataLength > HISTORY_BLOCK_SIZE) {
+        return;
+    }
+
+    // The slot still contains the oldest block if the reboot happened before the first average of a new block
+    if (previous.sampleCount > 0 && previous.startMinute >= header->startMinute) {
+        return;
+    }
+
+    int32_t values[HISTORY_MAX_SERIES] = {};
+    const uint8_t* data = block.data() + sizeof(BlockHeader_t);
+    const uint8_t* dataEnd = data + header->dataLength;
+    for (uint16_t i = 0; i < header->sampleCount; i++) {
+        for (uint8_t s = 0; s < header->seriesCount; s++) {
+            int32_t delta;
+            if (!decodeValue(data, dataEnd, delta)) {
+                return;
+            }
+            values[s] += delta;
+        }
+    }
+
+    ring.current = std::move(block);
+    std::copy(values, values + HISTORY_MAX_SERIES, ring.lastValues);
+    ring.lastMinute = header->startMinute + (header->sampleCount - 1) * HISTORY_AVERAGE_INTERVAL;
+}
+
+std::vector<HistorySeries_t> HistoryClass::buildSeries(std::shared_ptr<InverterAbstract> inv)
+{
+    std::vector<HistorySeries_t> series;
+
+    auto addSeries = [&series, &inv](const ChannelType_t type, const ChannelNum_t channel, const FieldId_t field) {
+        if (series.size() < HISTORY_MAX_SERIES && inv->Statistics()->hasChannelFieldValue(type, channel, field)) {
+            series.push_back({ static_cast<uint8_t>(type), static_cast<uint8_t>(channel), static_cast<uint8_t>(field) });
+        }
+    };
+
+    addSeries(TYPE_AC, CH0, FLD_PAC);
+    addSeries(TYPE_AC, CH0, FLD_UAC);
+    addSeries(TYPE_INV, CH0, FLD_T);
+    for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        addSeries(TYPE_DC, c, FLD_PDC);
+        addSeries(TYPE_DC, c, FLD_UDC);
+    }
+
+    return series;
+}
+
+std::vector<HistorySeries_t> HistoryClass::getSeries(const uint64_t serial)
+{
+    auto inv = Hoymiles.getInverterBySerial(serial);
+    if (inv == nullptr) {
+        return {};
+    }
+    return buildSeries(inv);
+}
+
+void HistoryClass::startBlock(Ring_t& ring, const std::vector<HistorySeries_t>& series, const uint32_t minute, const uint8_t interval)
+{
+    ring.current.assign(HISTORY_BLOCK_SIZE, 0);
+
+    auto header = reinterpret_cast<BlockHeader_t*>(ring.current.data());
+    header->startMinute = minute;
+    header->interval = interval;
+    header->seriesCount = series.size();
+    std::copy(series.begin(), series.end(), header->series);
+
+    memset(ring.lastValues, 0, sizeof(ring.lastValues));
+}
+
+void HistoryClass::writeBlock(InverterHistory_t& history, const RingType_t type, const bool advance)
+{
+    auto& ring = history.rings[type];
+    if (ring.slots == 0) {
+        return;
+    }
+
+    File f = LittleFS.open(getFileName(history.serial, type), "r+");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", getFileName(history.serial, type).c_str());
+        return;
+    }
+
+    f.seek(sizeof(FileHeader_t) + ring.nextSlot * HISTORY_BLOCK_SIZE);
+    f.write(ring.current.data(), HISTORY_BLOCK_SIZE);
+
+    if (advance) {
+        ring.nextSlot = (ring.nextSlot + 1) % ring.slots;
+
+        FileHeader_t header = {};
+        header.magic = HISTORY_FILE_MAGIC;
+        header.version = HISTORY_FILE_VERSION;
+        header.slotCount = ring.slots;
+        header.nextSlot = ring.nextSlot;
+        f.seek(0);
+        f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    }
+    f.close();
+}
+
+void HistoryClass::closeBlock(InverterHistory_t& history, const RingType_t type)
+{
+    auto& ring = history.rings[type];
+    if (ring.current.empty() || reinterpret_cast<BlockHeader_t*>(ring.current.data())->sampleCount == 0) {
+        return;
+    }
+
+    if (type == RING_MINUTES && !history.ramSlots.empty()) {
+        memcpy(&history.ramSlots[history.ramNextSlot * HISTORY_BLOCK_SIZE], ring.current.data(), HISTORY_BLOCK_SIZE);
+        history.ramNextSlot = (history.ramNextSlot + 1) % HISTORY_RAM_SLOTS;
+    }
+
+    writeBlock(history, type, true);
+    ring.current.clear();
+}
+
+void HistoryClass::recordSample(InverterHistory_t& history, std::shared_ptr<InverterAbstract> inv, const uint32_t minute)
+{
+    const auto series = buildSeries(inv);
+
+    int32_t values[HISTORY_MAX_SERIES];
+    for (size_t s = 0; s < series.size(); s++) {
+        const float value = inv->Statistics()->getChannelFieldValue(
+            static_cast<ChannelType_t>(series[s].type), static_cast<ChannelNum_t>(series[s].channel), static_cast<FieldId_t>(series[s].field));
+        values[s] = lroundf(value * HISTORY_VALUE_SCALE);
+    }
+
+    appendSample(history, RING_MINUTES, minute, series, values);
+
+    // The average of an interval is stored with the start of the interval as soon as the next interval begins
+    const uint32_t intervalMinute = minute - minute % HISTORY_AVERAGE_INTERVAL;
+    if (history.sumCount > 0 && intervalMinute != history.sumMinute) {
+        if (history.sumSeriesCount == series.size()) {
+            int32_t averages[HISTORY_MAX_SERIES];
+            for (size_t s = 0; s < series.size(); s++) {
+                averages[s] = lroundf(static_cast<float>(history.sums[s]) / history.sumCount);
+            }
+            appendSample(history, RING_AVERAGES, history.sumMinute, series, averages);
+        }
+        history.sumCount = 0;
+    }
+
+    if (history.sumCount == 0) {
+        memset(history.sums, 0, sizeof(history.sums));
+        history.sumSeriesCount = series.size();
+        history.sumMinute = intervalMinute;
+    }
+    for (size_t s = 0; s < series.size(); s++) {
+        history.sums[s] += values[s];
+    }
+    history.sumCount++;
+}
+
+void HistoryClass::appendSample(InverterHistory_t& history, const RingType_t type, const uint32_t minute, const std::vector<HistorySeries_t>& series, const int32_t* values)
+{
+    auto& ring = history.rings[type];
+    const uint8_t interval = type == RING_AVERAGES ? HISTORY_AVERAGE_INTERVAL : 1;
+    auto header = reinterpret_cast<BlockHeader_t*>(ring.current.data());
+
+    // A block only contains consecutive samples of the same series. Start a new one after a gap.
+    // Each value needs at most 5 bytes.
+    if (ring.current.empty() || minute != ring.lastMinute + interval || header->seriesCount != series.size()
+        || sizeof(BlockHeader_t) + header->dataLength + series.size() * 5 > HISTORY_BLOCK_SIZE) {
+        closeBlock(history, type);
+        startBlock(ring, series, minute, interval);
+        header = reinterpret_cast<BlockHeader_t*>(ring.current.data());
+    }
+
+    uint8_t* data = ring.current.data() + sizeof(BlockHeader_t) + header->dataLength;
+    for (uint8_t s = 0; s < header->seriesCount; s++) {
+        data += encodeValue(values[s] - ring.lastValues[s], data);
+        ring.lastValues[s] = values[s];
+    }
+
+    header->dataLength = data - (ring.current.data() + sizeof(BlockHeader_t));
+    header->sampleCount++;
+    ring.lastMinute = minute;
+
+    // A block of averages takes hours to complete, don't lose it on a reboot
+    if (type == RING_AVERAGES) {
+        writeBlock(history, type, false);
+    }
+}
+
+uint32_t HistoryClass::getStep(const BlockHeader_t* header)
+{
+    return std::max<uint32_t>(header->interval, 1) * 60;
+}
+
+uint16_t HistoryClass::getRecordedSlotCount(const InverterHistory_t& history, const RingType_t type)
+{
+    return type == RING_MINUTES && !history.ramSlots.empty() ? HISTORY_RAM_SLOTS : history.rings[type].slots;
+}
+
+bool HistoryClass::copyBlock(const InverterHistory_t* history, const RingType_t type, File& f, const uint16_t slot, const uint32_t from, const uint32_t to, std::vector<uint8_t>& block)
+{
+    const bool ram = history != nullptr && type == RING_MINUTES && !history->ramSlots.empty();
+
+    if (ram) {
+        memcpy(block.data(), &history->ramSlots[slot * HISTORY_BLOCK_SIZE], HISTORY_BLOCK_SIZE);
+    } else {
+        f.seek(sizeof(FileHeader_t) + slot * HISTORY_BLOCK_SIZE);
+        if (f.read(block.data(), sizeof(BlockHeader_t)) != sizeof(BlockHeader_t)) {
+            return false;
+        }
+    }
+
+    // Skip blocks outside of the requested range without reading their data
+    auto header = reinterpret_cast<const BlockHeader_t*>(block.data());
+    const uint32_t blockStart = header->startMinute * 60;
+    if (header->sampleCount == 0 || blockStart > to || blockStart + (header->sampleCount - 1) * getStep(header) < from) {
+        return false;
+    }
+
+    if (!ram) {
+        const size_t dataSize = HISTORY_BLOCK_SIZE - sizeof(BlockHeader_t);
+        if (f.read(block.data() + sizeof(BlockHeader_t), dataSize) != dataSize) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint16_t HistoryClass::getFirstSlot(const InverterHistory_t& history, const RingType_t type)
+{
+    if (type == RING_MINUTES && !history.ramSlots.empty()) {
+        return history.ramNextSlot;
+    }
+
+    // The slot at nextSlot of the averages contains the block which is currently recorded
+    const auto& ring = history.rings[type];
+    return type == RING_AVERAGES && ring.slots > 0 ? (ring.nextSlot + 1) % ring.slots : ring.nextSlot;
+}
+
+bool HistoryClass::openRing(HistoryCursor_t& cursor, const RingType_t type)
+{
+    cursor.ring = type;
+    cursor.slotCount = 0;
+    cursor.slot = 0;
+    cursor.remaining = 0;
+    cursor.currentCopied = false;
+    cursor.block.clear();
+
+    const String fileName = getFileName(cursor.serial, type);
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Reading never creates or resizes a file. Without a recorded history (e.g. before the
+    // time is synchronized) the layout is taken from the file header.
+    auto history = getInverterHistory(cursor.serial, false);
+    cursor.recorded = history != nullptr;
+
+    if (history != nullptr) {
+        cursor.slotCount = getRecordedSlotCount(*history, type);
+        cursor.slot = getFirstSlot(*history, type);
+    } else if (LittleFS.exists(fileName)) {
+        File f = LittleFS.open(fileName, "r");
+        FileHeader_t header = {};
+        if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header)
+            && header.magic == HISTORY_FILE_MAGIC && header.version == HISTORY_FILE_VERSION
+            && header.nextSlot < header.slotCount) {
+            cursor.slotCount = header.slotCount;
+            cursor.slot = type == RING_AVERAGES ? (header.nextSlot + 1) % header.slotCount : header.nextSlot;
+        }
+    } else {
+        return false;
+    }
+    cursor.remaining = cursor.slotCount;
+
+    return true;
+}
+
+bool HistoryClass::copyNextBlock(HistoryCursor_t& cursor, const uint32_t to)
+{
+    // The blocks are copied one at a time while holding the lock and decoded without it, so a slow
+    // reader (e.g. a web response waiting for the client) does not block the recording.
+    const auto type = static_cast<RingType_t>(cursor.ring);
+    cursor.block.resize(HISTORY_BLOCK_SIZE);
+    File f;
+
+    while (cursor.slotCount > 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Stop if the history was created or the ring was resized in the meantime
+        auto history = getInverterHistory(cursor.serial, false);
+        if ((history != nullptr) != cursor.recorded || (history != nullptr && getRecordedSlotCount(*history, type) != cursor.slotCount)) {
+            break;
+        }
+
+        // Blocks closed while reading were written behind the ones already copied
+        if (cursor.remaining == 0 && history != nullptr) {
+            cursor.remaining = (getFirstSlot(*history, type) + cursor.slotCount - cursor.slot) % cursor.slotCount;
+        }
+        if (cursor.remaining == 0) {
+            break;
+        }
+
+        const uint16_t slot = cursor.slot;
+        cursor.slot = (cursor.slot + 1) % cursor.slotCount;
+        cursor.remaining--;
+
+        const bool ram = history != nullptr && type == RING_MINUTES && !history->ramSlots.empty();
+        if (!ram && !f) {
+            const String fileName = getFileName(cursor.serial, type);
+            if (LittleFS.exists(fileName)) {
+                f = LittleFS.open(fileName, "r");
+            }
+            if (!f) {
+                break;
+            }
+        }
+
+        if (copyBlock(history, type, f, slot, cursor.start, to, cursor.block)) {
+            return true;
+        }
+    }
+    cursor.slotCount = 0;
+    f.close();
+
+    if (!cursor.currentCopied) {
+        cursor.currentCopied = true;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto history = getInverterHistory(cursor.serial, false);
+        if (history != nullptr && !history->rings[type].current.empty()) {
+            std::copy(history->rings[type].current.begin(), history->rings[type].current.end(), cursor.block.begin());
+            return true;
+        }
+    }
+
+    cursor.block.clear();
+    return false;
+}
+
+bool HistoryClass::openCursor(const uint64_t serial, const uint32_t from, const uint32_t to, HistoryCursor_t& cursor)
+{
+    const uint32_t now = time(nullptr);
+    const uint32_t oldest = now > HISTORY_RETENTION ? now - HISTORY_RETENTION : 0;
+
+    cursor = HistoryCursor_t();
+    cursor.serial = serial;
+    cursor.start = std::max(from, oldest);
+    cursor.to = to;
+
+    if (!openRing(cursor, RING_MINUTES)) {
+        return false;
+    }
+
+    // The averages are only used before the oldest one minute sample of the range
+    cursor.minutesStart = UINT32_MAX;
+    if (copyNextBlock(cursor, UINT32_MAX)) {
+        cursor.minutesStart = reinterpret_cast<const BlockHeader_t*>(cursor.block.data())->startMinute * 60;
+    }
+
+    if (cursor.minutesStart <= cursor.start || !openRing(cursor, RING_AVERAGES)) {
+        openRing(cursor, RING_MINUTES);
+    }
+    cursor.finished = false;
+
+    return true;
+}
+
+bool HistoryClass::readCursor(HistoryCursor_t& cursor, const size_t maxSamples, const HistorySampleVisitor& visitor)
+{
+    size_t visited = 0;
+    float scaled[HISTORY_MAX_SERIES];
+
+    while (!cursor.finished) {
+        // The last block of averages can reach beyond the oldest one minute sample, which is visited from the minutes
+        const uint32_t end = cursor.ring == RING_AVERAGES ? std::min(cursor.to, cursor.minutesStart - 1) : cursor.to;
+
+        if (cursor.block.empty()) {
+            if (!copyNextBlock(cursor, end)) {
+                if (cursor.ring != RING_AVERAGES || !openRing(cursor, RING_MINUTES)) {
+                    cursor.finished = true;
+                }
+                continue;
+            }
+
+            auto header = reinterpret_cast<const BlockHeader_t*>(cursor.block.data());
+            if (header->seriesCount > HISTORY_MAX_SERIES || sizeof(BlockHeader_t) + header->dataLength > HISTORY_BLOCK_SIZE) {
+                ESP_LOGW(TAG, "Skipped corrupt block of %s", getFileName(cursor.serial, static_cast<RingType_t>(cursor.ring)).c_str());
+                cursor.block.clear();
+                continue;
+            }
+
+            cursor.sample = 0;
+            cursor.offset = sizeof(BlockHeader_t);
+            memset(cursor.values, 0, sizeof(cursor.values));
+        }
+
+        auto header = reinterpret_cast<const BlockHeader_t*>(cursor.block.data());
+        const uint32_t step = getStep(header);
+        const uint8_t* dataEnd = cursor.block.data() + sizeof(BlockHeader_t) + header->dataLength;
+
+        for (; cursor.sample < header->sampleCount; cursor.sample++) {
+            const uint32_t timestamp = header->startMinute * 60 + cursor.sample * step;
+            if (timestamp > end) {
+                break;
+            }
+            if (timestamp >= cursor.start && visited == maxSamples) {
+                return true;
+            }
+
+            const uint8_t* data = cursor.block.data() + cursor.offset;
+            bool valid = true;
+            for (uint8_t s = 0; s < header->seriesCount; s++) {
+                int32_t delta;
+                if (!decodeValue(data, dataEnd, delta)) {
+                    valid = false;
+                    break;
+                }
+                cursor.values[s] += delta;
+                scaled[s] = static_cast<float>(cursor.values[s]) / HISTORY_VALUE_SCALE;
+            }
+            if (!valid) {
+                ESP_LOGW(TAG, "Skipped corrupt block of %s", getFileName(cursor.serial, static_cast<RingType_t>(cursor.ring)).c_str());
+                break;
+            }
+            cursor.offset = data - cursor.block.data();
+
+            // Blocks written in the meantime must not repeat samples which were already visited
+            if (timestamp >= cursor.start) {
+                visitor(timestamp, header->seriesCount, header->series, scaled);
+                cursor.start = timestamp + 1;
+                visited++;
+            }
+        }
+        cursor.block.clear();
+    }
+
+    return false;
+}
+
+bool HistoryClass::forEachSample(const uint64_t serial, const uint32_t from, const uint32_t to, const HistorySampleVisitor& visitor)
+{
+    HistoryCursor_t cursor;
+    if (!openCursor(serial, from, to, cursor)) {
+        return false;
+    }
+
+    readCursor(cursor, SIZE_MAX, visitor);
+    return true;
+}
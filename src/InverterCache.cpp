@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Keeps the device info, grid profile and the last known limit of every inverter in LittleFS.
+
+After a reboot these requests would otherwise have to be sent to every inverter before the
+data is complete. The restored data is marked as cached. Hoymiles revalidates it in the
+background if the radio is idle, until the inverter has confirmed it. The file is only rewritten if its content has changed.
+*/
+#include "InverterCache.h"
+#include "Utils.h"
+#include <LittleFS.h>
+
+#undef TAG
+static const char* TAG = "invcache";
+
+InverterCacheClass InverterCache;
+
+InverterCacheClass::InverterCacheClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&InverterCacheClass::loop, this))
+{
+}
+
+void InverterCacheClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(INVERTER_CACHE_DIR)) {
+        LittleFS.mkdir(INVERTER_CACHE_DIR);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+String InverterCacheClass::getFileName(const uint64_t serial)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), INVERTER_CACHE_DIR "/%0" PRIx32 "%08" PRIx32 ".bin",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF));
+    return fileName;
+}
+
+uint32_t InverterCacheClass::getChecksum(const CacheFile_t& data)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&data);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        hash = (hash ^ p[i]) * 16777619;
+    }
+    return hash;
+}
+
+void InverterCacheClass::loop()
+{
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        InverterState_t* state = nullptr;
+        for (auto& s : _states) {
+            if (s.serial == inv->serial()) {
+                state = &s;
+                break;
+            }
+        }
+
+        // Inverters are restored when they are seen for the first time, also if they are added at runtime
+        if (state == nullptr) {
+            _states.emplace_back();
+            state = &_states.back();
+            state->serial = inv->serial();
+            restore(*state, inv);
+            continue;
+        }
+
+        update(*state, inv);
+    }
+}
+
+void InverterCacheClass::restore(InverterState_t& state, std::shared_ptr<InverterAbstract> inv)
+{
+    CacheFile_t data = {};
+
+    File f = LittleFS.open(getFileName(inv->serial()), "r");
+    if (!f) {
+        return;
+    }
+    const size_t len = f.read(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+    f.close();
+
+    if (len != sizeof(data) || data.magic != INVERTER_CACHE_FILE_MAGIC || data.version != INVERTER_CACHE_FILE_VERSION) {
+        ESP_LOGW(TAG, "Ignored invalid %s", getFileName(inv->serial()).c_str());
+        return;
+    }
+    state.checksum = getChecksum(data);
+
+    // Don't overwrite data which was already received from the inverter
+    if (data.devInfoAllLength > 0 && data.devInfoSimpleLength > 0 && inv->DevInfo()->getLastUpdate() == 0) {
+        inv->DevInfo()->clearBufferAll();
+        inv->DevInfo()->appendFragmentAll(0, data.devInfoAll, std::min<uint8_t>(data.devInfoAllLength, DEV_INFO_SIZE));
+        inv->DevInfo()->setLastUpdateAll(millis());
+
+        inv->DevInfo()->clearBufferSimple();
+        inv->DevInfo()->appendFragmentSimple(0, data.devInfoSimple, std::min<uint8_t>(data.devInfoSimpleLength, DEV_INFO_SIZE));
+        inv->DevInfo()->setLastUpdateSimple(millis());
+
+        inv->DevInfo()->setCached(true);
+        state.devInfoUpdate = inv->DevInfo()->getLastUpdate();
+    }
+
+    if (data.gridProfileLength > 0 && inv->GridProfile()->getLastUpdate() == 0) {
+        inv->GridProfile()->clearBuffer();
+        inv->GridProfile()->appendFragment(0, data.gridProfile, std::min<uint8_t>(data.gridProfileLength, GRID_PROFILE_SIZE));
+        inv->GridProfile()->setLastUpdate(millis());
+
+        inv->GridProfile()->setCached(true);
+        state.gridProfileUpdate = inv->GridProfile()->getLastUpdate();
+    }
+
+    if (data.hasLimit && inv->SystemConfigPara()->getLastUpdate() == 0) {
+        // The request timestamp is left alone, so the regular poll is not delayed
+        inv->SystemConfigPara()->setLimitPercent(data.limitPercent);
+        inv->SystemConfigPara()->setLastUpdate(millis());
+        inv->SystemConfigPara()->setCached(true);
+    }
+
+    ESP_LOGI(TAG, "Restored cached data of %s", inv->serialString().c_str());
+}
+
+void InverterCacheClass::update(InverterState_t& state, std::shared_ptr<InverterAbstract> inv)
+{
+    const uint32_t devInfoUpdate = inv->DevInfo()->getLastUpdate();
+    const uint32_t gridProfileUpdate = inv->GridProfile()->getLastUpdate();
+    const uint32_t limitUpdate = inv->SystemConfigPara()->getLastUpdateRequest();
+
+    if (devInfoUpdate == state.devInfoUpdate && gridProfileUpdate == state.gridProfileUpdate && limitUpdate == state.limitUpdate) {
+        return;
+    }
+    state.devInfoUpdate = devInfoUpdate;
+    state.gridProfileUpdate = gridProfileUpdate;
+    state.limitUpdate = limitUpdate;
+
+    CacheFile_t data = {};
+    data.magic = INVERTER_CACHE_FILE_MAGIC;
+    data.version = INVERTER_CACHE_FILE_VERSION;
+
+    if (inv->DevInfo()->containsValidData()) {
+        const auto all = inv->DevInfo()->getRawDataAll();
+        const auto simple = inv->DevInfo()->getRawDataSimple();
+        data.devInfoAllLength = std::min<size_t>(all.size(), DEV_INFO_SIZE);
+        memcpy(data.devInfoAll, all.data(), data.devInfoAllLength);
+        data.devInfoSimpleLength = std::min<size_t>(simple.size(), DEV_INFO_SIZE);
+        memcpy(data.devInfoSimple, simple.data(), data.devInfoSimpleLength);
+    }
+
+    if (inv->GridProfile()->containsValidData()) {
+        const auto raw = inv->GridProfile()->getRawData();
+        data.gridProfileLength = std::min<size_t>(raw.size(), GRID_PROFILE_SIZE);
+        memcpy(data.gridProfile, raw.data(), data.gridProfileLength);
+    }
+
+    // Keep a restored limit until the inverter reports one
+    if (limitUpdate > 0 || inv->SystemConfigPara()->isCached()) {
+        data.hasLimit = 1;
+        data.limitPercent = inv->SystemConfigPara()->getLimitPercent();
+    }
+
+    // Most revalidations return the same data. Don't wear the flash in this case.
+    const uint32_t checksum = getChecksum(data);
+    if (checksum == state.checksum) {
+        return;
+    }
+
+    const String fileName = getFileName(inv->serial());
+    const String tmpName = fileName + ".tmp";
+
+    if (!Utils::hasFreeSpace(sizeof(data))) {
+        return;
+    }
+
+    File f = LittleFS.open(tmpName, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", tmpName.c_str());
+        return;
+    }
+    const size_t len = f.write(reinterpret_cast<const uint8_t*>(&data), sizeof(data));
+    f.close();
+
+    if (len != sizeof(data) || !LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to write %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return;
+    }
+
+    state.checksum = checksum;
+}
@@ -3,6 +3,7 @@
  * Copyright (C) 2023-2026 Thomas Basler and others
  */
 #include "InverterSettings.h"
+#include "BootProfiler.h"
 #include "Configuration.h"
 #include "PinMapping.h"
 #include "SunPosition.h"
@@ -14,6 +15,44 @@ static const char* TAG = "invertersetup";
 
 InverterSettingsClass InverterSettings;
 
+static void applyInverterSettings(std::shared_ptr<InverterAbstract> inv, const INVERTER_CONFIG_T& inv_cfg)
+{
+    inv->setReachableThreshold(inv_cfg.ReachableThreshold);
+    inv->setZeroValuesIfUnreachable(inv_cfg.ZeroRuntimeDataIfUnrechable);
+    inv->setZeroYieldDayOnMidnight(inv_cfg.ZeroYieldDayOnMidnight);
+    inv->setClearEventlogOnMidnight(inv_cfg.ClearEventlogOnMidnight);
+    inv->Statistics()->setYieldDayCorrection(inv_cfg.YieldDayCorrection);
+}
+
+static void applyChannelSettings(std::shared_ptr<InverterAbstract> inv, const INVERTER_CONFIG_T& inv_cfg)
+{
+    for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
+        inv->Statistics()->setStringMaxPower(c, inv_cfg.channel[c].MaxChannelPower);
+        inv->Statistics()->setChannelFieldOffset(TYPE_DC, static_cast<ChannelNum_t>(c), FLD_YT, inv_cfg.channel[c].YieldTotalOffset);
+    }
+}
+
+static std::shared_ptr<InverterAbstract> addInverter(const INVERTER_CONFIG_T& inv_cfg, const uint8_t index)
+{
+    ESP_LOGI(TAG, "Adding inverter: %0" PRIx32 "%08" PRIx32 " - %s",
+        static_cast<uint32_t>((inv_cfg.Serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(inv_cfg.Serial & 0xFFFFFFFF),
+        inv_cfg.Name);
+
+    auto inv = Hoymiles.addInverter(inv_cfg.Name, inv_cfg.Serial);
+    if (inv == nullptr) {
+        ESP_LOGW(TAG, "Adding inverter failed: Unsupported type");
+        return nullptr;
+    }
+
+    inv->setConfigIndex(index);
+    applyInverterSettings(inv, inv_cfg);
+    applyChannelSettings(inv, inv_cfg);
+
+    ESP_LOGI(TAG, "Adding complete");
+    return inv;
+}
+
 InverterSettingsClass::InverterSettingsClass()
     : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, std::bind(&InverterSettingsClass::settingsLoop, this))
     , _hoyTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&InverterSettingsClass::hoyLoop, this))
@@ -22,8 +61,11 @@ InverterSettingsClass::InverterSettingsClass()
 
 void InverterSettingsClass::init(Scheduler& scheduler)
 {
-    const CONFIG_T& config = Configuration.get();
-    const PinMapping_t& pin = PinMapping.get();
+    using std::placeholders::_1;
+
+    const auto config = Configuration.get();
+
+    Configuration.onChange(std::bind(&InverterSettingsClass::onConfigChange, this, _1));
 
     // Initialize inverter communication
     ESP_LOGI(TAG, "Initialize Hoymiles interface...");
@@ -34,6 +76,47 @@ void InverterSettingsClass::init(Scheduler& scheduler)
         return;
     }
 
+    ESP_LOGI(TAG, "RF: Setting poll interval...");
+    Hoymiles.setPollInterval(config->Dtu.PollInterval);
+
+    // Configure inverters
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        if (config->Inverter[i].Serial != 0) {
+            addInverter(config->Inverter[i], i);
+        }
+    }
+
+    // Network, web server and display are initialized in the meantime
+    if (xTaskCreatePinnedToCore(radioInitTask, "radio_init", INVERTER_RADIO_INIT_STACK_SIZE, this, 1, nullptr, INVERTER_RADIO_INIT_CORE) != pdPASS) {
+        ESP_LOGW(TAG, "Starting radio task failed, initializing in foreground");
+        initRadio();
+    }
+    ESP_LOGI(TAG, "Initialization complete");
+
+    scheduler.addTask(_hoyTask);
+    _hoyTask.enable();
+
+    scheduler.addTask(_settingsTask);
+    _settingsTask.enable();
+}
+
+bool InverterSettingsClass::isRadioReady() const
+{
+    return _radioReady;
+}
+
+void InverterSettingsClass::radioInitTask(void* parameter)
+{
+    static_cast<InverterSettingsClass*>(parameter)->initRadio();
+    vTaskDelete(nullptr);
+}
+
+void InverterSettingsClass::initRadio()
+{
+    const uint32_t start = millis();
+    const auto config = Configuration.get();
+    const PinMapping_t& pin = PinMapping.get();
+
     // Initialize NRF24 if configured
     if (PinMapping.isValidNrf24Config()) {
         ESP_LOGI(TAG, "NRF: Initialize communication");
@@ -50,69 +133,110 @@ void InverterSettingsClass::init(Scheduler& scheduler)
         ESP_LOGI(TAG, "CMT2300A: Initialize communication");
         Hoymiles.initCMT(pin.cmt_sdio, pin.cmt_clk, pin.cmt_cs, pin.cmt_fcs, pin.cmt_gpio2, pin.cmt_gpio3);
         ESP_LOGI(TAG, "CMT2300A: Setting country mode...");
-        Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config.Dtu.Cmt.CountryMode));
+        Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config->Dtu.Cmt.CountryMode));
         ESP_LOGI(TAG, "CMT2300A: Setting CMT target frequency...");
-        Hoymiles.getRadioCmt()->setInverterTargetFrequency(config.Dtu.Cmt.Frequency);
+        Hoymiles.getRadioCmt()->setInverterTargetFrequency(config->Dtu.Cmt.Frequency);
     }
 
     // Configure common radio settings
     ESP_LOGI(TAG, "RF: Setting radio PA level...");
-    Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config.Dtu.Nrf.PaLevel);
-    Hoymiles.getRadioCmt()->setPALevel(config.Dtu.Cmt.PaLevel);
+    Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config->Dtu.Nrf.PaLevel);
+    Hoymiles.getRadioCmt()->setPALevel(config->Dtu.Cmt.PaLevel);
 
     ESP_LOGI(TAG, "RF: Setting DTU serial...");
-    Hoymiles.getRadioNrf()->setDtuSerial(config.Dtu.Serial);
-    Hoymiles.getRadioCmt()->setDtuSerial(config.Dtu.Serial);
+    Hoymiles.getRadioNrf()->setDtuSerial(config->Dtu.Serial);
+    Hoymiles.getRadioCmt()->setDtuSerial(config->Dtu.Serial);
 
-    ESP_LOGI(TAG, "RF: Setting poll interval...");
-    Hoymiles.setPollInterval(config.Dtu.PollInterval);
+    BootProfiler.addStage("radio", start);
+    _radioReady = true;
+}
+
+void InverterSettingsClass::onConfigChange(const ConfigDiff_t& diff)
+{
+    _pendingDiff.merge(diff);
+    if (!_radioReady) {
+        return;
+    }
+
+    applyConfigChange(_pendingDiff);
+    _pendingDiff = ConfigDiff_t();
+}
+
+void InverterSettingsClass::applyConfigChange(const ConfigDiff_t& diff)
+{
+    const auto config = Configuration.get();
+
+    // Only changed values are applied to keep the state of the radios
+    if (diff.DtuNrfPaLevel) {
+        Hoymiles.getRadioNrf()->setPALevel((rf24_pa_dbm_e)config->Dtu.Nrf.PaLevel);
+    }
+    if (diff.DtuCmtPaLevel) {
+        Hoymiles.getRadioCmt()->setPALevel(config->Dtu.Cmt.PaLevel);
+    }
+    if (diff.DtuSerial) {
+        Hoymiles.getRadioNrf()->setDtuSerial(config->Dtu.Serial);
+        Hoymiles.getRadioCmt()->setDtuSerial(config->Dtu.Serial);
+    }
+    if (diff.DtuCmtCountryMode) {
+        Hoymiles.getRadioCmt()->setCountryMode(static_cast<CountryModeId_t>(config->Dtu.Cmt.CountryMode));
+    }
+    if (diff.DtuCmtCountryMode || diff.DtuCmtFrequency) {
+        Hoymiles.getRadioCmt()->setInverterTargetFrequency(config->Dtu.Cmt.Frequency);
+    }
+    if (diff.DtuPollInterval) {
+        Hoymiles.setPollInterval(config->Dtu.PollInterval);
+    }
+
+    if (diff.InverterSerial.any()) {
+        // Remove inverters which were deleted or got a new serial
+        for (uint8_t i = Hoymiles.getNumInverters(); i-- > 0;) {
+            const uint64_t serial = Hoymiles.getInverterByPos(i)->serial();
+            if (Configuration.getInverterConfig(serial) == nullptr) {
+                Hoymiles.removeInverterBySerial(serial);
+            }
+        }
+    }
 
-    // Configure inverters
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        const auto& inv_cfg = config.Inverter[i];
+        const auto& inv_cfg = config->Inverter[i];
         if (inv_cfg.Serial == 0) {
             continue;
         }
 
-        ESP_LOGI(TAG, "Adding inverter: %0" PRIx32 "%08" PRIx32 " - %s",
-            static_cast<uint32_t>((inv_cfg.Serial >> 32) & 0xFFFFFFFF),
-            static_cast<uint32_t>(inv_cfg.Serial & 0xFFFFFFFF),
-            inv_cfg.Name);
-
-        auto inv = Hoymiles.addInverter(inv_cfg.Name, inv_cfg.Serial);
+        auto inv = Hoymiles.getInverterBySerial(inv_cfg.Serial);
         if (inv == nullptr) {
-            ESP_LOGW(TAG, "Adding inverter failed: Unsupported type");
+            if (diff.InverterSerial[i]) {
+                addInverter(inv_cfg, i);
+            }
             continue;
         }
 
-        inv->setReachableThreshold(inv_cfg.ReachableThreshold);
-        inv->setZeroValuesIfUnreachable(inv_cfg.ZeroRuntimeDataIfUnrechable);
-        inv->setZeroYieldDayOnMidnight(inv_cfg.ZeroYieldDayOnMidnight);
-        inv->setClearEventlogOnMidnight(inv_cfg.ClearEventlogOnMidnight);
-        inv->Statistics()->setYieldDayCorrection(inv_cfg.YieldDayCorrection);
-        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            inv->Statistics()->setStringMaxPower(c, inv_cfg.channel[c].MaxChannelPower);
-            inv->Statistics()->setChannelFieldOffset(TYPE_DC, static_cast<ChannelNum_t>(c), FLD_YT, inv_cfg.channel[c].YieldTotalOffset);
-        }
+        inv->setConfigIndex(i);
 
-        ESP_LOGI(TAG, "Adding complete");
+        // Channel names and the order are only used by the web interface
+        if (diff.InverterName[i]) {
+            inv->setName(inv_cfg.Name);
+        }
+        if (diff.InverterSettings[i]) {
+            applyInverterSettings(inv, inv_cfg);
+        }
+        if (diff.InverterChannel[i]) {
+            applyChannelSettings(inv, inv_cfg);
+        }
     }
-    ESP_LOGI(TAG, "Initialization complete");
-
-    scheduler.addTask(_hoyTask);
-    _hoyTask.enable();
 
-    scheduler.addTask(_settingsTask);
-    _settingsTask.enable();
+    if (diff.InverterSerial.any() || diff.InverterSettings.any()) {
+        settingsLoop();
+    }
 }
 
 void InverterSettingsClass::settingsLoop()
 {
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
     const bool isDayPeriod = SunPosition.isDayPeriod();
 
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        auto const& inv_cfg = config.Inverter[i];
+        auto const& inv_cfg = config->Inverter[i];
         if (inv_cfg.Serial == 0) {
             continue;
         }
@@ -128,5 +252,16 @@ void InverterSettingsClass::settingsLoop()
 
 void InverterSettingsClass::hoyLoop()
 {
+    // Inverters are polled once the radio task is done
+    if (!_radioReady) {
+        return;
+    }
+
+    // Changes made during the initialization
+    if (_pendingDiff.any()) {
+        applyConfigChange(_pendingDiff);
+        _pendingDiff = ConfigDiff_t();
+    }
+
     Hoymiles.loop();
 }
@@ -29,7 +29,8 @@ const std::vector<String>& LoggingClass::getConfigurableModules() const
 
 void LoggingClass::applyLogLevels()
 {
-    const auto& config = Configuration.get().Logging;
+    const auto snapshot = Configuration.get();
+    const auto& config = snapshot->Logging;
 
     ESP_LOGD(TAG, "Set default log level: %" PRId8, config.Default);
     esp_log_level_set("*", static_cast<esp_log_level_t>(config.Default));
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Keeps the measurements which could not be published while the broker was not reachable.
+
+Every new data set of an inverter received while MQTT is disconnected is stored as a
+record together with a record containing the totals of all inverters. The records are
+kept in a ring buffer in PSRAM (or a small one in RAM), the oldest record is overwritten
+if it is full. After the next connect the records are published oldest first to
+<prefix>backfill/<serial> and <prefix>backfill/total, a few records at a time and only
+while the MQTT outbox is empty, so live values are not delayed.
+*/
+#include "MqttBackfill.h"
+#include "Configuration.h"
+#include "Datastore.h"
+#include "MqttSettings.h"
+#include <Hoymiles.h>
+#include <ctime>
+
+#undef TAG
+static const char* TAG = "mqtt";
+
+MqttBackfillClass MqttBackfill;
+
+MqttBackfillClass::MqttBackfillClass()
+    : _loopTask(MQTT_BACKFILL_REPLAY_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&MqttBackfillClass::loop, this))
+{
+}
+
+void MqttBackfillClass::init(Scheduler& scheduler)
+{
+    _capacity = psramFound() ? MQTT_BACKFILL_PSRAM_RECORDS : MQTT_BACKFILL_RAM_RECORDS;
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void MqttBackfillClass::loop()
+{
+    if (!Configuration.get()->Mqtt.Enabled) {
+        return;
+    }
+
+    if (MqttSettings.getConnected()) {
+        replay();
+    } else {
+        capture();
+    }
+}
+
+bool MqttBackfillClass::hasNewData(const uint64_t serial, const uint32_t lastUpdate)
+{
+    for (auto& entry : _lastUpdates) {
+        if (entry.Serial == serial) {
+            const bool changed = entry.LastUpdate != lastUpdate;
+            entry.LastUpdate = lastUpdate;
+            return changed;
+        }
+    }
+
+    // Data received before the first outage was published already
+    _lastUpdates.push_back({ serial, lastUpdate });
+    return false;
+}
+
+void MqttBackfillClass::capture()
+{
+    // Records without a valid time are useless for the backfill
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+    const uint32_t now = time(nullptr);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool captured = false;
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        const uint32_t lastUpdate = inv->Statistics()->getLastUpdate();
+        if (lastUpdate == 0 || !hasNewData(inv->serial(), lastUpdate)) {
+            continue;
+        }
+
+        Record_t record;
+        record.Timestamp = now;
+        record.Serial = inv->serial();
+        record.AcPower = inv->Statistics()->getChannelFieldValue(TYPE_AC, CH0, FLD_PAC);
+        record.DcPower = inv->Statistics()->getChannelFieldValue(TYPE_INV, CH0, FLD_PDC);
+        record.YieldDay = inv->Statistics()->getChannelFieldValue(TYPE_INV, CH0, FLD_YD);
+        record.YieldTotal = inv->Statistics()->getChannelFieldValue(TYPE_INV, CH0, FLD_YT);
+        push(record);
+        captured = true;
+    }
+
+    if (captured) {
+        Record_t record;
+        record.Timestamp = now;
+        record.Serial = MQTT_BACKFILL_TOTAL_SERIAL;
+        record.AcPower = Datastore.getTotalAcPowerEnabled();
+        record.DcPower = Datastore.getTotalDcPowerEnabled();
+        record.YieldDay = Datastore.getTotalAcYieldDayEnabled();
+        record.YieldTotal = Datastore.getTotalAcYieldTotalEnabled();
+        push(record);
+    }
+}
+
+void MqttBackfillClass::push(const Record_t& record)
+{
+    if (_records.empty()) {
+        try {
+            _records.resize(_capacity);
+        } catch (const std::bad_alloc&) {
+            ESP_LOGE(TAG, "Not enough memory for the backfill buffer");
+            _records.clear();
+            _dropped++;
+            return;
+        }
+    }
+
+    if (_count == _records.size()) {
+        // Overwrite the oldest record
+        _head = (_head + 1) % _records.size();
+        _count--;
+        _dropped++;
+    }
+
+    _records[(_head + _count) % _records.size()] = record;
+    _count++;
+    _captured++;
+}
+
+void MqttBackfillClass::replay()
+{
+    // Values received while connected are published live
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv != nullptr) {
+            hasNewData(inv->serial(), inv->Statistics()->getLastUpdate());
+        }
+    }
+
+    if (MqttSettings.getOutboxStats().Messages > 0) {
+        return;
+    }
+
+    const String prefix = MqttSettings.getPrefix() + MQTT_BACKFILL_TOPIC;
+    char topic[MQTT_MAX_TOPIC_STRLEN + sizeof(MQTT_BACKFILL_TOPIC) + 20];
+    char payload[160];
+
+    for (uint8_t i = 0; i < MQTT_BACKFILL_REPLAY_BATCH; i++) {
+        // The record stays in the buffer until it was handed to the client
+        Record_t record;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_count == 0) {
+                return;
+            }
+            record = _records[_head];
+        }
+
+        if (record.Serial == MQTT_BACKFILL_TOTAL_SERIAL) {
+            snprintf(topic, sizeof(topic), "%stotal", prefix.c_str());
+        } else {
+            snprintf(topic, sizeof(topic), "%s%0" PRIx32 "%08" PRIx32, prefix.c_str(),
+                static_cast<uint32_t>((record.Serial >> 32) & 0xFFFFFFFF),
+                static_cast<uint32_t>(record.Serial & 0xFFFFFFFF));
+        }
+
+        snprintf(payload, sizeof(payload),
+            "{\"time\":%" PRIu32 ",\"ac_power\":%.1f,\"dc_power\":%.1f,\"yieldday\":%.0f,\"yieldtotal\":%.3f}",
+            record.Timestamp, record.AcPower, record.DcPower, record.YieldDay, record.YieldTotal);
+
+        // QoS 1 as the records are not retained and would be lost otherwise
+        if (!MqttSettings.publishGeneric(topic, payload, false, 1, MqttPriority::Normal)) {
+            return;
+        }
+
+        // Still waiting in the outbox, which is cleared by a disconnect. The record is published
+        // again by the next replay, a copy still in the outbox is replaced by it.
+        if (MqttSettings.getOutboxStats().Messages > 0) {
+            return;
+        }
+
+        // Capture and replay run in the same task, the oldest record is still the same
+        std::lock_guard<std::mutex> lock(_mutex);
+        _head = (_head + 1) % _records.size();
+        _count--;
+        _replayed++;
+    }
+}
+
+MqttBackfillStats_t MqttBackfillClass::getStats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    MqttBackfillStats_t stats;
+    stats.Records = _count;
+    stats.Capacity = _capacity;
+    stats.Captured = _captured;
+    stats.Dropped = _dropped;
+    stats.Replayed = _replayed;
+    return stats;
+}
@@ -19,33 +19,33 @@ MqttHandleDtuClass::MqttHandleDtuClass()
 void MqttHandleDtuClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.get()->Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
 }
 
 void MqttHandleDtuClass::loop()
 {
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.get()->Mqtt.PublishInterval * TASK_SECOND);
 
     if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
 
-    MqttSettings.publish("dtu/uptime", String(esp_timer_get_time() / 1000000));
-    MqttSettings.publish("dtu/ip", NetworkSettings.localIP().toString());
-    MqttSettings.publish("dtu/hostname", NetworkSettings.getHostname());
-    MqttSettings.publish("dtu/heap/size", String(ESP.getHeapSize()));
-    MqttSettings.publish("dtu/heap/free", String(ESP.getFreeHeap()));
-    MqttSettings.publish("dtu/heap/minfree", String(ESP.getMinFreeHeap()));
-    MqttSettings.publish("dtu/heap/maxalloc", String(ESP.getMaxAllocHeap()));
+    MqttSettings.publish("dtu/uptime", String(esp_timer_get_time() / 1000000), MqttPriority::Low);
+    MqttSettings.publish("dtu/ip", NetworkSettings.localIP().toString(), MqttPriority::Low);
+    MqttSettings.publish("dtu/hostname", NetworkSettings.getHostname(), MqttPriority::Low);
+    MqttSettings.publish("dtu/heap/size", String(ESP.getHeapSize()), MqttPriority::Low);
+    MqttSettings.publish("dtu/heap/free", String(ESP.getFreeHeap()), MqttPriority::Low);
+    MqttSettings.publish("dtu/heap/minfree", String(ESP.getMinFreeHeap()), MqttPriority::Low);
+    MqttSettings.publish("dtu/heap/maxalloc", String(ESP.getMaxAllocHeap()), MqttPriority::Low);
     if (NetworkSettings.NetworkMode() == network_mode::WiFi) {
-        MqttSettings.publish("dtu/rssi", String(WiFi.RSSI()));
-        MqttSettings.publish("dtu/bssid", WiFi.BSSIDstr());
+        MqttSettings.publish("dtu/rssi", String(WiFi.RSSI()), MqttPriority::Low);
+        MqttSettings.publish("dtu/bssid", WiFi.BSSIDstr(), MqttPriority::Low);
     }
 
     float temperature = CpuTemperature.read();
     if (!std::isnan(temperature)) {
-        MqttSettings.publish("dtu/temperature", String(temperature));
+        MqttSettings.publish("dtu/temperature", String(temperature), MqttPriority::Low);
     }
 }
@@ -9,6 +9,8 @@
 #include "Utils.h"
 #include "__compiled_constants.h"
 #include "defaults.h"
+#include <algorithm>
+#include <esp_rom_crc.h>
 
 #define MAX_CONFIG_PUBLISH_RATIO 60000
 
@@ -24,25 +26,122 @@ MqttHandleHassClass::MqttHandleHassClass()
 
 void MqttHandleHassClass::init(Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+
     scheduler.addTask(_loopTask);
     _loopTask.enable();
+
+    Configuration.onChange(std::bind(&MqttHandleHassClass::onConfigChange, this, _1));
+}
+
+void MqttHandleHassClass::onConfigChange(const ConfigDiff_t& diff)
+{
+    // A reconnect publishes the configuration anyway
+    if (diff.MqttHass || diff.InverterSerial.any() || diff.InverterName.any()) {
+        if (diff.MqttHass) {
+            // Base topic or retain flag may have changed, everything is published again
+            _retainedConfigs.clear();
+        }
+        forceUpdate();
+    }
 }
 
 void MqttHandleHassClass::loop()
 {
     if (MqttSettings.getConnected() && !_wasConnected) {
-        // Connection established
+        // Connection established, the pass starts after the retained configs were received
         _wasConnected = true;
-        _updateForced = true;
+        _retainedConfigs.clear();
+        startSeeding();
     } else if (!MqttSettings.getConnected() && _wasConnected) {
-        // Connection lost
+        // Connection lost, the pass is started again after the next connect
         _wasConnected = false;
+        _discoveryActive = false;
+        stopSeeding(false);
+    }
+
+    if (_seeding && _seedTimeout.occured()) {
+        stopSeeding(true);
+        _updateForced = true;
     }
 
-    if (_updateForced && _publishConfigTimeout.occured()) {
-        publishConfig();
+    if (_updateForced && !_seeding && _publishConfigTimeout.occured()) {
+        startDiscovery();
         _updateForced = false;
     }
+
+    if (_discoveryActive && _discoveryStepTimeout.occured() && MqttSettings.getOutboxStats().Messages == 0) {
+        publishDiscoveryStep();
+        _discoveryStepTimeout.set(HASS_DISCOVERY_STEP_INTERVAL);
+    }
+}
+
+void MqttHandleHassClass::startSeeding()
+{
+    const auto config = Configuration.get();
+
+    // Without retain the broker doesn't keep the configs
+    if (!config->Mqtt.Hass.Enabled || !config->Mqtt.Hass.Retain) {
+        _updateForced = true;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_seedMutex);
+        _seededConfigs.clear();
+        _seeding = true;
+    }
+
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+    using std::placeholders::_3;
+    using std::placeholders::_4;
+
+    _seedTopic = String(config->Mqtt.Hass.Topic) + "#";
+    MqttSettings.subscribe(_seedTopic, 0, std::bind(&MqttHandleHassClass::onRetainedConfig, this, _1, _2, _3, _4));
+    _seedTimeout.set(HASS_RETAINED_SEED_TIME);
+}
+
+void MqttHandleHassClass::stopSeeding(const bool merge)
+{
+    if (!_seeding) {
+        return;
+    }
+    MqttSettings.unsubscribe(_seedTopic);
+
+    std::lock_guard<std::mutex> lock(_seedMutex);
+    _seeding = false;
+    if (merge) {
+        _retainedConfigs.swap(_seededConfigs);
+        std::sort(_retainedConfigs.begin(), _retainedConfigs.end(),
+            [](const RetainedConfig_t& a, const RetainedConfig_t& b) { return a.TopicHash < b.TopicHash; });
+        ESP_LOGI(TAG, "Received %zu retained HA configs", _retainedConfigs.size());
+    }
+    _seededConfigs.clear();
+    _seededConfigs.shrink_to_fit();
+}
+
+void MqttHandleHassClass::onRetainedConfig(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len)
+{
+    if (!properties.retain || len == 0) {
+        return;
+    }
+
+    // Only configs of this DTU and its inverters, other devices may share the discovery topic.
+    // The topics are <discovery topic><component>/<device>/...
+    const String dtuId = getDtuUniqueId();
+    const char* device = strchr(topic + _seedTopic.length() - 1, '/');
+    if (device == nullptr || (strncmp(device + 1, "dtu_", 4) != 0 && strncmp(device + 1, dtuId.c_str(), dtuId.length()) != 0)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_seedMutex);
+    if (!_seeding || _seededConfigs.size() >= HASS_RETAINED_SEED_MAX) {
+        return;
+    }
+
+    _seededConfigs.push_back({ esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(topic), strlen(topic)),
+        esp_rom_crc32_le(0, payload, len) });
 }
 
 void MqttHandleHassClass::forceUpdate()
@@ -50,9 +149,20 @@ void MqttHandleHassClass::forceUpdate()
     _updateForced = true;
 }
 
-void MqttHandleHassClass::publishConfig()
+HassDiscoveryStats_t MqttHandleHassClass::getDiscoveryStats() const
+{
+    HassDiscoveryStats_t stats;
+    stats.Published = _lastPublished;
+    stats.Unchanged = _lastUnchanged;
+    stats.Bytes = _lastBytes;
+    stats.HeapPeak = _lastHeapPeak;
+    stats.Duration = _lastDuration;
+    return stats;
+}
+
+void MqttHandleHassClass::startDiscovery()
 {
-    if (!Configuration.get().Mqtt.Hass.Enabled) {
+    if (!Configuration.get()->Mqtt.Hass.Enabled) {
         return;
     }
 
@@ -63,9 +173,63 @@ void MqttHandleHassClass::publishConfig()
     ESP_LOGI(TAG, "Publish HA config");
     _publishConfigTimeout.set(MAX_CONFIG_PUBLISH_RATIO);
 
-    const CONFIG_T& config = Configuration.get();
+    _discoveryActive = true;
+    _discoveryInverter = -1;
+    _discoveryPart = 0;
+    _discoveryStepTimeout.set(0);
+
+    _pass = {};
+    _passStartMillis = millis();
+    _passStartDropped = MqttSettings.getOutboxStats().Dropped;
+    _passIncomplete = false;
+}
+
+void MqttHandleHassClass::publishDiscoveryStep()
+{
+    _stepStartFreeHeap = ESP.getFreeHeap();
+
+    if (_discoveryInverter < 0) {
+        publishDtuConfig();
+        _discoveryInverter = 0;
+        _discoveryPart = 0;
+        return;
+    }
+
+    auto inv = Hoymiles.getInverterByPos(_discoveryInverter);
+    if (inv == nullptr) {
+        _discoveryActive = false;
+        _pass.Duration = millis() - _passStartMillis;
+
+        _lastPublished = _pass.Published;
+        _lastUnchanged = _pass.Unchanged;
+        _lastBytes = _pass.Bytes;
+        _lastHeapPeak = _pass.HeapPeak;
+        _lastDuration = _pass.Duration;
+
+        ESP_LOGI(TAG, "HA config published: %" PRIu32 " documents (%" PRIu32 " bytes), %" PRIu32 " unchanged, peak heap about %" PRIu32 " bytes, %" PRIu32 " ms",
+            _pass.Published, _pass.Bytes, _pass.Unchanged, _pass.HeapPeak, _pass.Duration);
+
+        // The outbox may also have evicted an accepted config later on, so every config is published again
+        if (_passIncomplete || MqttSettings.getOutboxStats().Dropped != _passStartDropped) {
+            ESP_LOGW(TAG, "HA config incomplete, publishing again");
+            _retainedConfigs.clear();
+            forceUpdate();
+        }
+        return;
+    }
+
+    if (publishInverterConfig(inv, _discoveryPart)) {
+        _discoveryPart++;
+    } else {
+        _discoveryInverter++;
+        _discoveryPart = 0;
+    }
+}
+
+void MqttHandleHassClass::publishDtuConfig()
+{
+    const auto config = Configuration.get();
 
-    // publish DTU sensors
     publishDtuSensor("IP", "dtu/ip", "", "mdi:network-outline", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
     publishDtuSensor("WiFi Signal", "dtu/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
     publishDtuSensor("Uptime", "dtu/uptime", "s", "", DEVICE_CLS_DURATION, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
@@ -80,13 +244,12 @@ void MqttHandleHassClass::publishConfig()
     publishDtuSensor("AC Power", "ac/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE);
     publishDtuSensor("DC Power", "dc/power", "W", "", DEVICE_CLS_PWR, STATE_CLS_MEASUREMENT, CATEGORY_NONE);
 
-    publishDtuBinarySensor("Status", config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online, config.Mqtt.Lwt.Value_Offline, DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
-
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-        yield();
+    publishDtuBinarySensor("Status", config->Mqtt.Lwt.Topic, config->Mqtt.Lwt.Value_Online, config->Mqtt.Lwt.Value_Offline, DEVICE_CLS_CONNECTIVITY, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
+}
 
+bool MqttHandleHassClass::publishInverterConfig(std::shared_ptr<InverterAbstract> inv, const uint8_t part)
+{
+    if (part == 0) {
         publishInverterButton(inv, "Turn Inverter Off", "cmd/power", "0", "mdi:power-plug-off", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG);
         publishInverterButton(inv, "Turn Inverter On", "cmd/power", "1", "mdi:power-plug", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_CONFIG);
         publishInverterButton(inv, "Restart Inverter", "cmd/restart", "1", "", DEVICE_CLS_RESTART, STATE_CLS_NONE, CATEGORY_CONFIG);
@@ -108,21 +271,27 @@ void MqttHandleHassClass::publishConfig()
         publishInverterSensor(inv, "RX Fail Receive Corrupt", "radio/rx_fail_corrupt", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
         publishInverterSensor(inv, "TX Re-Request Fragment", "radio/tx_re_request", "", "", DEVICE_CLS_NONE, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
         publishInverterSensor(inv, "RSSI", "radio/rssi", "dBm", "", DEVICE_CLS_SIGNAL_STRENGTH, STATE_CLS_NONE, CATEGORY_DIAGNOSTIC);
+        return true;
+    }
+
+    // One part per channel
+    uint8_t channelPart = 1;
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            if (channelPart++ != part) {
+                continue;
+            }
 
-        // Loop all channels
-        for (auto& t : inv->Statistics()->getChannelTypes()) {
-            for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
-                    bool clear = false;
-                    if (t == TYPE_DC && !config.Mqtt.Hass.IndividualPanels) {
-                        clear = true;
-                    }
-                    publishInverterField(inv, t, c, deviceFieldAssignment[f], clear);
-                    yield();
-                }
+            const bool clear = t == TYPE_DC && !Configuration.get()->Mqtt.Hass.IndividualPanels;
+            for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
+                publishInverterField(inv, t, c, deviceFieldAssignment[f], clear);
+                yield();
             }
+            return true;
         }
     }
+
+    return false;
 }
 
 void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear)
@@ -153,7 +322,8 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
         + "/config";
 
     if (!clear) {
-        const String stateTopic = MqttSettings.getPrefix() + MqttHandleInverter.getTopic(inv, type, channel, fieldType.fieldId);
+        String valueTemplate;
+        const String stateTopic = MqttSettings.getPrefix() + getInverterStateTopic(inv, MqttHandleInverter.getFieldPath(inv, type, channel, fieldType.fieldId), valueTemplate);
 
         String name;
         if (type != TYPE_DC) {
@@ -170,10 +340,13 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
 
         root["name"] = name;
         root["stat_t"] = stateTopic;
+        if (valueTemplate != "") {
+            root["val_tpl"] = valueTemplate;
+        }
         root["uniq_id"] = serial + "_ch" + chanNum + "_" + fieldName;
 
-        if (Configuration.get().Mqtt.Hass.Expire) {
-            root["exp_aft"] = Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval(), Configuration.get().Mqtt.PublishInterval) * inv->getReachableThreshold();
+        if (Configuration.get()->Mqtt.Hass.Expire) {
+            root["exp_aft"] = Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval(), Configuration.get()->Mqtt.PublishInterval) * inv->getReachableThreshold();
         }
 
         publish(configTopic, root);
@@ -206,7 +379,7 @@ void MqttHandleHassClass::publishInverterButton(
     root["name"] = name;
     root["uniq_id"] = serial + "_" + buttonId;
     root["cmd_t"] = cmdTopic;
-    root["payload_press"] = payload;
+    root["pl_prs"] = payload;
 
     publish(configTopic, root);
 }
@@ -229,7 +402,8 @@ void MqttHandleHassClass::publishInverterNumber(
         + "/config";
 
     const String cmdTopic = MqttSettings.getPrefix() + serial + "/" + command_topic;
-    const String statTopic = MqttSettings.getPrefix() + serial + "/" + stateTopic;
+    String valueTemplate;
+    const String statTopic = MqttSettings.getPrefix() + getInverterStateTopic(inv, stateTopic, valueTemplate);
 
     JsonDocument root;
     createInverterInfo(root, inv);
@@ -239,6 +413,9 @@ void MqttHandleHassClass::publishInverterNumber(
     root["uniq_id"] = serial + "_" + buttonId;
     root["cmd_t"] = cmdTopic;
     root["stat_t"] = statTopic;
+    if (valueTemplate != "") {
+        root["val_tpl"] = valueTemplate;
+    }
     root["min"] = min;
     root["max"] = max;
     root["step"] = step;
@@ -246,6 +423,26 @@ void MqttHandleHassClass::publishInverterNumber(
     publish(configTopic, root);
 }
 
+String MqttHandleHassClass::getInverterStateTopic(std::shared_ptr<InverterAbstract> inv, const String& path, String& value_template)
+{
+    if (!Configuration.get()->Mqtt.Aggregated) {
+        value_template = "";
+        return inv->serialString() + "/" + path;
+    }
+
+    // Every level of the topic is an object of the document
+    value_template = "{{ value_json";
+    int start = 0;
+    int slash;
+    while ((slash = path.indexOf('/', start)) >= 0) {
+        value_template += "['" + path.substring(start, slash) + "']";
+        start = slash + 1;
+    }
+    value_template += "['" + path.substring(start) + "'] }}";
+
+    return MqttHandleInverter.getJsonTopic(inv);
+}
+
 void MqttHandleHassClass::createInverterInfo(JsonDocument& root, std::shared_ptr<InverterAbstract> inv)
 {
     createDeviceInfo(
@@ -287,7 +484,7 @@ void MqttHandleHassClass::createDeviceInfo(
     object["sw"] = sw_version;
 
     if (via_device != "") {
-        object["via_device"] = via_device;
+        object["via_dev"] = via_device;
     }
 }
 
@@ -303,9 +500,44 @@ String MqttHandleHassClass::getDtuUrl()
 
 void MqttHandleHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
+    const auto config = Configuration.get();
+
+    String topic = config->Mqtt.Hass.Topic;
     topic += subtopic;
-    MqttSettings.publishGeneric(topic, payload, Configuration.get().Mqtt.Hass.Retain);
+
+    // The document and the payload are still allocated at this point. Approximate, other tasks allocate as well.
+    const uint32_t usedHeap = _stepStartFreeHeap - min<uint32_t>(ESP.getFreeHeap(), _stepStartFreeHeap);
+    _pass.HeapPeak = max<uint32_t>(_pass.HeapPeak, usedHeap);
+
+    // Only retained configs are known to be still present on the broker
+    const uint32_t topicHash = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(topic.c_str()), topic.length());
+    const uint32_t payloadHash = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length());
+
+    auto it = std::lower_bound(_retainedConfigs.begin(), _retainedConfigs.end(), topicHash,
+        [](const RetainedConfig_t& retained, const uint32_t hash) { return retained.TopicHash < hash; });
+    const bool known = it != _retainedConfigs.end() && it->TopicHash == topicHash;
+
+    if (config->Mqtt.Hass.Retain && known && it->PayloadHash == payloadHash) {
+        _pass.Unchanged++;
+        return;
+    }
+
+    // A config the outbox did not accept is published again by the next pass
+    if (!MqttSettings.publishGeneric(topic, payload, config->Mqtt.Hass.Retain, 0, MqttPriority::Low)) {
+        _passIncomplete = true;
+        return;
+    }
+
+    if (config->Mqtt.Hass.Retain) {
+        if (known) {
+            it->PayloadHash = payloadHash;
+        } else {
+            _retainedConfigs.insert(it, { topicHash, payloadHash });
+        }
+    }
+
+    _pass.Published++;
+    _pass.Bytes += topic.length() + payload.length();
     yield();
 }
 
@@ -344,7 +576,7 @@ void MqttHandleHassClass::addCommonMetadata(
 void MqttHandleHassClass::publishBinarySensor(
     JsonDocument& doc,
     const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic, const String& payload_on, const String& payload_off,
-    const DeviceClassType device_class, const StateClassType state_class, const CategoryType category)
+    const DeviceClassType device_class, const StateClassType state_class, const CategoryType category, const String& value_template)
 {
     String sensor_id = name;
     sensor_id.toLowerCase();
@@ -353,6 +585,9 @@ void MqttHandleHassClass::publishBinarySensor(
     doc["name"] = name;
     doc["uniq_id"] = unique_id_prefix + "_" + sensor_id;
     doc["stat_t"] = MqttSettings.getPrefix() + state_topic;
+    if (value_template != "") {
+        doc["val_tpl"] = value_template;
+    }
     doc["pl_on"] = payload_on;
     doc["pl_off"] = payload_off;
 
@@ -379,16 +614,19 @@ void MqttHandleHassClass::publishInverterBinarySensor(
 {
     const String serial = inv->serialString();
 
+    String valueTemplate;
+    const String stateTopic = getInverterStateTopic(inv, state_topic, valueTemplate);
+
     JsonDocument root;
     createInverterInfo(root, inv);
-    publishBinarySensor(root, "dtu_" + serial, serial, name, serial + "/" + state_topic, payload_on, payload_off, device_class, state_class, category);
+    publishBinarySensor(root, "dtu_" + serial, serial, name, stateTopic, payload_on, payload_off, device_class, state_class, category, valueTemplate);
 }
 
 void MqttHandleHassClass::publishSensor(
     JsonDocument& doc,
     const String& root_device, const String& unique_id_prefix, const String& name, const String& state_topic,
     const String& unit_of_measure, const String& icon,
-    const DeviceClassType device_class, const StateClassType state_class, const CategoryType category)
+    const DeviceClassType device_class, const StateClassType state_class, const CategoryType category, const String& value_template)
 {
     String sensor_id = name;
     sensor_id.toLowerCase();
@@ -397,13 +635,16 @@ void MqttHandleHassClass::publishSensor(
     doc["name"] = name;
     doc["uniq_id"] = unique_id_prefix + "_" + sensor_id;
     doc["stat_t"] = MqttSettings.getPrefix() + state_topic;
+    if (value_template != "") {
+        doc["val_tpl"] = value_template;
+    }
 
     addCommonMetadata(doc, unit_of_measure, icon, device_class, state_class, category);
 
-    const CONFIG_T& config = Configuration.get();
-    doc["avty_t"] = MqttSettings.getPrefix() + config.Mqtt.Lwt.Topic;
-    doc["pl_avail"] = config.Mqtt.Lwt.Value_Online;
-    doc["pl_not_avail"] = config.Mqtt.Lwt.Value_Offline;
+    const auto config = Configuration.get();
+    doc["avty_t"] = MqttSettings.getPrefix() + config->Mqtt.Lwt.Topic;
+    doc["pl_avail"] = config->Mqtt.Lwt.Value_Online;
+    doc["pl_not_avail"] = config->Mqtt.Lwt.Value_Offline;
 
     const String configTopic = "sensor/" + root_device + "/" + sensor_id + "/config";
     publish(configTopic, doc);
@@ -428,7 +669,10 @@ void MqttHandleHassClass::publishInverterSensor(
 {
     const String serial = inv->serialString();
 
+    String valueTemplate;
+    const String stateTopic = getInverterStateTopic(inv, state_topic, valueTemplate);
+
     JsonDocument root;
     createInverterInfo(root, inv);
-    publishSensor(root, "dtu_" + serial, serial, name, serial + "/" + state_topic, unit_of_measure, icon, device_class, state_class, category);
+    publishSensor(root, "dtu_" + serial, serial, name, stateTopic, unit_of_measure, icon, device_class, state_class, category, valueTemplate);
 }
@@ -4,7 +4,11 @@
  */
 #include "MqttHandleInverter.h"
 #include "MqttSettings.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
 #include <ctime>
+#include <esp_rom_crc.h>
 
 #undef TAG
 static const char* TAG = "mqtt";
@@ -13,6 +17,27 @@ static const char* TAG = "mqtt";
 
 MqttHandleInverterClass MqttHandleInverter;
 
+// Computes the CRC of everything printed to it
+class CrcPrint : public Print {
+public:
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        _crc = esp_rom_crc32_le(_crc, buffer, size);
+        return size;
+    }
+    uint32_t getCrc() const
+    {
+        return _crc;
+    }
+
+private:
+    uint32_t _crc = 0;
+};
+
 MqttHandleInverterClass::MqttHandleInverterClass()
     : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterClass::loop, this))
 {
@@ -20,112 +45,351 @@ MqttHandleInverterClass::MqttHandleInverterClass()
 
 void MqttHandleInverterClass::init(Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+
     subscribeTopics();
+    Configuration.onChange(std::bind(&MqttHandleInverterClass::onConfigChange, this, _1));
 
     scheduler.addTask(_loopTask);
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.get()->Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
 }
 
+void MqttHandleInverterClass::onConfigChange(const ConfigDiff_t& diff)
+{
+    if (diff.MqttConnection || diff.MqttPublish) {
+        _publishedSettingsChanged = true;
+    }
+}
+
 void MqttHandleInverterClass::loop()
 {
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    // Fetched once, publish() runs for every value
+    const auto config = Configuration.get();
+    _loopTask.setInterval(config->Mqtt.PublishInterval * TASK_SECOND);
+    _publishOnChange = config->Mqtt.PublishOnChange;
+    _publishMaxAge = config->Mqtt.PublishMaxAge * 1000;
 
     if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
         _loopTask.forceNextIteration();
         return;
     }
 
+    // The broker may have lost values which are not retained, and the outbox may have dropped
+    // values after accepting them. Changed MQTT settings may change the topics. All of them publish everything again.
+    const uint32_t connectCount = MqttSettings.getConnectCount();
+    const uint32_t dropped = MqttSettings.getOutboxStats().Dropped;
+    if (connectCount != _publishedConnectCount || dropped != _publishedDropped || _publishedSettingsChanged) {
+        _publishedValues.clear();
+        _publishedValues.shrink_to_fit();
+        _publishedConnectCount = connectCount;
+        _publishedDropped = dropped;
+        _publishedSettingsChanged = false;
+    }
+
+    // Adding or removing an inverter and a new prefix change the configuration
+    const uint32_t revision = Configuration.getRevision();
+    if (revision != _topicsRevision) {
+        _inverterTopics.clear();
+        _topicsRevision = revision;
+    }
+
+    const bool aggregated = config->Mqtt.Aggregated;
+    const uint32_t start = micros();
+    char buffer[32];
+
     // Loop all inverters
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
+        const InverterTopics_t& topics = getInverterTopics(i, inv);
 
-        const String subtopic = inv->serialString();
+        JsonDocument aggregate;
+        JsonDocument* doc = nullptr;
+        if (aggregated) {
+            aggregate.to<JsonObject>();
+            doc = &aggregate;
+        }
 
         // Name
-        MqttSettings.publish(subtopic + "/name", inv->name());
+        publishStatic(doc, topics, StaticTopic::Name, inv->name(), true);
 
         // Radio Statistics
-        MqttSettings.publish(subtopic + "/radio/tx_request", String(inv->RadioStats.TxRequestData));
-        MqttSettings.publish(subtopic + "/radio/tx_re_request", String(inv->RadioStats.TxReRequestFragment));
-        MqttSettings.publish(subtopic + "/radio/rx_success", String(inv->RadioStats.RxSuccess));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_nothing", String(inv->RadioStats.RxFailNoAnswer));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_partial", String(inv->RadioStats.RxFailPartialAnswer));
-        MqttSettings.publish(subtopic + "/radio/rx_fail_corrupt", String(inv->RadioStats.RxFailCorruptData));
-        MqttSettings.publish(subtopic + "/radio/rssi", String(inv->getLastRssi()));
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.TxRequestData);
+        publishStatic(doc, topics, StaticTopic::TxRequest, buffer);
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.TxReRequestFragment);
+        publishStatic(doc, topics, StaticTopic::TxReRequest, buffer);
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.RxSuccess);
+        publishStatic(doc, topics, StaticTopic::RxSuccess, buffer);
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.RxFailNoAnswer);
+        publishStatic(doc, topics, StaticTopic::RxFailNothing, buffer);
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.RxFailPartialAnswer);
+        publishStatic(doc, topics, StaticTopic::RxFailPartial, buffer);
+        snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->RadioStats.RxFailCorruptData);
+        publishStatic(doc, topics, StaticTopic::RxFailCorrupt, buffer);
+        snprintf(buffer, sizeof(buffer), "%d", inv->getLastRssi());
+        publishStatic(doc, topics, StaticTopic::Rssi, buffer);
 
         if (inv->DevInfo()->getLastUpdate() > 0) {
             // Bootloader Version
-            MqttSettings.publish(subtopic + "/device/bootloaderversion", String(inv->DevInfo()->getFwBootloaderVersion()));
+            snprintf(buffer, sizeof(buffer), "%u", inv->DevInfo()->getFwBootloaderVersion());
+            publishStatic(doc, topics, StaticTopic::BootloaderVersion, buffer);
 
             // Firmware Version
-            MqttSettings.publish(subtopic + "/device/fwbuildversion", String(inv->DevInfo()->getFwBuildVersion()));
+            snprintf(buffer, sizeof(buffer), "%u", inv->DevInfo()->getFwBuildVersion());
+            publishStatic(doc, topics, StaticTopic::FwBuildVersion, buffer);
 
             // Firmware Build DateTime
-            MqttSettings.publish(subtopic + "/device/fwbuilddatetime", inv->DevInfo()->getFwBuildDateTimeStr());
+            const time_t buildTime = inv->DevInfo()->getFwBuildDateTime();
+            struct tm buildTm;
+            gmtime_r(&buildTime, &buildTm);
+            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &buildTm);
+            publishStatic(doc, topics, StaticTopic::FwBuildDateTime, buffer, true);
 
             // Hardware part number
-            MqttSettings.publish(subtopic + "/device/hwpartnumber", String(inv->DevInfo()->getHwPartNumber()));
+            snprintf(buffer, sizeof(buffer), "%" PRIu32, inv->DevInfo()->getHwPartNumber());
+            publishStatic(doc, topics, StaticTopic::HwPartNumber, buffer);
 
-            // Hardware version
-            MqttSettings.publish(subtopic + "/device/hwversion", inv->DevInfo()->getHwVersion());
+            // Hardware version, short enough to not allocate
+            publishStatic(doc, topics, StaticTopic::HwVersion, inv->DevInfo()->getHwVersion().c_str(), true);
         }
 
         if (inv->SystemConfigPara()->getLastUpdate() > 0) {
             // Limit
-            MqttSettings.publish(subtopic + "/status/limit_relative", String(inv->SystemConfigPara()->getLimitPercent()));
+            snprintf(buffer, sizeof(buffer), "%.2f", inv->SystemConfigPara()->getLimitPercent());
+            publishStatic(doc, topics, StaticTopic::LimitRelative, buffer);
 
             uint16_t maxpower = inv->DevInfo()->getMaxPower();
             if (maxpower > 0) {
-                MqttSettings.publish(subtopic + "/status/limit_absolute", String(inv->SystemConfigPara()->getLimitPercent() * maxpower / 100));
+                snprintf(buffer, sizeof(buffer), "%.2f", inv->SystemConfigPara()->getLimitPercent() * maxpower / 100);
+                publishStatic(doc, topics, StaticTopic::LimitAbsolute, buffer);
             }
         }
 
-        MqttSettings.publish(subtopic + "/status/reachable", String(inv->isReachable()));
-        MqttSettings.publish(subtopic + "/status/producing", String(inv->isProducing()));
+        publishStatic(doc, topics, StaticTopic::Reachable, inv->isReachable() ? "1" : "0");
+        publishStatic(doc, topics, StaticTopic::Producing, inv->isProducing() ? "1" : "0");
 
         if (inv->Statistics()->getLastUpdate() > 0) {
-            MqttSettings.publish(subtopic + "/status/last_update", String(std::time(0) - (millis() - inv->Statistics()->getLastUpdate()) / 1000));
+            snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(std::time(0) - (millis() - inv->Statistics()->getLastUpdate()) / 1000));
+            publishStatic(doc, topics, StaticTopic::LastUpdate, buffer);
         } else {
-            MqttSettings.publish(subtopic + "/status/last_update", String(0));
+            publishStatic(doc, topics, StaticTopic::LastUpdate, "0");
         }
 
+        // The document always contains all channels, single topics are only published after an update
         const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (inv->Statistics()->getLastUpdate() > 0 && (lastUpdateInternal != _lastPublishStats[i])) {
+        if (inv->Statistics()->getLastUpdate() > 0 && (aggregated || lastUpdateInternal != _lastPublishStats[i])) {
             _lastPublishStats[i] = lastUpdateInternal;
 
-            // Loop all channels
-            for (auto& t : inv->Statistics()->getChannelTypes()) {
-                for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                    if (t == TYPE_DC) {
-                        INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
-                        if (inv_cfg != nullptr) {
-                            // TODO(tbnobody)
-                            MqttSettings.publish(inv->serialString() + "/" + String(static_cast<uint8_t>(c) + 1) + "/name", inv_cfg->channel[c].Name);
-                        }
-                    }
-                    for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(FieldId_t); f++) {
-                        publishField(inv, t, c, _publishFields[f]);
-                    }
+            const auto inv_cfg = Configuration.getInverterConfig(*inv);
+            if (inv_cfg != nullptr) {
+                for (auto& c : topics.ChannelNames) {
+                    publishValue(doc, c.Topic, c.ChannelKey, c.Topic.c_str() + c.NameOffset, inv_cfg->channel[c.Channel].Name, true);
                 }
             }
+
+            for (auto& f : topics.Fields) {
+                snprintf(buffer, sizeof(buffer), "%.*f",
+                    inv->Statistics()->getChannelFieldDigits(f.Type, f.Channel, f.Field),
+                    inv->Statistics()->getChannelFieldValue(f.Type, f.Channel, f.Field));
+                publishValue(doc, f.Topic, f.ChannelKey, f.Topic.c_str() + f.NameOffset, buffer, false);
+            }
+        }
+
+        if (doc != nullptr && Utils::checkJsonAlloc(*doc, __FUNCTION__, __LINE__)) {
+            String payload;
+            serializeJson(*doc, payload);
+
+            // The timestamp and the radio statistics change with every poll. They are still
+            // published, but only a change of the other values causes the document to be sent.
+            doc->remove("radio");
+            (*doc)["status"].remove("last_update");
+            CrcPrint changeHash;
+            serializeJson(*doc, changeHash);
+
+            publish(topics.Json.c_str(), payload.c_str(), changeHash.getCrc());
         }
 
         yield();
     }
+
+    _lastLoopDuration = micros() - start;
+}
+
+// Section and key of the values of StaticTopic, a section is a level between the serial and the key
+static const struct {
+    const char* Section;
+    const char* Key;
+} staticTopics[] = {
+    { nullptr, "name" },
+    { "radio", "tx_request" },
+    { "radio", "tx_re_request" },
+    { "radio", "rx_success" },
+    { "radio", "rx_fail_nothing" },
+    { "radio", "rx_fail_partial" },
+    { "radio", "rx_fail_corrupt" },
+    { "radio", "rssi" },
+    { "device", "bootloaderversion" },
+    { "device", "fwbuildversion" },
+    { "device", "fwbuilddatetime" },
+    { "device", "hwpartnumber" },
+    { "device", "hwversion" },
+    { "status", "limit_relative" },
+    { "status", "limit_absolute" },
+    { "status", "reachable" },
+    { "status", "producing" },
+    { "status", "last_update" },
+};
+
+const MqttHandleInverterClass::InverterTopics_t& MqttHandleInverterClass::getInverterTopics(const uint8_t pos, std::shared_ptr<InverterAbstract> inv)
+{
+    if (_inverterTopics.size() <= pos) {
+        _inverterTopics.resize(pos + 1);
+    }
+
+    InverterTopics_t& topics = _inverterTopics[pos];
+    if (topics.Serial != inv->serial()) {
+        buildInverterTopics(topics, inv);
+    }
+    return topics;
+}
+
+void MqttHandleInverterClass::buildInverterTopics(InverterTopics_t& topics, std::shared_ptr<InverterAbstract> inv)
+{
+    static_assert(sizeof(staticTopics) / sizeof(staticTopics[0]) == static_cast<uint8_t>(StaticTopic::Count),
+        "staticTopics must contain an entry for every StaticTopic");
+
+    const String base = MqttSettings.getPrefix() + inv->serialString() + "/";
+
+    topics.Serial = inv->serial();
+    for (uint8_t i = 0; i < static_cast<uint8_t>(StaticTopic::Count); i++) {
+        topics.Static[i] = base;
+        if (staticTopics[i].Section != nullptr) {
+            topics.Static[i] += staticTopics[i].Section;
+            topics.Static[i] += "/";
+        }
+        topics.Static[i] += staticTopics[i].Key;
+    }
+    topics.Json = MqttSettings.getPrefix() + getJsonTopic(inv);
+
+    auto makeTopic = [&base](FieldTopic_t& topic, const String& path) {
+        const int slash = path.indexOf('/');
+        strlcpy(topic.ChannelKey, path.substring(0, slash).c_str(), sizeof(topic.ChannelKey));
+        topic.Topic = base + path;
+        topic.NameOffset = base.length() + slash + 1;
+    };
+
+    topics.ChannelNames.clear();
+    topics.Fields.clear();
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            if (t == TYPE_DC) {
+                FieldTopic_t topic = { t, c, FLD_UDC, "", 0, "" };
+                // TODO(tbnobody)
+                makeTopic(topic, String(static_cast<uint8_t>(c) + 1) + "/name");
+                topics.ChannelNames.push_back(std::move(topic));
+            }
+            for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(FieldId_t); f++) {
+                const String path = getFieldPath(inv, t, c, _publishFields[f]);
+                if (path == "") {
+                    continue;
+                }
+                FieldTopic_t topic = { t, c, _publishFields[f], "", 0, "" };
+                makeTopic(topic, path);
+                topics.Fields.push_back(std::move(topic));
+            }
+        }
+    }
+    topics.ChannelNames.shrink_to_fit();
+    topics.Fields.shrink_to_fit();
+}
+
+void MqttHandleInverterClass::publishStatic(JsonDocument* doc, const InverterTopics_t& topics, const StaticTopic topic, const char* value, const bool isText)
+{
+    const uint8_t index = static_cast<uint8_t>(topic);
+    publishValue(doc, topics.Static[index], staticTopics[index].Section, staticTopics[index].Key, value, isText);
+}
+
+void MqttHandleInverterClass::publishValue(JsonDocument* doc, const String& topic, const char* section, const char* key, const char* value, const bool isText)
+{
+    if (doc == nullptr) {
+        publish(topic.c_str(), value);
+        return;
+    }
+
+    // Every level of the topic is an object of the document
+    JsonObject object = doc->as<JsonObject>();
+    if (section != nullptr) {
+        JsonObject child = object[section].as<JsonObject>();
+        if (child.isNull()) {
+            child = object[section].to<JsonObject>();
+        }
+        object = child;
+    }
+
+    if (isText) {
+        object[key] = value;
+    } else if (value[0] == '\0' || !std::isfinite(strtof(value, nullptr))) {
+        object[key] = nullptr; // nan is not valid JSON
+    } else {
+        // The values are already formatted with the number of digits of the field
+        object[key] = serialized(value);
+    }
 }
 
-void MqttHandleInverterClass::publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+void MqttHandleInverterClass::publish(const char* topic, const char* payload)
 {
-    const String topic = getTopic(inv, type, channel, fieldId);
-    if (topic == "") {
+    publish(topic, payload, esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(payload), strlen(payload)));
+}
+
+void MqttHandleInverterClass::publish(const char* topic, const char* payload, const uint32_t payloadHash)
+{
+    if (!_publishOnChange) {
+        MqttSettings.publishTopic(topic, payload);
+        return;
+    }
+
+    const uint32_t topicHash = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(topic), strlen(topic));
+    const uint32_t now = millis();
+
+    auto it = std::lower_bound(_publishedValues.begin(), _publishedValues.end(), topicHash,
+        [](const PublishedValue_t& value, const uint32_t hash) { return value.TopicHash < hash; });
+
+    const bool known = it != _publishedValues.end() && it->TopicHash == topicHash;
+
+    if (known && it->PayloadHash == payloadHash && now - it->Millis < _publishMaxAge) {
+        _suppressedCount++;
+        return;
+    }
+
+    // A value the outbox did not accept is published again with the next loop
+    if (!MqttSettings.publishTopic(topic, payload)) {
         return;
     }
 
-    MqttSettings.publish(topic, inv->Statistics()->getChannelFieldValueString(type, channel, fieldId));
+    if (known) {
+        it->PayloadHash = payloadHash;
+        it->Millis = now;
+    } else {
+        _publishedValues.insert(it, { topicHash, payloadHash, now });
+    }
+}
+
+uint32_t MqttHandleInverterClass::getSuppressedCount() const
+{
+    return _suppressedCount;
 }
 
 String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+{
+    const String path = getFieldPath(inv, type, channel, fieldId);
+    if (path == "") {
+        return "";
+    }
+
+    return inv->serialString() + "/" + path;
+}
+
+String MqttHandleInverterClass::getFieldPath(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
 {
     if (!inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
         return "";
@@ -147,27 +411,30 @@ String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv,
         chanNum = channel;
     }
 
-    return inv->serialString() + "/" + chanNum + "/" + chanName;
+    return chanNum + "/" + chanName;
 }
 
-void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len)
+String MqttHandleInverterClass::getJsonTopic(std::shared_ptr<InverterAbstract> inv)
 {
-    const CONFIG_T& config = Configuration.get();
-
-    char token_topic[MQTT_MAX_TOPIC_STRLEN + 40]; // respect all subtopics
-    strncpy(token_topic, topic, MQTT_MAX_TOPIC_STRLEN + 40); // convert const char* to char*
+    return inv->serialString() + "/json";
+}
 
-    char* serial_str;
-    char* rest = &token_topic[strlen(config.Mqtt.Topic)];
+uint32_t MqttHandleInverterClass::getLastLoopDuration() const
+{
+    return _lastLoopDuration;
+}
 
-    serial_str = strtok_r(rest, "/", &rest);
+void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len)
+{
+    // The topic is "<prefix><serial>/cmd/<command>", the command is already resolved by the subscription
+    const char* serial_str = topic + strlen(Configuration.get()->Mqtt.Topic);
+    char* serial_end;
+    const uint64_t serial = strtoull(serial_str, &serial_end, 16);
 
-    if (serial_str == NULL) {
+    if (serial_end == serial_str || *serial_end != '/') {
         return;
     }
 
-    const uint64_t serial = strtoull(serial_str, 0, 16);
-
     auto inv = Hoymiles.getInverterBySerial(serial);
 
     if (inv == nullptr) {
@@ -175,13 +442,19 @@ void MqttHandleInverterClass::onMqttMessage(Topic t, const espMqttClientTypes::M
         return;
     }
 
-    std::string strValue(reinterpret_cast<const char*>(payload), len);
-    float payload_val = -1;
-    try {
-        payload_val = std::stof(strValue);
-    } catch (std::invalid_argument const& e) {
+    char strValue[32];
+    if (len >= sizeof(strValue)) {
+        ESP_LOGW(TAG, "MQTT handler: payload of topic '%s' too long", topic);
+        return;
+    }
+    memcpy(strValue, payload, len);
+    strValue[len] = '\0';
+
+    char* value_end;
+    const float payload_val = strtof(strValue, &value_end);
+    if (value_end == strValue) {
         ESP_LOGW(TAG, "MQTT handler: cannot parse payload of topic '%s' as float: %s",
-            topic, strValue.c_str());
+            topic, strValue);
         return;
     }
 
@@ -4,6 +4,8 @@
  */
 #include "MqttSettings.h"
 #include "Configuration.h"
+#include <algorithm>
+#include <esp_rom_crc.h>
 #include <frozen/map.h>
 #include <frozen/string.h>
 
@@ -11,6 +13,7 @@
 static const char* TAG = "mqtt";
 
 MqttSettingsClass::MqttSettingsClass()
+    : _outboxTask(MQTT_OUTBOX_DRAIN_INTERVAL, TASK_FOREVER, std::bind(&MqttSettingsClass::loopOutbox, this))
 {
 }
 
@@ -30,11 +33,20 @@ void MqttSettingsClass::NetworkEvent(network_event event)
     }
 }
 
+void MqttSettingsClass::onConfigChange(const ConfigDiff_t& diff)
+{
+    // Names, intervals and HASS settings are used without a new session
+    if (diff.MqttConnection) {
+        performReconnect();
+    }
+}
+
 void MqttSettingsClass::onMqttConnect(const bool sessionPresent)
 {
     ESP_LOGI(TAG, "Connected to MQTT.");
-    const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online);
+    _connectCount++;
+    const auto config = Configuration.get();
+    publish(config->Mqtt.Lwt.Topic, config->Mqtt.Lwt.Value_Online, MqttPriority::High);
 
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient != nullptr) {
@@ -117,7 +129,7 @@ void MqttSettingsClass::onMqttMessage(const espMqttClientTypes::MessagePropertie
 
 void MqttSettingsClass::performConnect()
 {
-    if (NetworkSettings.isConnected() && Configuration.get().Mqtt.Enabled) {
+    if (NetworkSettings.isConnected() && Configuration.get()->Mqtt.Enabled) {
         using std::placeholders::_1;
         using std::placeholders::_2;
         using std::placeholders::_3;
@@ -131,9 +143,12 @@ void MqttSettingsClass::performConnect()
         }
 
         ESP_LOGI(TAG, "Connecting to MQTT...");
-        const CONFIG_T& config = Configuration.get();
-        const String willTopic = getPrefix() + config.Mqtt.Lwt.Topic;
-        String clientId = getClientId();
+
+        // The client keeps pointers to the strings, so the snapshot is kept until the next connect
+        _clientConfig = Configuration.get();
+        const CONFIG_T& config = *_clientConfig;
+        _willTopic = String(config.Mqtt.Topic) + config.Mqtt.Lwt.Topic;
+        _clientId = getClientId();
         if (config.Mqtt.Tls.Enabled) {
             static_cast<espMqttClientSecure*>(_mqttClient)->setCACert(config.Mqtt.Tls.RootCaCert);
             static_cast<espMqttClientSecure*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
@@ -143,8 +158,8 @@ void MqttSettingsClass::performConnect()
             } else {
                 static_cast<espMqttClientSecure*>(_mqttClient)->setCredentials(config.Mqtt.Username, config.Mqtt.Password);
             }
-            static_cast<espMqttClientSecure*>(_mqttClient)->setWill(willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
-            static_cast<espMqttClientSecure*>(_mqttClient)->setClientId(clientId.c_str());
+            static_cast<espMqttClientSecure*>(_mqttClient)->setWill(_willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
+            static_cast<espMqttClientSecure*>(_mqttClient)->setClientId(_clientId.c_str());
             static_cast<espMqttClientSecure*>(_mqttClient)->setCleanSession(config.Mqtt.CleanSession);
             static_cast<espMqttClientSecure*>(_mqttClient)->onConnect(std::bind(&MqttSettingsClass::onMqttConnect, this, _1));
             static_cast<espMqttClientSecure*>(_mqttClient)->onDisconnect(std::bind(&MqttSettingsClass::onMqttDisconnect, this, _1));
@@ -152,8 +167,8 @@ void MqttSettingsClass::performConnect()
         } else {
             static_cast<espMqttClient*>(_mqttClient)->setServer(config.Mqtt.Hostname, config.Mqtt.Port);
             static_cast<espMqttClient*>(_mqttClient)->setCredentials(config.Mqtt.Username, config.Mqtt.Password);
-            static_cast<espMqttClient*>(_mqttClient)->setWill(willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
-            static_cast<espMqttClient*>(_mqttClient)->setClientId(clientId.c_str());
+            static_cast<espMqttClient*>(_mqttClient)->setWill(_willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
+            static_cast<espMqttClient*>(_mqttClient)->setClientId(_clientId.c_str());
             static_cast<espMqttClient*>(_mqttClient)->setCleanSession(config.Mqtt.CleanSession);
             static_cast<espMqttClient*>(_mqttClient)->onConnect(std::bind(&MqttSettingsClass::onMqttConnect, this, _1));
             static_cast<espMqttClient*>(_mqttClient)->onDisconnect(std::bind(&MqttSettingsClass::onMqttDisconnect, this, _1));
@@ -165,13 +180,27 @@ void MqttSettingsClass::performConnect()
 
 void MqttSettingsClass::performDisconnect()
 {
-    const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Offline);
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient == nullptr) {
         return;
     }
+
+    // Bypass the outbox which is cleared below. The topic of the current session is used
+    // as the configuration may already contain a new base topic.
+    if (_mqttClient->connected() && _clientConfig != nullptr) {
+        const CONFIG_T& config = *_clientConfig;
+        if (_mqttClient->publish(_willTopic.c_str(), config.Mqtt.Lwt.Qos, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline) != 0) {
+            countPublish();
+        }
+    }
     _mqttClient->disconnect();
+
+    // Queued messages may use the previous base topic
+    _outbox.clear();
+    rebuildIndex();
+    _outboxArenaEnd = 0;
+    _outboxCount = 0;
+    _outboxBytes = 0;
 }
 
 void MqttSettingsClass::performReconnect()
@@ -195,19 +224,19 @@ bool MqttSettingsClass::getConnected()
 
 String MqttSettingsClass::getPrefix() const
 {
-    return Configuration.get().Mqtt.Topic;
+    return Configuration.get()->Mqtt.Topic;
 }
 
 String MqttSettingsClass::getClientId() const
 {
-    String clientId = Configuration.get().Mqtt.ClientId;
+    String clientId = Configuration.get()->Mqtt.ClientId;
     if (clientId == "") {
         clientId = NetworkSettings.getApName();
     }
     return clientId;
 }
 
-void MqttSettingsClass::publish(const String& subtopic, const String& payload)
+bool MqttSettingsClass::publish(const String& subtopic, const String& payload, const MqttPriority priority)
 {
     String topic = getPrefix();
     topic += subtopic;
@@ -215,24 +244,308 @@ void MqttSettingsClass::publish(const String& subtopic, const String& payload)
     String value = payload;
     value.trim();
 
-    publishGeneric(topic, value, Configuration.get().Mqtt.Retain, 0);
+    return publishGeneric(topic, value, _retain, 0, priority);
+}
+
+bool MqttSettingsClass::publishTopic(const char* topic, const char* payload, const MqttPriority priority)
+{
+    return publishGeneric(topic, payload, _retain, 0, priority);
+}
+
+bool MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos, const MqttPriority priority)
+{
+    return publishGeneric(topic.c_str(), payload.c_str(), retain, qos, priority);
 }
 
-void MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos)
+bool MqttSettingsClass::publishGeneric(const char* topic, const char* payload, const bool retain, const uint8_t qos, const MqttPriority priority)
 {
+    const size_t topicLength = strlen(topic);
+    const size_t payloadLength = strlen(payload);
+    const size_t size = topicLength + payloadLength + 2;
+    const uint32_t topicHash = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(topic), topicLength);
+
     std::lock_guard<std::mutex> lock(_clientLock);
-    if (_mqttClient == nullptr) {
+    if (_mqttClient == nullptr || _outboxArena.empty()) {
+        return false;
+    }
+
+    // Latest value wins, the message keeps its position in the outbox if the new payload fits into its region
+    OutboxEntry_t* queued = findEntry(topic, topicLength, topicHash, priority);
+    if (queued != nullptr) {
+        _outboxCoalesced++;
+
+        if (size <= queued->Capacity) {
+            memcpy(&_outboxArena[queued->Offset + topicLength + 1], payload, payloadLength + 1);
+            queued->PayloadLength = payloadLength;
+            queued->Retain = retain;
+            queued->Qos = qos;
+            drainOutbox();
+            return true;
+        }
+
+        removeEntry(*queued);
+    }
+
+    if (!makeRoom(size, priority)) {
+        _outboxDropped++;
+        ESP_LOGD(TAG, "Outbox full, dropped message for topic '%s'", topic);
+        return false;
+    }
+
+    if (_outboxArenaEnd + size > _outboxArena.size() || _outbox.size() == _outbox.capacity()) {
+        compactArena();
+    }
+
+    OutboxEntry_t entry;
+    entry.TopicHash = topicHash;
+    entry.Offset = _outboxArenaEnd;
+    entry.Capacity = size;
+    entry.TopicLength = topicLength;
+    entry.PayloadLength = payloadLength;
+    entry.Priority = static_cast<uint8_t>(priority);
+    entry.Retain = retain;
+    entry.Qos = qos;
+    memcpy(&_outboxArena[entry.Offset], topic, topicLength + 1);
+    memcpy(&_outboxArena[entry.Offset + topicLength + 1], payload, payloadLength + 1);
+
+    _outbox.push_back(entry);
+    indexEntry(_outbox.size() - 1);
+    _outboxArenaEnd += size;
+    _outboxCount++;
+    _outboxBytes += size;
+
+    drainOutbox();
+    return true;
+}
+
+MqttSettingsClass::OutboxEntry_t* MqttSettingsClass::findEntry(const char* topic, const size_t topicLength, const uint32_t topicHash, const MqttPriority priority)
+{
+    // Sent and evicted entries stay in the index until the next purge, they don't match
+    for (size_t i = topicHash & (MQTT_OUTBOX_INDEX_SIZE - 1); _outboxIndex[i] != 0; i = (i + 1) & (MQTT_OUTBOX_INDEX_SIZE - 1)) {
+        OutboxEntry_t& entry = _outbox[_outboxIndex[i] - 1];
+        if (entry.Priority == static_cast<uint8_t>(priority) && entry.TopicHash == topicHash
+            && entry.TopicLength == topicLength && memcmp(&_outboxArena[entry.Offset], topic, topicLength) == 0) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+void MqttSettingsClass::indexEntry(const size_t position)
+{
+    // Never full, _outbox holds at most MQTT_OUTBOX_MAX_MESSAGES entries
+    size_t i = _outbox[position].TopicHash & (MQTT_OUTBOX_INDEX_SIZE - 1);
+    while (_outboxIndex[i] != 0) {
+        i = (i + 1) & (MQTT_OUTBOX_INDEX_SIZE - 1);
+    }
+    _outboxIndex[i] = position + 1;
+}
+
+void MqttSettingsClass::rebuildIndex()
+{
+    std::fill(_outboxIndex.begin(), _outboxIndex.end(), 0);
+    if (_outboxIndex.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < _outbox.size(); i++) {
+        if (_outbox[i].Priority != MQTT_PRIORITY_COUNT) {
+            indexEntry(i);
+        }
+    }
+}
+
+bool MqttSettingsClass::makeRoom(const size_t size, const MqttPriority priority)
+{
+    auto fits = [this, size]() {
+        return _outboxBytes + size <= MQTT_OUTBOX_BUDGET && _outboxCount < MQTT_OUTBOX_MAX_MESSAGES;
+    };
+
+    // Evict the oldest messages, starting with the lowest priority. Messages of a higher priority are kept.
+    for (int8_t p = MQTT_PRIORITY_COUNT - 1; p >= static_cast<int8_t>(priority) && !fits(); p--) {
+        for (auto& entry : _outbox) {
+            if (fits()) {
+                break;
+            }
+            if (entry.Priority == p) {
+                removeEntry(entry);
+                _outboxDropped++;
+            }
+        }
+    }
+
+    return fits();
+}
+
+void MqttSettingsClass::removeEntry(OutboxEntry_t& entry)
+{
+    entry.Priority = MQTT_PRIORITY_COUNT;
+    _outboxCount--;
+    _outboxBytes -= entry.Capacity;
+}
+
+void MqttSettingsClass::purgeEntries()
+{
+    const size_t size = _outbox.size();
+    _outbox.erase(std::remove_if(_outbox.begin(), _outbox.end(),
+                      [](const OutboxEntry_t& entry) { return entry.Priority == MQTT_PRIORITY_COUNT; }),
+        _outbox.end());
+
+    if (_outbox.empty()) {
+        _outboxArenaEnd = 0;
+    }
+
+    // The positions of the remaining entries changed
+    if (_outbox.size() != size) {
+        rebuildIndex();
+    }
+}
+
+void MqttSettingsClass::compactArena()
+{
+    purgeEntries();
+
+    // The regions are in the same order as the entries, moving them to the front never overwrites a later one
+    size_t end = 0;
+    for (auto& entry : _outbox) {
+        if (entry.Offset != end) {
+            memmove(&_outboxArena[end], &_outboxArena[entry.Offset], entry.Capacity);
+            entry.Offset = end;
+        }
+        end += entry.Capacity;
+    }
+    _outboxArenaEnd = end;
+}
+
+void MqttSettingsClass::allocateOutbox(const bool enabled)
+{
+    if (enabled && !_outboxArena.empty()) {
         return;
     }
-    _mqttClient->publish(topic.c_str(), qos, retain, payload.c_str());
+
+    // Called after a disconnect, the outbox is empty
+    _outbox.clear();
+    _outboxArenaEnd = 0;
+    _outboxCount = 0;
+    _outboxBytes = 0;
+
+    if (!enabled) {
+        _outboxArena = std::vector<uint8_t>();
+        _outbox = std::vector<OutboxEntry_t>();
+        _outboxIndex = std::vector<uint16_t>();
+        return;
+    }
+
+    try {
+        _outboxArena.resize(MQTT_OUTBOX_BUDGET);
+        _outbox.reserve(MQTT_OUTBOX_MAX_MESSAGES);
+        _outboxIndex.assign(MQTT_OUTBOX_INDEX_SIZE, 0);
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Cannot allocate MQTT outbox. Reason: \"%s\".", bad_alloc.what());
+        allocateOutbox(false);
+    }
+}
+
+void MqttSettingsClass::drainOutbox()
+{
+    if (_mqttClient == nullptr || !_mqttClient->connected()) {
+        return;
+    }
+
+    for (uint8_t p = 0; p < MQTT_PRIORITY_COUNT; p++) {
+        for (auto& entry : _outbox) {
+            if (entry.Priority != p) {
+                continue;
+            }
+
+            // Pace by the messages the client has not sent or got acknowledged yet
+            if (_mqttClient->queueSize() >= MQTT_OUTBOX_MAX_PENDING) {
+                purgeEntries();
+                return;
+            }
+
+            const char* topic = reinterpret_cast<const char*>(&_outboxArena[entry.Offset]);
+            const char* payload = topic + entry.TopicLength + 1;
+            if (_mqttClient->publish(topic, entry.Qos, entry.Retain, payload) == 0) {
+                purgeEntries();
+                return;
+            }
+
+            countPublish();
+            removeEntry(entry);
+        }
+    }
+
+    purgeEntries();
+}
+
+void MqttSettingsClass::loopOutbox()
+{
+    std::lock_guard<std::mutex> lock(_clientLock);
+    drainOutbox();
+}
+
+void MqttSettingsClass::countPublish()
+{
+    _publishCount++;
+
+    const uint32_t now = millis();
+    if (now - _rateWindowStart >= 60000) {
+        _publishRate = (now - _rateWindowStart < 120000) ? _rateWindowCount : 0;
+        _rateWindowStart = now;
+        _rateWindowCount = 0;
+    }
+    _rateWindowCount++;
 }
 
-void MqttSettingsClass::init()
+MqttOutboxStats_t MqttSettingsClass::getOutboxStats()
+{
+    std::lock_guard<std::mutex> lock(_clientLock);
+
+    MqttOutboxStats_t stats = {};
+    stats.Messages = _outboxCount;
+    stats.Bytes = _outboxBytes;
+    stats.Pending = _mqttClient != nullptr ? _mqttClient->queueSize() : 0;
+    stats.Dropped = _outboxDropped;
+    stats.Coalesced = _outboxCoalesced;
+    return stats;
+}
+
+uint32_t MqttSettingsClass::getPublishCount()
+{
+    std::lock_guard<std::mutex> lock(_clientLock);
+    return _publishCount;
+}
+
+uint32_t MqttSettingsClass::getPublishRate()
+{
+    std::lock_guard<std::mutex> lock(_clientLock);
+    const uint32_t elapsed = millis() - _rateWindowStart;
+    if (elapsed >= 120000) {
+        return 0; // nothing published during the last complete minute
+    }
+    if (elapsed >= 60000) {
+        return _rateWindowCount;
+    }
+    return _publishRate;
+}
+
+uint32_t MqttSettingsClass::getConnectCount() const
+{
+    return _connectCount;
+}
+
+void MqttSettingsClass::init(Scheduler& scheduler)
 {
     using std::placeholders::_1;
     NetworkSettings.onEvent(std::bind(&MqttSettingsClass::NetworkEvent, this, _1));
+    Configuration.onChange(std::bind(&MqttSettingsClass::onConfigChange, this, _1));
 
     createMqttClientObject();
+
+    scheduler.addTask(_outboxTask);
+    _outboxTask.enable();
 }
 
 void MqttSettingsClass::createMqttClientObject()
@@ -242,8 +555,10 @@ void MqttSettingsClass::createMqttClientObject()
         delete _mqttClient;
         _mqttClient = nullptr;
     }
-    const CONFIG_T& config = Configuration.get();
-    if (config.Mqtt.Tls.Enabled) {
+    const auto config = Configuration.get();
+    _retain = config->Mqtt.Retain;
+    allocateOutbox(config->Mqtt.Enabled);
+    if (config->Mqtt.Tls.Enabled) {
         _mqttClient = static_cast<MqttClient*>(new espMqttClientSecure);
     } else {
         _mqttClient = static_cast<MqttClient*>(new espMqttClient);
@@ -148,7 +148,7 @@ void NetworkSettingsClass::raiseEvent(const network_event event)
 
 void NetworkSettingsClass::handleMDNS()
 {
-    const bool mdnsEnabled = Configuration.get().Mdns.Enabled;
+    const bool mdnsEnabled = Configuration.get()->Mdns.Enabled;
 
     // Return if no state change
     if (_lastMdnsEnabled == mdnsEnabled) {
@@ -183,7 +183,7 @@ void NetworkSettingsClass::setupMode()
         WiFi.mode(WIFI_AP_STA);
         String ssidString = getApName();
         WiFi.softAPConfig(_apIp, _apIp, _apNetmask);
-        WiFi.softAP(ssidString.c_str(), Configuration.get().Security.Password);
+        WiFi.softAP(ssidString.c_str(), Configuration.get()->Security.Password);
         _dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
         _dnsServer->start(DNS_PORT, "*", WiFi.softAPIP());
         _dnsServerStatus = true;
@@ -207,7 +207,7 @@ void NetworkSettingsClass::enableAdminMode()
     _connectRedoTimer = 0;
 
     _adminTimeoutCounter = 0;
-    _adminTimeoutCounterMax = Configuration.get().WiFi.ApTimeout * 60;
+    _adminTimeoutCounterMax = Configuration.get()->WiFi.ApTimeout * 60;
     _adminEnabled = true;
     setupMode();
 }
@@ -222,7 +222,7 @@ void NetworkSettingsClass::disableAdminMode()
 bool NetworkSettingsClass::wifiConfigured() const
 {
     // Check if SSID is empty
-    return strcmp(Configuration.get().WiFi.Ssid, "");
+    return strcmp(Configuration.get()->WiFi.Ssid, "");
 }
 
 String NetworkSettingsClass::getApName() const
@@ -315,7 +315,8 @@ void NetworkSettingsClass::applyConfig()
 {
     setHostname();
 
-    const auto& config = Configuration.get().WiFi;
+    const auto snapshot = Configuration.get();
+    const auto& config = snapshot->WiFi;
 
     if (!wifiConfigured()) {
         return;
@@ -372,7 +373,8 @@ void NetworkSettingsClass::setStaticIp()
         return;
     }
 
-    const auto& config = Configuration.get().WiFi;
+    const auto snapshot = Configuration.get();
+    const auto& config = snapshot->WiFi;
     const char* mode = (_networkMode == network_mode::WiFi) ? "WiFi" : "Ethernet";
     const char* ipType = config.Dhcp ? "DHCP" : "static";
 
@@ -481,13 +483,13 @@ String NetworkSettingsClass::macAddress() const
 
 String NetworkSettingsClass::getHostname()
 {
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
     char preparedHostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
     char resultHostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
     uint8_t pos = 0;
 
     const uint32_t chipId = Utils::getChipId();
-    snprintf(preparedHostname, WIFI_MAX_HOSTNAME_STRLEN + 1, config.WiFi.Hostname, chipId);
+    snprintf(preparedHostname, WIFI_MAX_HOSTNAME_STRLEN + 1, config->WiFi.Hostname, chipId);
 
     const char* pC = preparedHostname;
     while (*pC && pos < WIFI_MAX_HOSTNAME_STRLEN) { // while !null and not over length
@@ -18,12 +18,12 @@ void NtpSettingsClass::init()
 
 void NtpSettingsClass::setServer()
 {
-    Mycila::NTP.sync(Configuration.get().Ntp.Server);
+    Mycila::NTP.sync(Configuration.get()->Ntp.Server);
 }
 
 void NtpSettingsClass::setTimezone()
 {
-    Mycila::NTP.setTimeZone(Configuration.get().Ntp.TimezoneDescr);
+    Mycila::NTP.setTimeZone(Configuration.get()->Ntp.TimezoneDescr);
 }
 
 NtpSettingsClass NtpSettings;
@@ -3,8 +3,12 @@
  * Copyright (C) 2024-2026 Thomas Basler and others
  */
 #include "RestartHelper.h"
+#include "Configuration.h"
 #include "Display_Graphic.h"
+#include "EnergyRollup.h"
 #include "Led_Single.h"
+#include "Utils.h"
+#include "WarmStart.h"
 #include <Esp.h>
 
 RestartHelperClass RestartHelper;
@@ -25,12 +29,29 @@ void RestartHelperClass::triggerRestart()
     _rebootTask.restart();
 }
 
+void RestartHelperClass::triggerFactoryReset()
+{
+    // Nothing must be saved anymore, otherwise the flushes below would restore parts of the configuration
+    Configuration.discardWrites();
+    _factoryReset = true;
+    triggerRestart();
+}
+
 void RestartHelperClass::loop()
 {
     if (_rebootTask.isFirstIteration()) {
         LedSingle.turnAllOff();
         Display.setStatus(false);
+        if (!_factoryReset) {
+            Configuration.flush();
+            EnergyRollup.flush();
+            WarmStart.checkpoint();
+        }
     } else {
+        // Removed right before the restart so that no other task can write files afterwards
+        if (_factoryReset) {
+            Utils::removeAllFiles();
+        }
         ESP.restart();
     }
 }
@@ -77,10 +77,10 @@ void SunPositionClass::updateSunData()
         return;
     }
 
-    CONFIG_T const& config = Configuration.get();
+    const auto config = Configuration.get();
 
     double sunset_type;
-    switch (config.Ntp.SunsetType) {
+    switch (config->Ntp.SunsetType) {
     case 0:
         sunset_type = SunSet::SUNSET_OFFICIAL;
         break;
@@ -98,7 +98,7 @@ void SunPositionClass::updateSunData()
     const int offset = Utils::getTimezoneOffset() / 3600;
 
     SunSet sun;
-    sun.setPosition(config.Ntp.Latitude, config.Ntp.Longitude, offset);
+    sun.setPosition(config->Ntp.Latitude, config->Ntp.Longitude, offset);
     sun.setCurrentDate(1900 + timeinfo.tm_year, timeinfo.tm_mon + 1, timeinfo.tm_mday);
 
     const double sunriseRaw = sun.calcCustomSunrise(sunset_type);
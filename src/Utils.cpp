@@ -70,18 +70,47 @@ bool Utils::checkJsonAlloc(const JsonDocument& doc, const char* function, const
     return true;
 }
 
-/// @brief Remove all files but the PINMAPPING_FILENAME
-void Utils::removeAllFiles()
+/// @brief Remove all files but the PINMAPPING_FILENAME, including the files in directories
+static void removeFiles(const String& path)
 {
-    auto root = LittleFS.open("/");
-    auto file = root.getNextFileName();
+    auto dir = LittleFS.open(path);
+    bool isDir = false;
+    auto file = dir.getNextFileName(&isDir);
 
     while (file != "") {
-        if (file != PINMAPPING_FILENAME) {
+        if (isDir) {
+            removeFiles(file);
+            LittleFS.rmdir(file);
+        } else if (file != PINMAPPING_FILENAME) {
             LittleFS.remove(file);
         }
-        file = root.getNextFileName();
+        file = dir.getNextFileName(&isDir);
     }
+    dir.close();
+}
+
+void Utils::removeAllFiles()
+{
+    removeFiles("/");
+}
+
+// Checks whether a file of the given size can be written next to the existing files.
+// Only the configuration may use the reserved space.
+bool Utils::hasFreeSpace(const size_t bytes, const bool useReserve)
+{
+    // Each file occupies whole blocks and needs an additional block for its metadata
+    size_t required = (bytes + LITTLEFS_BLOCK_SIZE - 1) / LITTLEFS_BLOCK_SIZE * LITTLEFS_BLOCK_SIZE + LITTLEFS_BLOCK_SIZE;
+    if (!useReserve) {
+        required += LITTLEFS_CONFIG_RESERVE;
+    }
+
+    const size_t total = LittleFS.totalBytes();
+    const size_t used = LittleFS.usedBytes();
+    if (used + required > total) {
+        ESP_LOGW(TAG, "Not enough space on LittleFS for %zu bytes (%zu of %zu bytes used)", bytes, used, total);
+        return false;
+    }
+    return true;
 }
 
 String Utils::generateMd5FromFile(String file)
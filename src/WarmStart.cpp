@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Checkpoints the last statistics of every inverter to LittleFS and restores them at boot.
+
+Without this, all values are zero after a restart until the inverter answers the first
+RealTimeRunDataCommand. The restored statistics are marked as cached (stale) and are not
+reported as an update, so MQTT, history and energy rollups only see real data.
+
+To limit flash wear a checkpoint is only written every WARMSTART_CHECKPOINT_INTERVAL, if
+new data was received in the meantime, and before a restart.
+
+The yield day correction is restored once the time is valid and only if the checkpoint was
+written on the same day.
+*/
+#include "WarmStart.h"
+#include "Utils.h"
+#include <LittleFS.h>
+
+#undef TAG
+static const char* TAG = "warmstart";
+
+WarmStartClass WarmStart;
+
+WarmStartClass::WarmStartClass()
+    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WarmStartClass::loop, this))
+{
+}
+
+void WarmStartClass::init(Scheduler& scheduler)
+{
+    if (!LittleFS.exists(WARMSTART_DIR)) {
+        LittleFS.mkdir(WARMSTART_DIR);
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+String WarmStartClass::getFileName(const uint64_t serial)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), WARMSTART_DIR "/%0" PRIx32 "%08" PRIx32 ".bin",
+        static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(serial & 0xFFFFFFFF));
+    return fileName;
+}
+
+void WarmStartClass::loop()
+{
+    const bool doCheckpoint = millis() - _lastCheckpoint > WARMSTART_CHECKPOINT_INTERVAL;
+    if (doCheckpoint) {
+        _lastCheckpoint = millis();
+    }
+
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        InverterState_t* state = nullptr;
+        for (auto& s : _states) {
+            if (s.serial == inv->serial()) {
+                state = &s;
+                break;
+            }
+        }
+
+        // Inverters are restored when they are seen for the first time, also if they are added at runtime
+        if (state == nullptr) {
+            _states.emplace_back();
+            state = &_states.back();
+            state->serial = inv->serial();
+            restore(*state, inv);
+            continue;
+        }
+
+        if (state->yieldPending) {
+            restoreYieldDayCorrection(*state, inv);
+        }
+
+        if (doCheckpoint) {
+            write(*state, inv);
+        }
+    }
+}
+
+void WarmStartClass::checkpoint()
+{
+    for (auto& state : _states) {
+        auto inv = Hoymiles.getInverterBySerial(state.serial);
+        if (inv != nullptr) {
+            write(state, inv);
+        }
+    }
+    _lastCheckpoint = millis();
+}
+
+void WarmStartClass::restore(InverterState_t& state, std::shared_ptr<InverterAbstract> inv)
+{
+    SnapshotFile_t data = {};
+
+    File f = LittleFS.open(getFileName(inv->serial()), "r");
+    if (!f) {
+        return;
+    }
+    const size_t len = f.read(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+    f.close();
+
+    if (len != sizeof(data) || data.magic != WARMSTART_FILE_MAGIC || data.version != WARMSTART_FILE_VERSION
+        || data.statisticLength < inv->Statistics()->getExpectedByteCount() || data.statisticLength > STATISTIC_PACKET_SIZE) {
+        ESP_LOGW(TAG, "Ignored invalid %s", getFileName(inv->serial()).c_str());
+        return;
+    }
+
+    // Don't overwrite data which was already received from the inverter
+    if (inv->Statistics()->getLastUpdate() > 0) {
+        return;
+    }
+
+    inv->Statistics()->clearBuffer();
+    inv->Statistics()->appendFragment(0, data.statistic, data.statisticLength);
+    inv->Statistics()->setRxFailureCount(data.rxFailureCount);
+    inv->Statistics()->setCached(true);
+    inv->Statistics()->setLastUpdateFromInternal(millis());
+
+    if (data.timestamp > 0) {
+        state.yieldPending = true;
+        state.timestamp = data.timestamp;
+        memcpy(state.yieldDayOffset, data.yieldDayOffset, sizeof(state.yieldDayOffset));
+        memcpy(state.lastYieldDay, data.lastYieldDay, sizeof(state.lastYieldDay));
+    }
+
+    ESP_LOGI(TAG, "Restored statistics of %s", inv->serialString().c_str());
+}
+
+void WarmStartClass::restoreYieldDayCorrection(InverterState_t& state, std::shared_ptr<InverterAbstract> inv)
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, 5)) {
+        return;
+    }
+    state.yieldPending = false;
+
+    if (!inv->Statistics()->getYieldDayCorrection()) {
+        return;
+    }
+
+    struct tm checkpointinfo;
+    const time_t timestamp = state.timestamp;
+    localtime_r(&timestamp, &checkpointinfo);
+    if (checkpointinfo.tm_year != timeinfo.tm_year || checkpointinfo.tm_yday != timeinfo.tm_yday) {
+        return;
+    }
+
+    const bool received = inv->Statistics()->getLastUpdate() > 0;
+    for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        inv->Statistics()->setChannelFieldOffset(TYPE_DC, c, FLD_YD, state.yieldDayOffset[c]);
+
+        // If data was received in the meantime, the reset detection continues from the corrected current value
+        inv->Statistics()->setLastYieldDay(c, received ? inv->Statistics()->getChannelFieldValue(TYPE_DC, c, FLD_YD) : state.lastYieldDay[c]);
+    }
+    inv->Statistics()->setLastUpdateFromInternal(millis());
+
+    ESP_LOGI(TAG, "Restored yield day correction of %s", inv->serialString().c_str());
+}
+
+void WarmStartClass::write(InverterState_t& state, std::shared_ptr<InverterAbstract> inv)
+{
+    const uint32_t lastUpdate = inv->Statistics()->getLastUpdate();
+    if (lastUpdate == 0 || lastUpdate == state.lastUpdate) {
+        return;
+    }
+
+    SnapshotFile_t data = {};
+    data.magic = WARMSTART_FILE_MAGIC;
+    data.version = WARMSTART_FILE_VERSION;
+
+    struct tm timeinfo;
+    if (getLocalTime(&timeinfo, 5)) {
+        data.timestamp = time(nullptr);
+    }
+    data.rxFailureCount = inv->Statistics()->getRxFailureCount();
+
+    const auto raw = inv->Statistics()->getRawData();
+    data.statisticLength = std::min<size_t>(raw.size(), STATISTIC_PACKET_SIZE);
+    memcpy(data.statistic, raw.data(), data.statisticLength);
+
+    for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        data.yieldDayOffset[c] = inv->Statistics()->getChannelFieldOffset(TYPE_DC, c, FLD_YD);
+        data.lastYieldDay[c] = inv->Statistics()->getLastYieldDay(c);
+    }
+
+    const String fileName = getFileName(inv->serial());
+    const String tmpName = fileName + ".tmp";
+
+    if (!Utils::hasFreeSpace(sizeof(data))) {
+        return;
+    }
+
+    File f = LittleFS.open(tmpName, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to write %s", tmpName.c_str());
+        return;
+    }
+    const size_t len = f.write(reinterpret_cast<const uint8_t*>(&data), sizeof(data));
+    f.close();
+
+    if (len != sizeof(data) || !LittleFS.rename(tmpName, fileName)) {
+        ESP_LOGE(TAG, "Failed to write %s", fileName.c_str());
+        LittleFS.remove(tmpName);
+        return;
+    }
+
+    state.lastUpdate = lastUpdate;
+}
@@ -6,6 +6,8 @@
 #include "Configuration.h"
 #include "defaults.h"
 #include <AsyncJson.h>
+#include <GzipPrint.h>
+#include <StreamString.h>
 
 #undef TAG
 static const char* TAG = "webapi";
@@ -17,13 +19,16 @@ WebApiClass::WebApiClass()
 
 void WebApiClass::init(Scheduler& scheduler)
 {
+    _webApiAdmission.init(_server, scheduler);
     _webApiDevice.init(_server, scheduler);
     _webApiDevInfo.init(_server, scheduler);
     _webApiDtu.init(_server, scheduler);
+    _webApiEnergy.init(_server, scheduler);
     _webApiEventlog.init(_server, scheduler);
     _webApiFile.init(_server, scheduler);
     _webApiFirmware.init(_server, scheduler);
     _webApiGridprofile.init(_server, scheduler);
+    _webApiHistory.init(_server, scheduler);
     _webApiI18n.init(_server, scheduler);
     _webApiInverter.init(_server, scheduler);
     _webApiLimit.init(_server, scheduler);
@@ -35,6 +40,7 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiPower.init(_server, scheduler);
     _webApiPrometheus.init(_server, scheduler);
     _webApiSecurity.init(_server, scheduler);
+    _webApiSseLive.init(_server, scheduler);
     _webApiSysstatus.init(_server, scheduler);
     _webApiWebapp.init(_server, scheduler);
     _webApiWsConsole.init(_server, scheduler);
@@ -45,14 +51,15 @@ void WebApiClass::init(Scheduler& scheduler)
 
 void WebApiClass::reload()
 {
+    _webApiSseLive.reload();
     _webApiWsConsole.reload();
     _webApiWsLive.reload();
 }
 
 bool WebApiClass::checkCredentials(AsyncWebServerRequest* request)
 {
-    auto const& config = Configuration.get();
-    if (request->authenticate(AUTH_USERNAME, config.Security.Password)) {
+    const auto config = Configuration.get();
+    if (request->authenticate(AUTH_USERNAME, config->Security.Password)) {
         return true;
     }
 
@@ -69,31 +76,29 @@ bool WebApiClass::checkCredentials(AsyncWebServerRequest* request)
 
 bool WebApiClass::checkCredentialsReadonly(AsyncWebServerRequest* request)
 {
-    auto const& config = Configuration.get();
-    if (config.Security.AllowReadonly) {
+    const auto config = Configuration.get();
+    if (config->Security.AllowReadonly) {
         return true;
     } else {
         return checkCredentials(request);
     }
 }
 
-void WebApiClass::sendTooManyRequests(AsyncWebServerRequest* request)
+void WebApiClass::sendTooManyRequests(AsyncWebServerRequest* request, const uint16_t retryAfter)
 {
     auto response = request->beginResponse(429, asyncsrv::T_text_plain, "Too Many Requests");
-    response->addHeader(asyncsrv::T_retry_after, "60");
+    response->addHeader(asyncsrv::T_retry_after, String(retryAfter));
     request->send(response);
 }
 
 void WebApiClass::writeConfig(JsonVariant& retMsg, const WebApiError code, const String& message)
 {
-    if (!Configuration.write()) {
-        retMsg["message"] = "Write failed!";
-        retMsg["code"] = WebApiError::GenericWriteFailed;
-    } else {
-        retMsg["type"] = "success";
-        retMsg["message"] = message;
-        retMsg["code"] = code;
-    }
+    // The save is deferred. A failure is reported by the system status.
+    Configuration.write();
+
+    retMsg["type"] = "success";
+    retMsg["message"] = message;
+    retMsg["code"] = code;
 }
 
 bool WebApiClass::parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document)
@@ -130,6 +135,44 @@ uint64_t WebApiClass::parseSerialFromRequest(AsyncWebServerRequest* request, Str
     return 0;
 }
 
+// Checks whether the comma separated Accept-Encoding header contains the encoding as a
+// complete token, e.g. "gzip, br;q=0.8". An encoding with q=0 is not acceptable.
+bool WebApiClass::acceptsEncoding(AsyncWebServerRequest* request, const char* encoding)
+{
+    const AsyncWebHeader* h = request->getHeader("Accept-Encoding");
+    if (h == nullptr) {
+        return false;
+    }
+    const String& header = h->value();
+
+    int start = 0;
+    while (start < static_cast<int>(header.length())) {
+        int end = header.indexOf(',', start);
+        if (end < 0) {
+            end = header.length();
+        }
+
+        String token = header.substring(start, end);
+        start = end + 1;
+
+        String params;
+        const int separator = token.indexOf(';');
+        if (separator >= 0) {
+            params = token.substring(separator + 1);
+            token.remove(separator);
+        }
+        token.trim();
+        if (!token.equalsIgnoreCase(encoding)) {
+            continue;
+        }
+
+        params.replace(" ", "");
+        const int quality = params.indexOf("q=");
+        return quality < 0 || params.substring(quality + 2).toFloat() > 0;
+    }
+    return false;
+}
+
 bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line)
 {
     bool ret_val = true;
@@ -150,4 +193,97 @@ bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResp
     return ret_val;
 }
 
+struct ChunkedResponseState {
+    StreamString buffer;
+    std::unique_ptr<GzipPrint> gzip;
+    size_t offset = 0;
+    size_t part = 0;
+    bool lastPart = false;
+};
+
+// Renders the next part into the buffer. Returns false if it ran out of memory.
+static bool renderNextPart(ChunkedResponseState& state, ChunkedPartGenerator& generator)
+{
+    try {
+        if (state.gzip) {
+            state.lastPart = !generator(*state.gzip, state.part++);
+            if (state.lastPart) {
+                state.gzip->finish();
+            }
+        } else {
+            state.lastPart = !generator(state.buffer, state.part++);
+        }
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Chunked response out of resources in part %zu. Reason: \"%s\".", state.part - 1, bad_alloc.what());
+        return false;
+    }
+    return true;
+}
+
+/// @brief Sends a response whose body is rendered part by part while the client receives it.
+/// Only one part is kept in memory at a time. The next part is generated once the previous
+/// one has been handed over to the TCP stack completely.
+/// If the first part fails, the request is answered with status 500. Later failures can't change
+/// the status anymore, so the connection is aborted. A regular end of the chunked body would
+/// let the client take the truncated body as complete.
+void WebApiClass::sendChunkedResponse(AsyncWebServerRequest* request, const char* contentType, ChunkedPartGenerator&& generator, const bool gzip)
+{
+    auto state = std::make_shared<ChunkedResponseState>();
+
+    if (gzip) {
+        state->gzip = std::make_unique<GzipPrint>(state->buffer);
+        if (!state->gzip->begin()) {
+            // Not enough memory for the compression buffers, send the response uncompressed
+            state->gzip.reset();
+        }
+    }
+
+    if (!renderNextPart(*state, generator)) {
+        state.reset();
+
+        AsyncJsonResponse* response = new AsyncJsonResponse();
+        auto& root = response->getRoot();
+        root["message"] = "500 Internal Server Error: Out of memory";
+        root["code"] = WebApiError::GenericInternalServerError;
+        root["type"] = "danger";
+        response->setCode(500);
+        response->setLength();
+        request->send(response);
+        return;
+    }
+
+    auto response = request->beginChunkedResponse(contentType, [state, request, generator = std::move(generator)](uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+        for (uint8_t parts = 0; state->offset >= state->buffer.length(); parts++) {
+            if (state->lastPart) {
+                return 0;
+            }
+
+            // Parts can be empty, e.g. while the compressor collects data. Continue with the next call.
+            if (parts == WEBAPI_CHUNKED_MAX_PARTS_PER_CALL) {
+                return RESPONSE_TRY_AGAIN;
+            }
+
+            state->buffer.remove(0);
+            state->offset = 0;
+
+            if (!renderNextPart(*state, generator)) {
+                state->lastPart = true;
+                request->client()->abort();
+                return 0;
+            }
+        }
+
+        const size_t len = std::min(maxLen, state->buffer.length() - state->offset);
+        memcpy(buffer, state->buffer.c_str() + state->offset, len);
+        state->offset += len;
+        return len;
+    });
+
+    response->addHeader(asyncsrv::T_Cache_Control, asyncsrv::T_no_cache);
+    if (state->gzip) {
+        response->addHeader(asyncsrv::T_Content_Encoding, asyncsrv::T_gzip);
+    }
+    request->send(response);
+}
+
 WebApiClass WebApi;
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Admission control for all web requests. Before a handler runs, the heap it is expected
+to need (derived from previous requests of the same endpoint) is compared with the
+biggest free heap block. If the budget is exhausted, or too many requests are in flight,
+the request is rejected with 429 and a short Retry-After instead of failing later inside
+the handler.
+
+A request is charged for the lowest free heap seen between its admission and its destruction.
+Chunked and streamed responses allocate most of their memory after the handler returned,
+so the free heap is sampled periodically while requests are in flight.
+*/
+#include "WebApi_admission.h"
+#include "WebApi.h"
+#include <AsyncJson.h>
+#include <algorithm>
+
+#undef TAG
+static const char* TAG = "webapi";
+
+WebApiAdmissionClass::WebApiAdmissionClass()
+    : _sampleTask(WEBAPI_ADMISSION_SAMPLE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&WebApiAdmissionClass::sampleHeap, this))
+{
+}
+
+void WebApiAdmissionClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    server.addMiddleware(std::bind(&WebApiAdmissionClass::onRequest, this, _1, _2));
+
+    scheduler.addTask(_sampleTask);
+    _sampleTask.enable();
+
+    server.on("/api/admission/status", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiAdmissionClass::onAdmissionStatus, this, _1)));
+}
+
+WebApiAdmissionClass::EndpointStats_t& WebApiAdmissionClass::getStats(const String& url)
+{
+    // Arbitrary urls end up in the not found handler. Don't let them grow the statistics without bounds.
+    if (_stats.find(url) == _stats.end() && (!url.startsWith("/api/") || _stats.size() >= WEBAPI_ADMISSION_MAX_ENDPOINTS)) {
+        return _stats["other"];
+    }
+
+    return _stats[url];
+}
+
+void WebApiAdmissionClass::onRequest(AsyncWebServerRequest* request, ArMiddlewareNext next)
+{
+    // Long living connections (websockets and event streams) are not tracked
+    if (request->hasHeader("Upgrade")
+        || (request->hasHeader("Accept") && request->getHeader("Accept")->value().indexOf("text/event-stream") >= 0)) {
+        next();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto& stats = getStats(request->url());
+    stats.requests++;
+
+    const uint32_t maxAllocHeap = ESP.getMaxAllocHeap();
+    if (_inFlight >= WEBAPI_ADMISSION_MAX_INFLIGHT
+        || maxAllocHeap < stats.estimatedHeap + WEBAPI_ADMISSION_HEAP_RESERVE) {
+
+        // Decay here as well, otherwise an endpoint with an outlier estimate is rejected forever
+        stats.estimatedHeap -= stats.estimatedHeap / 16;
+        stats.rejected++;
+        _rejected++;
+        const uint32_t inFlight = _inFlight;
+        lock.unlock();
+
+        ESP_LOGW(TAG, "Rejected %s: %" PRIu32 " requests in flight, %" PRIu32 " bytes available",
+            request->url().c_str(), inFlight, maxAllocHeap);
+
+        WebApi.sendTooManyRequests(request, WEBAPI_ADMISSION_RETRY_AFTER);
+        return;
+    }
+
+    // The request owns its disconnect callback and destroys it together with the response.
+    // The guard captured by the callback therefore releases the slot however the request ends.
+    request->onDisconnect([guard = std::make_shared<InFlightGuard>(*this, stats)]() {});
+
+    lock.unlock();
+
+    next();
+
+    // Most handlers allocated their response by now
+    sampleHeap();
+}
+
+void WebApiAdmissionClass::sampleHeap()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_guards.empty()) {
+        return;
+    }
+
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    for (auto guard : _guards) {
+        guard->minFree = std::min(guard->minFree, freeHeap);
+    }
+}
+
+WebApiAdmissionClass::InFlightGuard::InFlightGuard(WebApiAdmissionClass& admission, EndpointStats_t& stats)
+    : freeBefore(ESP.getFreeHeap())
+    , minFree(freeBefore)
+    , _admission(admission)
+    , _stats(stats)
+{
+    _admission._inFlight++;
+    _admission._peakInFlight = std::max(_admission._peakInFlight, _admission._inFlight);
+    _admission._guards.push_back(this);
+}
+
+WebApiAdmissionClass::InFlightGuard::~InFlightGuard()
+{
+    std::lock_guard<std::mutex> lock(_admission._mutex);
+
+    _admission._inFlight--;
+    auto& guards = _admission._guards;
+    guards.erase(std::remove(guards.begin(), guards.end(), this), guards.end());
+
+    const uint32_t used = freeBefore - minFree;
+
+    // Keep the peak, but let it decay slowly so a single outlier doesn't block an endpoint forever
+    _stats.estimatedHeap = std::max(used, _stats.estimatedHeap - _stats.estimatedHeap / 16);
+    _stats.peakHeap = std::max(used, _stats.peakHeap);
+    _stats.lastHeap = used;
+}
+
+void WebApiAdmissionClass::onAdmissionStatus(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        root["in_flight"] = _inFlight;
+        root["peak_in_flight"] = _peakInFlight;
+        root["rejected"] = _rejected;
+        root["heap_max_block"] = ESP.getMaxAllocHeap();
+
+        auto endpoints = root["endpoints"].to<JsonObject>();
+        for (auto& [url, stats] : _stats) {
+            auto endpoint = endpoints[url].to<JsonObject>();
+            endpoint["requests"] = stats.requests;
+            endpoint["rejected"] = stats.rejected;
+            endpoint["estimated_heap"] = stats.estimatedHeap;
+            endpoint["peak_heap"] = stats.peakHeap;
+            endpoint["last_heap"] = stats.lastHeap;
+        }
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
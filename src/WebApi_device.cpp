@@ -28,11 +28,11 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
     const PinMapping_t& pin = PinMapping.get();
 
     auto curPin = root["curPin"].to<JsonObject>();
-    curPin["name"] = config.Dev_PinMapping;
+    curPin["name"] = config->Dev_PinMapping;
 
     auto nrfPinObj = curPin["nrf24"].to<JsonObject>();
     nrfPinObj["clk"] = pin.nrf24_clk;
@@ -82,18 +82,18 @@ void WebApiDeviceClass::onDeviceAdminGet(AsyncWebServerRequest* request)
     }
 
     auto display = root["display"].to<JsonObject>();
-    display["rotation"] = config.Display.Rotation;
-    display["power_safe"] = config.Display.PowerSafe;
-    display["screensaver"] = config.Display.ScreenSaver;
-    display["contrast"] = config.Display.Contrast;
-    display["locale"] = config.Display.Locale;
-    display["diagramduration"] = config.Display.Diagram.Duration;
-    display["diagrammode"] = config.Display.Diagram.Mode;
+    display["rotation"] = config->Display.Rotation;
+    display["power_safe"] = config->Display.PowerSafe;
+    display["screensaver"] = config->Display.ScreenSaver;
+    display["contrast"] = config->Display.Contrast;
+    display["locale"] = config->Display.Locale;
+    display["diagramduration"] = config->Display.Diagram.Duration;
+    display["diagrammode"] = config->Display.Diagram.Mode;
 
     auto leds = root["led"].to<JsonArray>();
     for (uint8_t i = 0; i < PINMAPPING_LED_COUNT; i++) {
         auto led = leds.add<JsonObject>();
-        led["brightness"] = config.Led_Single[i].Brightness;
+        led["brightness"] = config->Led_Single[i].Brightness;
     }
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
@@ -152,14 +152,14 @@ void WebApiDeviceClass::onDeviceAdminPost(AsyncWebServerRequest* request)
         }
     }
 
-    auto const& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    Display.setDiagramMode(static_cast<DiagramMode_t>(config.Display.Diagram.Mode));
-    Display.setOrientation(config.Display.Rotation);
-    Display.enablePowerSafe = config.Display.PowerSafe;
-    Display.enableScreensaver = config.Display.ScreenSaver;
-    Display.setContrast(config.Display.Contrast);
-    Display.setLocale(config.Display.Locale);
+    Display.setDiagramMode(static_cast<DiagramMode_t>(config->Display.Diagram.Mode));
+    Display.setOrientation(config->Display.Rotation);
+    Display.enablePowerSafe = config->Display.PowerSafe;
+    Display.enableScreensaver = config->Display.ScreenSaver;
+    Display.setContrast(config->Display.Contrast);
+    Display.setLocale(config->Display.Locale);
     Display.Diagram().updatePeriod();
 
     WebApi.writeConfig(retMsg);
@@ -28,6 +28,7 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
 
     if (inv != nullptr) {
         root["valid_data"] = inv->DevInfo()->getLastUpdate() > 0;
+        root["cached"] = inv->DevInfo()->isCached();
         root["fw_bootloader_version"] = inv->DevInfo()->getFwBootloaderVersion();
         root["fw_build_version"] = inv->DevInfo()->getFwBuildVersion();
         root["hw_part_number"] = inv->DevInfo()->getHwPartNumber();
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+#include "WebApi_energy.h"
+#include "EnergyRollup.h"
+#include "WebApi.h"
+#include <algorithm>
+#include <memory>
+
+void WebApiEnergyClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    server.on("/api/energy/data", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiEnergyClass::onEnergyData, this, _1)));
+}
+
+/// @brief Returns the produced energy (Wh) of the last count periods including the current one.
+/// Parameters: inv (serial, omit for the sum of all inverters), resolution (hour, day, month, year), count.
+void WebApiEnergyClass::onEnergyData(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    static constexpr const char* resolutions[] = { "hour", "day", "month", "year" };
+
+    const uint64_t serial = WebApi.parseSerialFromRequest(request);
+
+    EnergyResolution_t resolution = ENERGY_DAY;
+    if (request->hasParam("resolution")) {
+        const String value = request->getParam("resolution")->value();
+        for (uint8_t r = ENERGY_HOUR; r <= ENERGY_YEAR; r++) {
+            if (value == resolutions[r]) {
+                resolution = static_cast<EnergyResolution_t>(r);
+            }
+        }
+    }
+
+    uint32_t count = request->hasParam("count") ? request->getParam("count")->value().toInt() : ENERGY_DEFAULT_COUNT;
+    count = std::clamp<uint32_t>(count, 1, ENERGY_MAX_COUNT);
+
+    const uint32_t lastPeriod = EnergyRollup.getPeriod(resolution, time(nullptr));
+    const uint32_t firstPeriod = lastPeriod >= count - 1 ? lastPeriod - (count - 1) : 0;
+    count = lastPeriod - firstPeriod + 1;
+
+    auto values = std::shared_ptr<float[]>(new (std::nothrow) float[count]);
+    if (values == nullptr || !EnergyRollup.getEnergy(serial, resolution, firstPeriod, count, values.get())) {
+        request->send(404);
+        return;
+    }
+
+    // Rendered in parts of 50 values to keep the response buffer small
+    WebApi.sendChunkedResponse(request, asyncsrv::T_application_json, [resolution, firstPeriod, count, values](Print& out, const size_t part) -> bool {
+        constexpr size_t valuesPerPart = 50;
+
+        if (part == 0) {
+            out.printf("{\"resolution\":\"%s\",\"unit\":\"Wh\",\"values\":[", resolutions[resolution]);
+        }
+
+        const size_t start = part * valuesPerPart;
+        const size_t end = std::min<size_t>(start + valuesPerPart, count);
+        for (size_t i = start; i < end; i++) {
+            out.printf("%s{\"t\":%" PRIu32 ",\"v\":%.1f}", i > 0 ? "," : "",
+                static_cast<uint32_t>(EnergyRollupClass::getPeriodStart(resolution, firstPeriod + i)), values[i]);
+        }
+
+        if (end >= count) {
+            out.print("]}");
+            return false;
+        }
+        return true;
+    });
+}
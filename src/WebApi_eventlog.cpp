@@ -3,27 +3,22 @@
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
 #include "WebApi_eventlog.h"
+#include "EventStore.h"
 #include "WebApi.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
+#include <algorithm>
 
 void WebApiEventlogClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
     server.on("/api/eventlog/status", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiEventlogClass::onEventlogStatus, this, _1)));
+    server.on("/api/eventlog/history", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiEventlogClass::onEventlogHistory, this, _1)));
 }
 
-void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
+AlarmMessageLocale_t WebApiEventlogClass::parseLocale(AsyncWebServerRequest* request)
 {
-    if (!WebApi.checkCredentialsReadonly(request)) {
-        return;
-    }
-
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    auto serial = WebApi.parseSerialFromRequest(request);
-
     AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
     if (request->hasParam("locale")) {
         String s = request->getParam("locale")->value();
@@ -35,6 +30,20 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
             locale = AlarmMessageLocale_t::FR;
         }
     }
+    return locale;
+}
+
+void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+    auto serial = WebApi.parseSerialFromRequest(request);
+
+    const AlarmMessageLocale_t locale = parseLocale(request);
 
     auto inv = Hoymiles.getInverterBySerial(serial);
 
@@ -51,7 +60,7 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
             inv->EventLog()->getLogEntry(logEntry, entry, locale);
 
             eventsObject["message_id"] = entry.MessageId;
-            eventsObject["message"] = entry.Message;
+            eventsObject["message"] = JsonString(entry.Message, true); // message texts are constant, no copy needed
             eventsObject["start_time"] = entry.StartTime;
             eventsObject["end_time"] = entry.EndTime;
         }
@@ -59,3 +68,41 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
+
+/// @brief Returns the stored events of one inverter with absolute start and end times.
+/// Parameters: inv (serial), since and until (epoch seconds, optional), offset and limit for pagination, locale.
+void WebApiEventlogClass::onEventlogHistory(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+    const uint64_t serial = WebApi.parseSerialFromRequest(request);
+    const AlarmMessageLocale_t locale = parseLocale(request);
+
+    const uint32_t since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+    const uint32_t until = request->hasParam("until") ? request->getParam("until")->value().toInt() : UINT32_MAX;
+    const size_t offset = request->hasParam("offset") ? request->getParam("offset")->value().toInt() : 0;
+    size_t limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : EVENTLOG_HISTORY_DEFAULT_LIMIT;
+    limit = std::clamp<size_t>(limit, 1, EVENTLOG_HISTORY_MAX_LIMIT);
+
+    auto inv = Hoymiles.getInverterBySerial(serial);
+
+    JsonArray eventsArray = root["events"].to<JsonArray>();
+    const size_t total = EventStore.forEachEvent(serial, since, until, offset, limit, [&](const StoredEvent_t& event) {
+        JsonObject eventsObject = eventsArray.add<JsonObject>();
+        eventsObject["message_id"] = event.messageId;
+        if (inv != nullptr) {
+            eventsObject["message"] = JsonString(inv->EventLog()->getMessage(event.messageId, locale), true);
+        }
+        eventsObject["start_time"] = event.startTime;
+        eventsObject["end_time"] = event.endTime;
+    });
+
+    root["total"] = total;
+    root["offset"] = offset;
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
@@ -5,7 +5,6 @@
 #include "WebApi_file.h"
 #include "Configuration.h"
 #include "RestartHelper.h"
-#include "Utils.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include <AsyncJson.h>
@@ -42,17 +41,23 @@ void WebApiFileClass::onFileListGet(AsyncWebServerRequest* request)
     File rootfs = LittleFS.open("/");
     File file = rootfs.openNextFile();
     while (file) {
-        if (file.isDirectory()) {
-            continue;
+        if (!file.isDirectory()) {
+            JsonObject obj = data.add<JsonObject>();
+            obj["name"] = String(file.name());
+            obj["size"] = file.size();
         }
-        JsonObject obj = data.add<JsonObject>();
-        obj["name"] = String(file.name());
-        obj["size"] = file.size();
 
         file = rootfs.openNextFile();
     }
     file.close();
 
+    // The configuration is stored in sections and offered as one JSON file
+    if (!LittleFS.exists(CONFIG_FILENAME)) {
+        JsonObject obj = data.add<JsonObject>();
+        obj["name"] = String(CONFIG_FILENAME).substring(1);
+        obj["size"] = Configuration.getExportSize();
+    }
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
@@ -64,13 +69,24 @@ void WebApiFileClass::onFileGet(AsyncWebServerRequest* request)
 
     String requestFile = CONFIG_FILENAME;
     if (request->hasParam("file")) {
-        String name = "/" + request->getParam("file")->value();
-        if (LittleFS.exists(name)) {
-            requestFile = name;
-        } else {
-            request->send(404);
+        requestFile = "/" + request->getParam("file")->value();
+    }
+
+    if (requestFile == CONFIG_FILENAME && !LittleFS.exists(requestFile)) {
+        AsyncResponseStream* response = request->beginResponseStream(asyncsrv::T_application_json);
+        response->addHeader("Content-Disposition", "attachment; filename=\"" + requestFile.substring(1) + "\"");
+        if (!Configuration.exportJson(*response)) {
+            delete response;
+            request->send(500);
             return;
         }
+        request->send(response);
+        return;
+    }
+
+    if (!LittleFS.exists(requestFile)) {
+        request->send(404);
+        return;
     }
 
     request->send(LittleFS, requestFile, String(), true);
@@ -146,8 +162,7 @@ void WebApiFileClass::onFileDeleteAll(AsyncWebServerRequest* request)
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
-    Utils::removeAllFiles();
-    RestartHelper.triggerRestart();
+    RestartHelper.triggerFactoryReset();
 }
 
 void WebApiFileClass::onFileUpload(AsyncWebServerRequest* request, String filename, size_t index, uint8_t* data, size_t len, bool final)
@@ -163,6 +178,10 @@ void WebApiFileClass::onFileUpload(AsyncWebServerRequest* request, String filena
             return;
         }
         const String name = "/" + request->getParam("file")->value();
+        if (name == CONFIG_FILENAME) {
+            // A pending save would replace the uploaded file with the sections
+            Configuration.discardWrites();
+        }
         request->_tempFile = LittleFS.open(name, "w");
     }
 
@@ -21,35 +21,58 @@ void WebApiGridProfileClass::onGridProfileStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    auto serial = WebApi.parseSerialFromRequest(request);
-    auto inv = Hoymiles.getInverterBySerial(serial);
-
-    if (inv != nullptr) {
-        root["name"] = inv->GridProfile()->getProfileName();
-        root["version"] = inv->GridProfile()->getProfileVersion();
-
-        auto jsonSections = root["sections"].to<JsonArray>();
-        auto profSections = inv->GridProfile()->getProfile();
+    const auto serial = WebApi.parseSerialFromRequest(request);
 
-        for (auto& profSection : profSections) {
-            auto jsonSection = jsonSections.add<JsonObject>();
-            jsonSection["name"] = profSection.SectionName;
+    // Stream the profile section by section instead of building one document containing all sections
+    WebApi.sendChunkedResponse(request, asyncsrv::T_application_json, [serial](Print& out, const size_t part) -> bool {
+        auto inv = Hoymiles.getInverterBySerial(serial);
 
-            auto jsonItems = jsonSection["items"].to<JsonArray>();
+        if (part == 0) {
+            if (inv == nullptr) {
+                out.print("{}");
+                return false;
+            }
 
-            for (auto& profItem : profSection.items) {
-                auto jsonItem = jsonItems.add<JsonObject>();
+            JsonDocument doc;
+            doc["name"] = inv->GridProfile()->getProfileName();
+            doc["version"] = inv->GridProfile()->getProfileVersion();
+            doc["cached"] = inv->GridProfile()->isCached();
+
+            String header;
+            serializeJson(doc, header);
+            header.remove(header.length() - 1); // keep the root object open
+            out.print(header);
+            out.print(",\"sections\":[");
+            return true;
+        }
 
-                jsonItem["n"] = profItem.Name;
-                jsonItem["u"] = profItem.Unit;
-                jsonItem["v"] = profItem.Value;
-            }
+        // Names and units are constant strings and are not copied into the document
+        JsonDocument doc;
+        JsonArray jsonItems;
+        auto onSection = [&doc, &jsonItems](const char* name) {
+            doc["name"] = JsonString(name, true);
+            jsonItems = doc["items"].to<JsonArray>();
+        };
+        auto onItem = [&jsonItems](const char* name, const char* unit, const float value) {
+            auto jsonItem = jsonItems.add<JsonObject>();
+            jsonItem["n"] = JsonString(name, true);
+            jsonItem["u"] = JsonString(unit, true);
+            jsonItem["v"] = value;
+        };
+
+        const bool found = inv != nullptr && inv->GridProfile()->visitSection(part - 1, onSection, onItem);
+
+        if (!found) {
+            out.print("]}");
+            return false;
         }
-    }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        if (part > 1) {
+            out.print(',');
+        }
+        serializeJson(doc, out);
+        return true;
+    });
 }
 
 void WebApiGridProfileClass::onGridProfileRawdata(AsyncWebServerRequest* request)
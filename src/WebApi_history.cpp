@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+#include "WebApi_history.h"
+#include "WebApi.h"
+#include <Hoymiles.h>
+#include <algorithm>
+
+// Start of the default range. Without synchronized time, to is close to zero.
+static uint32_t getDefaultFrom(const uint32_t to)
+{
+    return to > HISTORY_DEFAULT_RANGE ? to - HISTORY_DEFAULT_RANGE : 0;
+}
+
+void WebApiHistoryClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    server.on("/api/history/data", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiHistoryClass::onHistoryData, this, _1)));
+    server.on("/api/history/export", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiHistoryClass::onHistoryExport, this, _1)));
+}
+
+/// @brief Returns the recorded history of one inverter, downsampled to the requested amount of points.
+/// Parameters: inv (serial), from and to (epoch seconds), points.
+/// Every point contains min, max and average of all samples within its interval. Intervals without samples are omitted.
+void WebApiHistoryClass::onHistoryData(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    const uint64_t serial = WebApi.parseSerialFromRequest(request);
+
+    const uint32_t now = time(nullptr);
+    uint32_t to = request->hasParam("to") ? request->getParam("to")->value().toInt() : now;
+    uint32_t from = request->hasParam("from") ? request->getParam("from")->value().toInt() : getDefaultFrom(to);
+    uint32_t points = request->hasParam("points") ? request->getParam("points")->value().toInt() : HISTORY_DEFAULT_POINTS;
+
+    if (from >= to) {
+        from = getDefaultFrom(to);
+    }
+    points = std::clamp<uint32_t>(points, 1, HISTORY_MAX_POINTS);
+
+    // Never use intervals smaller than the recording resolution
+    const uint32_t interval = std::max<uint32_t>((to - from + points - 1) / points, 60);
+    points = std::max<uint32_t>((to - from + interval - 1) / interval, 1);
+
+    const auto series = History.getSeries(serial);
+
+    // Each series is rendered by its own pass over the recorded blocks. Only the buckets of one series are in memory at a time.
+    WebApi.sendChunkedResponse(request, asyncsrv::T_application_json, [serial, from, to, points, interval, series](Print& out, const size_t part) -> bool {
+        if (part == 0) {
+            char serialString[sizeof(uint64_t) * 8 + 1];
+            snprintf(serialString, sizeof(serialString), "%0" PRIx32 "%08" PRIx32,
+                static_cast<uint32_t>((serial >> 32) & 0xFFFFFFFF),
+                static_cast<uint32_t>(serial & 0xFFFFFFFF));
+
+            out.printf("{\"serial\":\"%s\",\"from\":%" PRIu32 ",\"to\":%" PRIu32 ",\"interval\":%" PRIu32 ",\"series\":[",
+                serialString, from, to, interval);
+            return true;
+        }
+
+        const size_t idx = part - 1;
+        if (idx >= series.size()) {
+            out.print("]}");
+            return false;
+        }
+
+        struct Bucket_t {
+            float min;
+            float max;
+            float sum;
+            uint16_t count;
+        };
+        std::vector<Bucket_t> buckets(points, { 0, 0, 0, 0 });
+
+        const auto& current = series[idx];
+        History.forEachSample(serial, from, to, [&](const uint32_t timestamp, const uint8_t seriesCount, const HistorySeries_t* sampleSeries, const float* values) {
+            for (uint8_t s = 0; s < seriesCount; s++) {
+                if (sampleSeries[s].type != current.type || sampleSeries[s].channel != current.channel || sampleSeries[s].field != current.field) {
+                    continue;
+                }
+
+                auto& bucket = buckets[std::min<uint32_t>((timestamp - from) / interval, points - 1)];
+                if (bucket.count == 0 || values[s] < bucket.min) {
+                    bucket.min = values[s];
+                }
+                if (bucket.count == 0 || values[s] > bucket.max) {
+                    bucket.max = values[s];
+                }
+                bucket.sum += values[s];
+                bucket.count++;
+                break;
+            }
+        });
+
+        JsonDocument doc;
+        doc["type"] = channelsTypes[current.type];
+        doc["channel"] = current.channel;
+        doc["field"] = fields[current.field];
+        doc["unit"] = units[current.field == FLD_T ? UNIT_C : (current.field == FLD_UAC || current.field == FLD_UDC ? UNIT_V : UNIT_W)];
+
+        auto timeArray = doc["t"].to<JsonArray>();
+        auto minArray = doc["min"].to<JsonArray>();
+        auto maxArray = doc["max"].to<JsonArray>();
+        auto avgArray = doc["avg"].to<JsonArray>();
+        for (uint32_t b = 0; b < points; b++) {
+            if (buckets[b].count == 0) {
+                continue;
+            }
+            timeArray.add(from + b * interval);
+            minArray.add(buckets[b].min);
+            maxArray.add(buckets[b].max);
+            avgArray.add(serialized(String(buckets[b].sum / buckets[b].count, 1)));
+        }
+
+        if (idx > 0) {
+            out.print(',');
+        }
+        serializeJson(doc, out);
+        return true;
+    });
+}
+
+/// @brief Exports all recorded samples as CSV, InfluxDB line protocol or newline delimited JSON.
+/// Parameters: inv (serial, omit for all inverters), from and to (epoch seconds), format (csv, line, ndjson), gzip (0 to disable).
+/// Every response part renders the next HISTORY_EXPORT_SAMPLES samples from a history cursor, so memory usage does not
+/// depend on the length of the range and every stored block is read only once.
+void WebApiHistoryClass::onHistoryExport(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    std::vector<uint64_t> serials;
+    if (request->hasParam("inv")) {
+        serials.push_back(WebApi.parseSerialFromRequest(request));
+    } else {
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv != nullptr) {
+                serials.push_back(inv->serial());
+            }
+        }
+    }
+
+    const uint32_t to = request->hasParam("to") ? request->getParam("to")->value().toInt() : time(nullptr);
+    const uint32_t from = request->hasParam("from") ? request->getParam("from")->value().toInt() : getDefaultFrom(to);
+
+    ExportFormat_t format = EXPORT_CSV;
+    const char* contentType = "text/csv";
+    if (request->hasParam("format")) {
+        const String value = request->getParam("format")->value();
+        if (value == "line") {
+            format = EXPORT_LINE_PROTOCOL;
+            contentType = asyncsrv::T_text_plain;
+        } else if (value == "ndjson") {
+            format = EXPORT_NDJSON;
+            contentType = "application/x-ndjson";
+        }
+    }
+
+    const bool gzip = (!request->hasParam("gzip") || request->getParam("gzip")->value() != "0")
+        && WebApi.acceptsEncoding(request, asyncsrv::T_gzip);
+
+    size_t inverterIdx = 0;
+    HistoryCursor_t cursor;
+
+    WebApi.sendChunkedResponse(request, contentType, [serials, from, to, format, inverterIdx, cursor](Print& out, const size_t part) mutable -> bool {
+        if (part == 0 && format == EXPORT_CSV) {
+            out.print("timestamp,serial,type,channel,field,value\n");
+        }
+
+        if (cursor.finished) {
+            if (inverterIdx >= serials.size()) {
+                return false;
+            }
+            History.openCursor(serials[inverterIdx++], from, to, cursor);
+        }
+
+        char serialString[sizeof(uint64_t) * 8 + 1];
+        snprintf(serialString, sizeof(serialString), "%0" PRIx32 "%08" PRIx32,
+            static_cast<uint32_t>((cursor.serial >> 32) & 0xFFFFFFFF),
+            static_cast<uint32_t>(cursor.serial & 0xFFFFFFFF));
+
+        History.readCursor(cursor, HISTORY_EXPORT_SAMPLES, [&](const uint32_t timestamp, const uint8_t seriesCount, const HistorySeries_t* series, const float* values) {
+            printSample(out, format, serialString, timestamp, seriesCount, series, values);
+        });
+        return true;
+    }, gzip);
+}
+
+void WebApiHistoryClass::printSample(Print& out, const ExportFormat_t format, const char* serial, const uint32_t timestamp, const uint8_t seriesCount, const HistorySeries_t* series, const float* values)
+{
+    if (format == EXPORT_CSV) {
+        for (uint8_t s = 0; s < seriesCount; s++) {
+            out.printf("%" PRIu32 ",%s,%s,%" PRIu8 ",%s,%.1f\n",
+                timestamp, serial, channelsTypes[series[s].type], series[s].channel, fields[series[s].field], values[s]);
+        }
+        return;
+    }
+
+    // One line per channel containing all fields of this channel. The series of a channel are always consecutive.
+    for (uint8_t s = 0; s < seriesCount; s++) {
+        const bool first = s == 0 || series[s].type != series[s - 1].type || series[s].channel != series[s - 1].channel;
+        const bool last = s == seriesCount - 1 || series[s].type != series[s + 1].type || series[s].channel != series[s + 1].channel;
+
+        if (format == EXPORT_LINE_PROTOCOL) {
+            if (first) {
+                out.printf("opendtu,serial=%s,type=%s,channel=%" PRIu8 " ", serial, channelsTypes[series[s].type], series[s].channel);
+            }
+            out.printf("%s%s=%.1f", first ? "" : ",", fields[series[s].field], values[s]);
+            if (last) {
+                out.printf(" %" PRIu32 "\n", timestamp);
+            }
+        } else {
+            if (first) {
+                out.printf("{\"t\":%" PRIu32 ",\"serial\":\"%s\",\"type\":\"%s\",\"channel\":%" PRIu8,
+                    timestamp, serial, channelsTypes[series[s].type], series[s].channel);
+            }
+            out.printf(",\"%s\":%.1f", fields[series[s].field], values[s]);
+            if (last) {
+                out.print("}\n");
+            }
+        }
+    }
+}
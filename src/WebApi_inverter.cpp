@@ -4,7 +4,7 @@
  */
 #include "WebApi_inverter.h"
 #include "Configuration.h"
-#include "MqttHandleHass.h"
+#include "Utils.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include "defaults.h"
@@ -30,56 +30,82 @@ void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    JsonArray data = root["inverter"].to<JsonArray>();
-
-    const CONFIG_T& config = Configuration.get();
-
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial > 0) {
-            JsonObject obj = data.add<JsonObject>();
-            obj["id"] = i;
-            obj["name"] = String(config.Inverter[i].Name);
-            obj["order"] = config.Inverter[i].Order;
-
-            // Inverter Serial is read as HEX
-            char buffer[sizeof(uint64_t) * 8 + 1];
-            snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
-                static_cast<uint32_t>((config.Inverter[i].Serial >> 32) & 0xFFFFFFFF),
-                static_cast<uint32_t>(config.Inverter[i].Serial & 0xFFFFFFFF));
-            obj["serial"] = buffer;
-            obj["poll_enable"] = config.Inverter[i].Poll_Enable;
-            obj["poll_enable_night"] = config.Inverter[i].Poll_Enable_Night;
-            obj["command_enable"] = config.Inverter[i].Command_Enable;
-            obj["command_enable_night"] = config.Inverter[i].Command_Enable_Night;
-            obj["reachable_threshold"] = config.Inverter[i].ReachableThreshold;
-            obj["zero_runtime"] = config.Inverter[i].ZeroRuntimeDataIfUnrechable;
-            obj["zero_day"] = config.Inverter[i].ZeroYieldDayOnMidnight;
-            obj["clear_eventlog"] = config.Inverter[i].ClearEventlogOnMidnight;
-            obj["yieldday_correction"] = config.Inverter[i].YieldDayCorrection;
-
-            auto inv = Hoymiles.getInverterBySerial(config.Inverter[i].Serial);
-            uint8_t max_channels;
-            if (inv == nullptr) {
-                obj["type"] = "Unknown";
-                max_channels = INV_MAX_CHAN_COUNT;
-            } else {
-                obj["type"] = inv->typeName();
-                max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
-            }
+    // Render one inverter per chunk instead of building the whole list in memory
+    WebApi.sendChunkedResponse(request, asyncsrv::T_application_json, [firstInverter = true](Print& out, const size_t part) mutable -> bool {
+        if (part == 0) {
+            out.print("{\"inverter\":[");
+            return true;
+        }
 
-            JsonArray channel = obj["channel"].to<JsonArray>();
-            for (uint8_t c = 0; c < max_channels; c++) {
-                JsonObject chanData = channel.add<JsonObject>();
-                chanData["name"] = config.Inverter[i].channel[c].Name;
-                chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
-                chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
-            }
+        const uint8_t i = part - 1;
+        if (i >= INV_MAX_COUNT) {
+            out.print("]}");
+            return false;
+        }
+
+        if (Configuration.get()->Inverter[i].Serial == 0) {
+            return true;
         }
+
+        JsonDocument doc;
+        auto obj = doc.to<JsonObject>();
+        generateInverterJsonResponse(obj, i);
+
+        if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+            throw std::bad_alloc();
+        }
+
+        if (!firstInverter) {
+            out.print(',');
+        }
+        firstInverter = false;
+        serializeJson(doc, out);
+        return true;
+    });
+}
+
+void WebApiInverterClass::generateInverterJsonResponse(JsonObject& obj, const uint8_t id)
+{
+    const auto config = Configuration.get();
+    const INVERTER_CONFIG_T& inv_cfg = config->Inverter[id];
+
+    obj["id"] = id;
+    obj["name"] = String(inv_cfg.Name);
+    obj["order"] = inv_cfg.Order;
+
+    // Inverter Serial is read as HEX
+    char buffer[sizeof(uint64_t) * 8 + 1];
+    snprintf(buffer, sizeof(buffer), "%0" PRIx32 "%08" PRIx32,
+        static_cast<uint32_t>((inv_cfg.Serial >> 32) & 0xFFFFFFFF),
+        static_cast<uint32_t>(inv_cfg.Serial & 0xFFFFFFFF));
+    obj["serial"] = buffer;
+    obj["poll_enable"] = inv_cfg.Poll_Enable;
+    obj["poll_enable_night"] = inv_cfg.Poll_Enable_Night;
+    obj["command_enable"] = inv_cfg.Command_Enable;
+    obj["command_enable_night"] = inv_cfg.Command_Enable_Night;
+    obj["reachable_threshold"] = inv_cfg.ReachableThreshold;
+    obj["zero_runtime"] = inv_cfg.ZeroRuntimeDataIfUnrechable;
+    obj["zero_day"] = inv_cfg.ZeroYieldDayOnMidnight;
+    obj["clear_eventlog"] = inv_cfg.ClearEventlogOnMidnight;
+    obj["yieldday_correction"] = inv_cfg.YieldDayCorrection;
+
+    auto inv = Hoymiles.getInverterBySerial(inv_cfg.Serial);
+    uint8_t max_channels;
+    if (inv == nullptr) {
+        obj["type"] = "Unknown";
+        max_channels = INV_MAX_CHAN_COUNT;
+    } else {
+        obj["type"] = inv->typeName();
+        max_channels = inv->Statistics()->getChannelsByType(TYPE_DC).size();
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    JsonArray channel = obj["channel"].to<JsonArray>();
+    for (uint8_t c = 0; c < max_channels; c++) {
+        JsonObject chanData = channel.add<JsonObject>();
+        chanData["name"] = inv_cfg.channel[c].Name;
+        chanData["max_power"] = inv_cfg.channel[c].MaxChannelPower;
+        chanData["yield_total_offset"] = inv_cfg.channel[c].YieldTotalOffset;
+    }
 }
 
 void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
@@ -122,9 +148,21 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
         return;
     }
 
-    INVERTER_CONFIG_T* inverter = Configuration.getFreeInverterSlot();
+    bool slotFound = false;
+    {
+        auto guard = Configuration.getWriteGuard();
 
-    if (!inverter) {
+        INVERTER_CONFIG_T* inverter = guard.getFreeInverterSlot();
+        if (inverter) {
+            // Interpret the string as a hex value and convert it to uint64_t
+            inverter->Serial = serial;
+
+            strncpy(inverter->Name, root["name"].as<String>().c_str(), INV_MAX_NAME_STRLEN);
+            slotFound = true;
+        }
+    }
+
+    if (!slotFound) {
         retMsg["message"] = "Only " STR_EXTRACT(INV_MAX_COUNT) " inverters are supported!";
         retMsg["code"] = WebApiError::InverterCount;
         retMsg["param"]["max"] = INV_MAX_COUNT;
@@ -132,24 +170,9 @@ void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
         return;
     }
 
-    // Interpret the string as a hex value and convert it to uint64_t
-    inverter->Serial = serial;
-
-    strncpy(inverter->Name, root["name"].as<String>().c_str(), INV_MAX_NAME_STRLEN);
-
     WebApi.writeConfig(retMsg, WebApiError::InverterAdded, "Inverter created!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
-
-    auto inv = Hoymiles.addInverter(inverter->Name, inverter->Serial);
-
-    if (inv != nullptr) {
-        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            inv->Statistics()->setStringMaxPower(c, inverter->channel[c].MaxChannelPower);
-        }
-    }
-
-    MqttHandleHass.forceUpdate();
 }
 
 void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
@@ -209,15 +232,12 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
         return;
     }
 
-    uint64_t old_serial = 0;
-
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
 
         INVERTER_CONFIG_T& inverter = config.Inverter[root["id"].as<uint8_t>()];
 
-        old_serial = inverter.Serial;
         inverter.Serial = new_serial;
         strncpy(inverter.Name, root["name"].as<String>().c_str(), INV_MAX_NAME_STRLEN);
 
@@ -243,37 +263,6 @@ void WebApiInverterClass::onInverterEdit(AsyncWebServerRequest* request)
     WebApi.writeConfig(retMsg, WebApiError::InverterChanged, "Inverter changed!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
-
-    INVERTER_CONFIG_T const& inverter = Configuration.get().Inverter[root["id"].as<uint8_t>()];
-    std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterBySerial(old_serial);
-
-    if (inv != nullptr && new_serial != old_serial) {
-        // Valid inverter exists but serial changed --> remove it and insert new one
-        Hoymiles.removeInverterBySerial(old_serial);
-        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial);
-    } else if (inv != nullptr && new_serial == old_serial) {
-        // Valid inverter exists and serial stays the same --> update name
-        inv->setName(inverter.Name);
-    } else if (inv == nullptr) {
-        // Valid inverter did not exist --> try to create one
-        inv = Hoymiles.addInverter(inverter.Name, inverter.Serial);
-    }
-
-    if (inv != nullptr) {
-        inv->setEnablePolling(inverter.Poll_Enable);
-        inv->setEnableCommands(inverter.Command_Enable);
-        inv->setReachableThreshold(inverter.ReachableThreshold);
-        inv->setZeroValuesIfUnreachable(inverter.ZeroRuntimeDataIfUnrechable);
-        inv->setZeroYieldDayOnMidnight(inverter.ZeroYieldDayOnMidnight);
-        inv->setClearEventlogOnMidnight(inverter.ClearEventlogOnMidnight);
-        inv->Statistics()->setYieldDayCorrection(inverter.YieldDayCorrection);
-        for (uint8_t c = 0; c < INV_MAX_CHAN_COUNT; c++) {
-            inv->Statistics()->setStringMaxPower(c, inverter.channel[c].MaxChannelPower);
-            inv->Statistics()->setChannelFieldOffset(TYPE_DC, static_cast<ChannelNum_t>(c), FLD_YT, inverter.channel[c].YieldTotalOffset);
-        }
-    }
-
-    MqttHandleHass.forceUpdate();
 }
 
 void WebApiInverterClass::onInverterDelete(AsyncWebServerRequest* request)
@@ -304,18 +293,14 @@ void WebApiInverterClass::onInverterDelete(AsyncWebServerRequest* request)
         return;
     }
 
-    uint8_t inverter_id = root["id"].as<uint8_t>();
-    INVERTER_CONFIG_T const& inverter = Configuration.get().Inverter[inverter_id];
-
-    Hoymiles.removeInverterBySerial(inverter.Serial);
-
-    Configuration.deleteInverterById(inverter_id);
+    {
+        auto guard = Configuration.getWriteGuard();
+        guard.deleteInverterById(root["id"].as<uint8_t>());
+    }
 
     WebApi.writeConfig(retMsg, WebApiError::InverterDeleted, "Inverter deleted!");
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
-
-    MqttHandleHass.forceUpdate();
 }
 
 void WebApiInverterClass::onInverterOrder(AsyncWebServerRequest* request)
@@ -33,6 +33,7 @@ void WebApiLimitClass::onLimitStatus(AsyncWebServerRequest* request)
         String serial = inv->serialString();
 
         root[serial]["limit_relative"] = inv->SystemConfigPara()->getLimitPercent();
+        root[serial]["limit_cached"] = inv->SystemConfigPara()->isCached();
         root[serial]["max_power"] = inv->DevInfo()->getMaxPower();
 
         LastCommandSuccess status = inv->SystemConfigPara()->getLastLimitCommandSuccess();
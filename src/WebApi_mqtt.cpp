@@ -4,6 +4,7 @@
  */
 #include "WebApi_mqtt.h"
 #include "Configuration.h"
+#include "MqttBackfill.h"
 #include "MqttHandleHass.h"
 #include "MqttHandleInverter.h"
 #include "MqttSettings.h"
@@ -29,28 +30,56 @@ void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    root["mqtt_enabled"] = config.Mqtt.Enabled;
-    root["mqtt_hostname"] = config.Mqtt.Hostname;
-    root["mqtt_port"] = config.Mqtt.Port;
+    root["mqtt_enabled"] = config->Mqtt.Enabled;
+    root["mqtt_hostname"] = config->Mqtt.Hostname;
+    root["mqtt_port"] = config->Mqtt.Port;
     root["mqtt_clientid"] = MqttSettings.getClientId();
-    root["mqtt_username"] = config.Mqtt.Username;
-    root["mqtt_topic"] = config.Mqtt.Topic;
+    root["mqtt_username"] = config->Mqtt.Username;
+    root["mqtt_topic"] = config->Mqtt.Topic;
     root["mqtt_connected"] = MqttSettings.getConnected();
-    root["mqtt_retain"] = config.Mqtt.Retain;
-    root["mqtt_tls"] = config.Mqtt.Tls.Enabled;
-    root["mqtt_root_ca_cert_info"] = getTlsCertInfo(config.Mqtt.Tls.RootCaCert);
-    root["mqtt_tls_cert_login"] = config.Mqtt.Tls.CertLogin;
-    root["mqtt_client_cert_info"] = getTlsCertInfo(config.Mqtt.Tls.ClientCert);
-    root["mqtt_lwt_topic"] = String(config.Mqtt.Topic) + config.Mqtt.Lwt.Topic;
-    root["mqtt_publish_interval"] = config.Mqtt.PublishInterval;
-    root["mqtt_clean_session"] = config.Mqtt.CleanSession;
-    root["mqtt_hass_enabled"] = config.Mqtt.Hass.Enabled;
-    root["mqtt_hass_expire"] = config.Mqtt.Hass.Expire;
-    root["mqtt_hass_retain"] = config.Mqtt.Hass.Retain;
-    root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
-    root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
+    root["mqtt_retain"] = config->Mqtt.Retain;
+    root["mqtt_tls"] = config->Mqtt.Tls.Enabled;
+    root["mqtt_root_ca_cert_info"] = getTlsCertInfo(config->Mqtt.Tls.RootCaCert);
+    root["mqtt_tls_cert_login"] = config->Mqtt.Tls.CertLogin;
+    root["mqtt_client_cert_info"] = getTlsCertInfo(config->Mqtt.Tls.ClientCert);
+    root["mqtt_lwt_topic"] = String(config->Mqtt.Topic) + config->Mqtt.Lwt.Topic;
+    root["mqtt_publish_interval"] = config->Mqtt.PublishInterval;
+    root["mqtt_publish_on_change"] = config->Mqtt.PublishOnChange;
+    root["mqtt_publish_max_age"] = config->Mqtt.PublishMaxAge;
+    root["mqtt_aggregated"] = config->Mqtt.Aggregated;
+    root["mqtt_clean_session"] = config->Mqtt.CleanSession;
+    root["mqtt_hass_enabled"] = config->Mqtt.Hass.Enabled;
+    root["mqtt_hass_expire"] = config->Mqtt.Hass.Expire;
+    root["mqtt_hass_retain"] = config->Mqtt.Hass.Retain;
+    root["mqtt_hass_topic"] = config->Mqtt.Hass.Topic;
+    root["mqtt_hass_individualpanels"] = config->Mqtt.Hass.IndividualPanels;
+    root["mqtt_publish_count"] = MqttSettings.getPublishCount();
+    root["mqtt_publish_rate"] = MqttSettings.getPublishRate();
+    root["mqtt_publish_suppressed"] = MqttHandleInverter.getSuppressedCount();
+    root["mqtt_publish_duration"] = MqttHandleInverter.getLastLoopDuration();
+
+    const auto outbox = MqttSettings.getOutboxStats();
+    root["mqtt_outbox_messages"] = outbox.Messages;
+    root["mqtt_outbox_bytes"] = outbox.Bytes;
+    root["mqtt_outbox_pending"] = outbox.Pending;
+    root["mqtt_outbox_dropped"] = outbox.Dropped;
+    root["mqtt_outbox_coalesced"] = outbox.Coalesced;
+
+    const auto backfill = MqttBackfill.getStats();
+    root["mqtt_backfill_records"] = backfill.Records;
+    root["mqtt_backfill_capacity"] = backfill.Capacity;
+    root["mqtt_backfill_captured"] = backfill.Captured;
+    root["mqtt_backfill_dropped"] = backfill.Dropped;
+    root["mqtt_backfill_replayed"] = backfill.Replayed;
+
+    const auto discovery = MqttHandleHass.getDiscoveryStats();
+    root["mqtt_hass_discovery_published"] = discovery.Published;
+    root["mqtt_hass_discovery_unchanged"] = discovery.Unchanged;
+    root["mqtt_hass_discovery_bytes"] = discovery.Bytes;
+    root["mqtt_hass_discovery_heap"] = discovery.HeapPeak;
+    root["mqtt_hass_discovery_duration"] = discovery.Duration;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -63,32 +92,35 @@ void WebApiMqttClass::onMqttAdminGet(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
-
-    root["mqtt_enabled"] = config.Mqtt.Enabled;
-    root["mqtt_hostname"] = config.Mqtt.Hostname;
-    root["mqtt_port"] = config.Mqtt.Port;
-    root["mqtt_clientid"] = config.Mqtt.ClientId;
-    root["mqtt_username"] = config.Mqtt.Username;
-    root["mqtt_password"] = config.Mqtt.Password;
-    root["mqtt_topic"] = config.Mqtt.Topic;
-    root["mqtt_retain"] = config.Mqtt.Retain;
-    root["mqtt_tls"] = config.Mqtt.Tls.Enabled;
-    root["mqtt_root_ca_cert"] = config.Mqtt.Tls.RootCaCert;
-    root["mqtt_tls_cert_login"] = config.Mqtt.Tls.CertLogin;
-    root["mqtt_client_cert"] = config.Mqtt.Tls.ClientCert;
-    root["mqtt_client_key"] = config.Mqtt.Tls.ClientKey;
-    root["mqtt_lwt_topic"] = config.Mqtt.Lwt.Topic;
-    root["mqtt_lwt_online"] = config.Mqtt.Lwt.Value_Online;
-    root["mqtt_lwt_offline"] = config.Mqtt.Lwt.Value_Offline;
-    root["mqtt_lwt_qos"] = config.Mqtt.Lwt.Qos;
-    root["mqtt_publish_interval"] = config.Mqtt.PublishInterval;
-    root["mqtt_clean_session"] = config.Mqtt.CleanSession;
-    root["mqtt_hass_enabled"] = config.Mqtt.Hass.Enabled;
-    root["mqtt_hass_expire"] = config.Mqtt.Hass.Expire;
-    root["mqtt_hass_retain"] = config.Mqtt.Hass.Retain;
-    root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
-    root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
+    const auto config = Configuration.get();
+
+    root["mqtt_enabled"] = config->Mqtt.Enabled;
+    root["mqtt_hostname"] = config->Mqtt.Hostname;
+    root["mqtt_port"] = config->Mqtt.Port;
+    root["mqtt_clientid"] = config->Mqtt.ClientId;
+    root["mqtt_username"] = config->Mqtt.Username;
+    root["mqtt_password"] = config->Mqtt.Password;
+    root["mqtt_topic"] = config->Mqtt.Topic;
+    root["mqtt_retain"] = config->Mqtt.Retain;
+    root["mqtt_tls"] = config->Mqtt.Tls.Enabled;
+    root["mqtt_root_ca_cert"] = config->Mqtt.Tls.RootCaCert;
+    root["mqtt_tls_cert_login"] = config->Mqtt.Tls.CertLogin;
+    root["mqtt_client_cert"] = config->Mqtt.Tls.ClientCert;
+    root["mqtt_client_key"] = config->Mqtt.Tls.ClientKey;
+    root["mqtt_lwt_topic"] = config->Mqtt.Lwt.Topic;
+    root["mqtt_lwt_online"] = config->Mqtt.Lwt.Value_Online;
+    root["mqtt_lwt_offline"] = config->Mqtt.Lwt.Value_Offline;
+    root["mqtt_lwt_qos"] = config->Mqtt.Lwt.Qos;
+    root["mqtt_publish_interval"] = config->Mqtt.PublishInterval;
+    root["mqtt_publish_on_change"] = config->Mqtt.PublishOnChange;
+    root["mqtt_publish_max_age"] = config->Mqtt.PublishMaxAge;
+    root["mqtt_aggregated"] = config->Mqtt.Aggregated;
+    root["mqtt_clean_session"] = config->Mqtt.CleanSession;
+    root["mqtt_hass_enabled"] = config->Mqtt.Hass.Enabled;
+    root["mqtt_hass_expire"] = config->Mqtt.Hass.Expire;
+    root["mqtt_hass_retain"] = config->Mqtt.Hass.Retain;
+    root["mqtt_hass_topic"] = config->Mqtt.Hass.Topic;
+    root["mqtt_hass_individualpanels"] = config->Mqtt.Hass.IndividualPanels;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -124,6 +156,9 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             && root["mqtt_lwt_offline"].is<String>()
             && root["mqtt_lwt_qos"].is<uint8_t>()
             && root["mqtt_publish_interval"].is<uint32_t>()
+            && root["mqtt_publish_on_change"].is<bool>()
+            && root["mqtt_publish_max_age"].is<uint32_t>()
+            && root["mqtt_aggregated"].is<bool>()
             && root["mqtt_clean_session"].is<bool>()
             && root["mqtt_hass_enabled"].is<bool>()
             && root["mqtt_hass_expire"].is<bool>()
@@ -253,6 +288,15 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
             return;
         }
 
+        if (root["mqtt_publish_max_age"].as<uint32_t>() < 10 || root["mqtt_publish_max_age"].as<uint32_t>() > 86400) {
+            retMsg["message"] = "Maximum age must be a number between 10 and 86400!";
+            retMsg["code"] = WebApiError::MqttPublishMaxAge;
+            retMsg["param"]["min"] = 10;
+            retMsg["param"]["max"] = 86400;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+
         if (root["mqtt_hass_enabled"].as<bool>()) {
             if (root["mqtt_hass_topic"].as<String>().length() > MQTT_MAX_TOPIC_STRLEN) {
                 retMsg["message"] = "Hass topic must not be longer than " STR_EXTRACT(MQTT_MAX_TOPIC_STRLEN) " characters!";
@@ -278,6 +322,7 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         }
     }
 
+    bool topicChanged = false;
     {
         auto guard = Configuration.getWriteGuard();
         auto& config = guard.getConfig();
@@ -299,6 +344,9 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
         strlcpy(config.Mqtt.Lwt.Value_Offline, root["mqtt_lwt_offline"].as<String>().c_str(), sizeof(config.Mqtt.Lwt.Value_Offline));
         config.Mqtt.Lwt.Qos = root["mqtt_lwt_qos"].as<uint8_t>();
         config.Mqtt.PublishInterval = root["mqtt_publish_interval"].as<uint32_t>();
+        config.Mqtt.PublishOnChange = root["mqtt_publish_on_change"].as<bool>();
+        config.Mqtt.PublishMaxAge = root["mqtt_publish_max_age"].as<uint32_t>();
+        config.Mqtt.Aggregated = root["mqtt_aggregated"].as<bool>();
         config.Mqtt.CleanSession = root["mqtt_clean_session"].as<bool>();
         config.Mqtt.Hass.Enabled = root["mqtt_hass_enabled"].as<bool>();
         config.Mqtt.Hass.Expire = root["mqtt_hass_expire"].as<bool>();
@@ -308,18 +356,22 @@ void WebApiMqttClass::onMqttAdminPost(AsyncWebServerRequest* request)
 
         // Check if base topic was changed
         if (strcmp(config.Mqtt.Topic, root["mqtt_topic"].as<String>().c_str())) {
+            // Still uses the published topic
             MqttHandleInverter.unsubscribeTopics();
             strlcpy(config.Mqtt.Topic, root["mqtt_topic"].as<String>().c_str(), sizeof(config.Mqtt.Topic));
-            MqttHandleInverter.subscribeTopics();
+            topicChanged = true;
         }
     }
 
+    if (topicChanged) {
+        MqttHandleInverter.subscribeTopics();
+    }
+
     WebApi.writeConfig(retMsg);
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
-    MqttSettings.performReconnect();
-    MqttHandleHass.forceUpdate();
+    // MqttSettings and MqttHandleHass apply the changes in the main loop
 }
 
 String WebApiMqttClass::getTlsCertInfo(const char* cert)
@@ -32,11 +32,11 @@ void WebApiNtpClass::onNtpStatus(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    root["ntp_server"] = config.Ntp.Server;
+    root["ntp_server"] = config->Ntp.Server;
     root["ntp_timezone"] = Mycila::NTP.getTimezoneInfo();
-    root["ntp_timezone_descr"] = config.Ntp.TimezoneDescr;
+    root["ntp_timezone_descr"] = config->Ntp.TimezoneDescr;
     root["ntp_status"] = Mycila::NTP.isSynced();
 
     struct tm timeinfo;
@@ -73,13 +73,13 @@ void WebApiNtpClass::onNtpAdminGet(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    root["ntp_server"] = config.Ntp.Server;
-    root["ntp_timezone_descr"] = config.Ntp.TimezoneDescr;
-    root["longitude"] = config.Ntp.Longitude;
-    root["latitude"] = config.Ntp.Latitude;
-    root["sunsettype"] = config.Ntp.SunsetType;
+    root["ntp_server"] = config->Ntp.Server;
+    root["ntp_timezone_descr"] = config->Ntp.TimezoneDescr;
+    root["longitude"] = config->Ntp.Longitude;
+    root["latitude"] = config->Ntp.Latitude;
+    root["sunsettype"] = config->Ntp.SunsetType;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
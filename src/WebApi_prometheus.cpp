@@ -1,189 +1,494 @@
-
 // SPDX-License-Identifier: GPL-2.0-or-later
 /*
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
 #include "WebApi_prometheus.h"
 #include "Configuration.h"
+#include "MqttBackfill.h"
+#include "MqttSettings.h"
 #include "NetworkSettings.h"
 #include "WebApi.h"
 #include "__compiled_constants.h"
 #include <Hoymiles.h>
+#include <algorithm>
+#include <cstring>
+
+// FNV-1a
+static void mixHash(uint32_t& hash, const uint32_t value)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 16777619;
+    }
+}
 
-#undef TAG
-static const char* TAG = "webapi";
+WebApiPrometheusClass::WebApiPrometheusClass()
+    : _cacheTask(PROMETHEUS_CACHE_MAX_AGE, TASK_FOREVER, std::bind(&WebApiPrometheusClass::releaseCache, this))
+{
+}
 
 void WebApiPrometheusClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
     using std::placeholders::_1;
 
     server.on("/api/prometheus/metrics", HTTP_GET, static_cast<ArRequestHandlerFunction>(std::bind(&WebApiPrometheusClass::onPrometheusMetricsGet, this, _1)));
+
+    scheduler.addTask(_cacheTask);
+    _cacheTask.enable();
+
+    buildFamilies();
 }
 
 void WebApiPrometheusClass::onPrometheusMetricsGet(AsyncWebServerRequest* request)
 {
-    static size_t initialResponseBufferSize = 1024;
-
     if (!WebApi.checkCredentialsReadonly(request)) {
         return;
     }
 
-    try {
-        auto stream = request->beginResponseStream("text/plain; charset=utf-8", initialResponseBufferSize);
+    // Optional filters: ?serial=<hex serial> limits the inverter metrics to one inverter,
+    // ?family=<name>[,<name>...] limits the output to the given metric families
+    String serialLabel;
+    const uint64_t serialFilter = WebApi.parseSerialFromRequest(request, "serial");
+    if (serialFilter > 0) {
+        auto inv = Hoymiles.getInverterBySerial(serialFilter);
+        serialLabel = "serial=\"";
+        serialLabel += (inv != nullptr) ? inv->serialString() : "unknown";
+        serialLabel += "\"";
+    }
+
+    std::vector<String> families;
+    if (request->hasParam("family")) {
+        const String& param = request->getParam("family")->value();
+        int start = 0;
+        while (start < static_cast<int>(param.length())) {
+            int end = param.indexOf(',', start);
+            if (end < 0) {
+                end = param.length();
+            }
+            if (end > start) {
+                families.push_back(param.substring(start, end));
+            }
+            start = end + 1;
+        }
+    }
+
+    // Part 0 contains the system metrics which change on every scrape. Every following part
+    // contains one metric family of all inverters. It is assembled from the cached block of
+    // every inverter, which is only rendered again if the data of that inverter changed.
+    // Every family is always present, so the parts of a response stay consistent even if
+    // another request updates the blocks in between.
+    WebApi.sendChunkedResponse(request, "text/plain; charset=utf-8", [this, serialLabel, families](Print& out, const size_t part) -> bool {
+        if (part == 0) {
+            StreamString system;
+            generateSystemMetrics(system);
+            printFiltered(out, system.c_str(), system.length(), families, String());
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
 
-        stream->print("# HELP opendtu_build Build info\n");
-        stream->print("# TYPE opendtu_build gauge\n");
-        stream->printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
-            NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+        if (part == 1) {
+            updateInverterBlocks();
+            _lastScrape = millis();
+        }
 
-        stream->print("# HELP opendtu_platform Platform info\n");
-        stream->print("# TYPE opendtu_platform gauge\n");
-        stream->printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+        const size_t family = part - 1;
+        if (family >= _families.size()) {
+            return false;
+        }
 
-        stream->print("# HELP opendtu_uptime Uptime in seconds\n");
-        stream->print("# TYPE opendtu_uptime counter\n");
-        stream->printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+        printFamily(out, family, families, serialLabel);
+        return true;
+    });
+}
 
-        stream->print("# HELP opendtu_heap_size System memory size\n");
-        stream->print("# TYPE opendtu_heap_size gauge\n");
-        stream->printf("opendtu_heap_size %" PRIu32 "\n", ESP.getHeapSize());
+void WebApiPrometheusClass::generateSystemMetrics(Print& out)
+{
+    out.print("# HELP opendtu_build Build info\n");
+    out.print("# TYPE opendtu_build gauge\n");
+    out.printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
+        NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
 
-        stream->print("# HELP opendtu_free_heap_size System free memory\n");
-        stream->print("# TYPE opendtu_free_heap_size gauge\n");
-        stream->printf("opendtu_free_heap_size %" PRIu32 "\n", ESP.getFreeHeap());
+    out.print("# HELP opendtu_platform Platform info\n");
+    out.print("# TYPE opendtu_platform gauge\n");
+    out.printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
 
-        stream->print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
-        stream->print("# TYPE opendtu_biggest_heap_block gauge\n");
-        stream->printf("opendtu_biggest_heap_block %" PRIu32 "\n", ESP.getMaxAllocHeap());
+    out.print("# HELP opendtu_uptime Uptime in seconds\n");
+    out.print("# TYPE opendtu_uptime counter\n");
+    out.printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
 
-        stream->print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
-        stream->print("# TYPE opendtu_heap_min_free gauge\n");
-        stream->printf("opendtu_heap_min_free %" PRIu32 "\n", ESP.getMinFreeHeap());
+    out.print("# HELP opendtu_heap_size System memory size\n");
+    out.print("# TYPE opendtu_heap_size gauge\n");
+    out.printf("opendtu_heap_size %" PRIu32 "\n", ESP.getHeapSize());
 
-        stream->print("# HELP wifi_rssi WiFi RSSI\n");
-        stream->print("# TYPE wifi_rssi gauge\n");
-        stream->printf("wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+    out.print("# HELP opendtu_free_heap_size System free memory\n");
+    out.print("# TYPE opendtu_free_heap_size gauge\n");
+    out.printf("opendtu_free_heap_size %" PRIu32 "\n", ESP.getFreeHeap());
 
-        stream->print("# HELP wifi_station WiFi Station info\n");
-        stream->print("# TYPE wifi_station gauge\n");
-        stream->printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+    out.print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
+    out.print("# TYPE opendtu_biggest_heap_block gauge\n");
+    out.printf("opendtu_biggest_heap_block %" PRIu32 "\n", ESP.getMaxAllocHeap());
 
-        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-            auto inv = Hoymiles.getInverterByPos(i);
+    out.print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
+    out.print("# TYPE opendtu_heap_min_free gauge\n");
+    out.printf("opendtu_heap_min_free %" PRIu32 "\n", ESP.getMinFreeHeap());
 
-            String serial = inv->serialString();
-            const char* name = inv->name();
-            if (i == 0) {
-                stream->print("# HELP opendtu_last_update last update from inverter in s\n");
-                stream->print("# TYPE opendtu_last_update gauge\n");
-            }
-            stream->printf("opendtu_last_update{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\"} %" PRIu32 "\n",
-                serial.c_str(), i, name, inv->Statistics()->getLastUpdate() / 1000);
+    out.print("# HELP wifi_rssi WiFi RSSI\n");
+    out.print("# TYPE wifi_rssi gauge\n");
+    out.printf("wifi_rssi %" PRId8 "\n", WiFi.RSSI());
+
+    out.print("# HELP wifi_station WiFi Station info\n");
+    out.print("# TYPE wifi_station gauge\n");
+    out.printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+
+    const auto outbox = MqttSettings.getOutboxStats();
+
+    out.print("# HELP opendtu_mqtt_outbox_messages MQTT messages waiting in the outbox\n");
+    out.print("# TYPE opendtu_mqtt_outbox_messages gauge\n");
+    out.printf("opendtu_mqtt_outbox_messages %zu\n", outbox.Messages);
+
+    out.print("# HELP opendtu_mqtt_outbox_bytes Memory used by the MQTT outbox\n");
+    out.print("# TYPE opendtu_mqtt_outbox_bytes gauge\n");
+    out.printf("opendtu_mqtt_outbox_bytes %zu\n", outbox.Bytes);
+
+    out.print("# HELP opendtu_mqtt_outbox_pending MQTT messages passed to the client but not yet sent or acknowledged\n");
+    out.print("# TYPE opendtu_mqtt_outbox_pending gauge\n");
+    out.printf("opendtu_mqtt_outbox_pending %zu\n", outbox.Pending);
+
+    out.print("# HELP opendtu_mqtt_outbox_dropped MQTT messages dropped because the outbox was full\n");
+    out.print("# TYPE opendtu_mqtt_outbox_dropped counter\n");
+    out.printf("opendtu_mqtt_outbox_dropped %" PRIu32 "\n", outbox.Dropped);
+
+    out.print("# HELP opendtu_mqtt_outbox_coalesced MQTT messages replaced by a newer payload of the same topic\n");
+    out.print("# TYPE opendtu_mqtt_outbox_coalesced counter\n");
+    out.printf("opendtu_mqtt_outbox_coalesced %" PRIu32 "\n", outbox.Coalesced);
+
+    const auto backfill = MqttBackfill.getStats();
 
-            if (i == 0) {
-                stream->print("# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n");
-                stream->print("# TYPE opendtu_inverter_limit_relative gauge\n");
+    out.print("# HELP opendtu_mqtt_backfill_records Measurements captured during a broker outage waiting for the replay\n");
+    out.print("# TYPE opendtu_mqtt_backfill_records gauge\n");
+    out.printf("opendtu_mqtt_backfill_records %zu\n", backfill.Records);
+
+    out.print("# HELP opendtu_mqtt_backfill_capacity Maximum number of measurements kept during a broker outage\n");
+    out.print("# TYPE opendtu_mqtt_backfill_capacity gauge\n");
+    out.printf("opendtu_mqtt_backfill_capacity %zu\n", backfill.Capacity);
+
+    out.print("# HELP opendtu_mqtt_backfill_captured Measurements captured during broker outages\n");
+    out.print("# TYPE opendtu_mqtt_backfill_captured counter\n");
+    out.printf("opendtu_mqtt_backfill_captured %" PRIu32 "\n", backfill.Captured);
+
+    out.print("# HELP opendtu_mqtt_backfill_dropped Measurements overwritten because the backfill buffer was full\n");
+    out.print("# TYPE opendtu_mqtt_backfill_dropped counter\n");
+    out.printf("opendtu_mqtt_backfill_dropped %" PRIu32 "\n", backfill.Dropped);
+
+    out.print("# HELP opendtu_mqtt_backfill_replayed Measurements published to the backfill topic after a broker outage\n");
+    out.print("# TYPE opendtu_mqtt_backfill_replayed counter\n");
+    out.printf("opendtu_mqtt_backfill_replayed %" PRIu32 "\n", backfill.Replayed);
+}
+
+void WebApiPrometheusClass::buildFamilies()
+{
+    _families = {
+        { "opendtu_last_update", "last update from inverter in s", "gauge", nullptr },
+        { "opendtu_inverter_limit_relative", "current relative limit of the inverter", "gauge", nullptr },
+        { "opendtu_inverter_limit_absolute", "current absolute limit of the inverter", "gauge", nullptr },
+        { "opendtu_PanelInfo", "panel information", "gauge", nullptr },
+        { "opendtu_MaxPower", "panel maximum output power", "gauge", nullptr },
+        { "opendtu_YieldTotalOffset", "panel yield offset (for used inverters)", "gauge", nullptr },
+    };
+
+    // Fields of different channel types share a family if they have the same name (e.g. Power of AC and DC).
+    // The DC power of the inverter channel is published separately from the power of the channels.
+    auto addFamily = [this](const char* field, const MetricType_t type) {
+        for (size_t f = FIELD_FAMILIES; f < _families.size(); f++) {
+            if (strcmp(_families[f].Field, field) == 0) {
+                return;
             }
-            stream->printf("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\"} %f\n",
-                serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+        }
+        _families.push_back({ String("opendtu_") + field, nullptr, _metricTypes[type], field });
+    };
+    for (auto& publishField : _publishFields) {
+        addFamily(fields[publishField.field], publishField.type);
+        if (publishField.field == FLD_PDC) {
+            addFamily("PowerDC", publishField.type);
+        }
+    }
+}
+
+uint32_t WebApiPrometheusClass::getInverterSignature(std::shared_ptr<InverterAbstract> inv, const uint8_t position) const
+{
+    // Everything the block of the inverter depends on. The values are hashed instead of the
+    // update timestamps, so a poll returning the same values keeps the block.
+    uint32_t hash = 2166136261;
+    mixHash(hash, position);
+    mixHash(hash, static_cast<uint32_t>(inv->serial()));
+    mixHash(hash, Configuration.getRevision());
+    for (const char* c = inv->name(); *c != '\0'; c++) {
+        mixHash(hash, *c);
+    }
+
+    auto mixFloat = [&hash](const float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        mixHash(hash, bits);
+    };
+    mixFloat(inv->SystemConfigPara()->getLimitPercent());
+    mixHash(hash, inv->DevInfo()->getMaxPower());
 
-            if (inv->DevInfo()->getMaxPower() > 0) {
-                if (i == 0) {
-                    stream->print("# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n");
-                    stream->print("# TYPE opendtu_inverter_limit_absolute gauge\n");
+    auto statistics = inv->Statistics();
+    mixHash(hash, statistics->getLastUpdate() > 0);
+    for (auto& t : statistics->getChannelTypes()) {
+        for (auto& c : statistics->getChannelsByType(t)) {
+            for (auto& publishField : _publishFields) {
+                if (statistics->hasChannelFieldValue(t, c, publishField.field)) {
+                    mixFloat(statistics->getChannelFieldValue(t, c, publishField.field));
                 }
-                stream->printf("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\"} %f\n",
-                    serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
             }
+        }
+    }
+
+    return hash;
+}
+
+String WebApiPrometheusClass::getLabels(std::shared_ptr<InverterAbstract> inv, const uint8_t position)
+{
+    // The serial, unit and name label set is shared by all samples of an inverter
+    String labels = "serial=\"";
+    labels += inv->serialString();
+    labels += "\",unit=\"";
+    labels += position;
+    labels += "\",name=\"";
+    labels += inv->name();
+    labels += "\"";
+    return labels;
+}
+
+void WebApiPrometheusClass::updateInverterBlocks()
+{
+    const uint8_t count = Hoymiles.getNumInverters();
+    _blocks.resize(count);
+
+    for (uint8_t i = 0; i < count; i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            _blocks[i] = InverterBlock_t();
+            continue;
+        }
+
+        const uint32_t signature = getInverterSignature(inv, i);
+        if (_blocks[i].Serial == inv->serial() && _blocks[i].Signature == signature) {
+            continue;
+        }
+
+        renderBlock(_blocks[i], inv, i, signature);
+    }
+}
 
-            // Loop all channels if Statistics have been updated at least once since DTU boot
-            if (inv->Statistics()->getLastUpdate() > 0) {
-                for (auto& t : inv->Statistics()->getChannelTypes()) {
-                    for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                        addPanelInfo(stream, serial, i, inv, t, c);
-                        for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
-                            if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
-                            } else {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
-                            }
-                        }
+void WebApiPrometheusClass::renderBlock(InverterBlock_t& block, std::shared_ptr<InverterAbstract> inv, const uint8_t position, const uint32_t signature)
+{
+    block.Serial = inv->serial();
+    block.Position = position;
+    block.Signature = signature;
+    block.Text.remove(0);
+    block.Offsets.clear();
+
+    for (size_t f = 0; f < _families.size(); f++) {
+        block.Offsets.push_back(block.Text.length());
+        if (f != LAST_UPDATE) {
+            renderFamily(block.Text, inv, position, f);
+        }
+    }
+    block.Offsets.push_back(block.Text.length());
+
+    // Inverters with many channels are rendered per family on every scrape instead
+    block.Valid = block.Text.length() <= PROMETHEUS_INVERTER_CACHE_MAX_SIZE;
+    if (!block.Valid) {
+        block.Text = StreamString();
+        block.Offsets.clear();
+        block.Offsets.shrink_to_fit();
+    }
+}
+
+void WebApiPrometheusClass::printFamily(Print& out, const size_t family, const std::vector<String>& families, const String& serialLabel)
+{
+    const Family_t& f = _families[family];
+
+    if (!families.empty() && std::find(families.begin(), families.end(), f.Name) == families.end()) {
+        return;
+    }
+
+    out.printf("# HELP %s ", f.Name.c_str());
+    if (f.Help != nullptr) {
+        out.print(f.Help);
+    } else {
+        const char* unit = getFieldUnit(f.Field);
+        if (unit != nullptr) {
+            out.printf("in %s", unit);
+        } else {
+            out.print(f.Field);
+        }
+    }
+    out.printf("\n# TYPE %s %s\n", f.Name.c_str(), f.Type);
+
+    for (auto& block : _blocks) {
+        if (block.Valid && family != LAST_UPDATE) {
+            const size_t begin = block.Offsets[family];
+            printFiltered(out, block.Text.c_str() + begin, block.Offsets[family + 1] - begin, families, serialLabel);
+            continue;
+        }
+
+        auto inv = Hoymiles.getInverterBySerial(block.Serial);
+        if (inv == nullptr) {
+            continue;
+        }
+        StreamString samples;
+        renderFamily(samples, inv, block.Position, family);
+        printFiltered(out, samples.c_str(), samples.length(), families, serialLabel);
+    }
+}
+
+const char* WebApiPrometheusClass::getFieldUnit(const char* family) const
+{
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr || inv->Statistics()->getLastUpdate() == 0) {
+            continue;
+        }
+        auto statistics = inv->Statistics();
+        for (auto& t : statistics->getChannelTypes()) {
+            for (auto& c : statistics->getChannelsByType(t)) {
+                for (auto& publishField : _publishFields) {
+                    const char* name = (t == TYPE_INV && publishField.field == FLD_PDC) ? "PowerDC" : fields[publishField.field];
+                    if (strcmp(name, family) == 0 && statistics->hasChannelFieldValue(t, c, publishField.field)) {
+                        return statistics->getChannelFieldUnit(t, c, publishField.field);
                     }
                 }
             }
         }
-        stream->addHeader(asyncsrv::T_Cache_Control, asyncsrv::T_no_cache);
-        if (stream->available() > initialResponseBufferSize) {
-            initialResponseBufferSize = stream->available();
-            ESP_LOGI(TAG, "Increased /api/prometheus/metrics initialResponseBufferSize to %" PRIu32 " bytes", initialResponseBufferSize);
-        }
-        request->send(stream);
+    }
+    return nullptr;
+}
 
-    } catch (std::bad_alloc& bad_alloc) {
-        ESP_LOGE(TAG, "Call to /api/prometheus/metrics temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
+void WebApiPrometheusClass::releaseCache()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
 
-        WebApi.sendTooManyRequests(request);
+    // Don't keep the blocks for scrapers which are gone
+    if (_blocks.empty() || millis() - _lastScrape < PROMETHEUS_CACHE_MAX_AGE) {
+        return;
     }
+
+    _blocks.clear();
+    _blocks.shrink_to_fit();
 }
 
-void WebApiPrometheusClass::addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
+void WebApiPrometheusClass::renderFamily(Print& out, std::shared_ptr<InverterAbstract> inv, const uint8_t position, const size_t family)
 {
-    if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
-        const char* chanName = (channelName == nullptr) ? inv->Statistics()->getChannelFieldName(type, channel, fieldId) : channelName;
-        if (idx == 0 && type == TYPE_AC && channel == 0) {
-            stream->printf("# HELP opendtu_%s in %s\n", chanName, inv->Statistics()->getChannelFieldUnit(type, channel, fieldId));
-            stream->printf("# TYPE opendtu_%s %s\n", chanName, metricName);
-        }
-        stream->printf("opendtu_%s{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
-            chanName,
-            serial.c_str(),
-            idx,
-            inv->name(),
-            inv->Statistics()->getChannelTypeName(type),
-            channel,
-            inv->Statistics()->getChannelFieldValueString(type, channel, fieldId).c_str());
+    const String labels = getLabels(inv, position);
+    auto statistics = inv->Statistics();
+
+    switch (family) {
+    case LAST_UPDATE:
+        out.printf("opendtu_last_update{%s} %" PRIu32 "\n", labels.c_str(), statistics->getLastUpdate() / 1000);
+        return;
+
+    case LIMIT_RELATIVE:
+        out.printf("opendtu_inverter_limit_relative{%s} %f\n", labels.c_str(), inv->SystemConfigPara()->getLimitPercent() / 100.0);
+        return;
+
+    case LIMIT_ABSOLUTE:
+        if (inv->DevInfo()->getMaxPower() > 0) {
+            out.printf("opendtu_inverter_limit_absolute{%s} %f\n",
+                labels.c_str(), inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
+        }
+        return;
+
+    default:
+        break;
+    }
+
+    // Channels are only listed if the statistics have been updated at least once since DTU boot
+    if (statistics->getLastUpdate() == 0) {
+        return;
+    }
+
+    if (family < FIELD_FAMILIES) {
+        const auto config = Configuration.getInverterConfig(*inv);
+        if (config == nullptr) {
+            return;
+        }
+        for (auto& c : statistics->getChannelsByType(TYPE_DC)) {
+            if (family == PANEL_INFO) {
+                out.printf("opendtu_PanelInfo{%s,channel=\"%" PRIu8 "\",panelname=\"%s\"} 1\n", labels.c_str(), c, config->channel[c].Name);
+            } else if (family == MAX_POWER) {
+                out.printf("opendtu_MaxPower{%s,channel=\"%" PRIu8 "\"} %" PRIu16 "\n", labels.c_str(), c, config->channel[c].MaxChannelPower);
+            } else {
+                out.printf("opendtu_YieldTotalOffset{%s,channel=\"%" PRIu8 "\"} %f\n", labels.c_str(), c, config->channel[c].YieldTotalOffset);
+            }
+        }
+        return;
+    }
+
+    const Family_t& f = _families[family];
+    for (auto& t : statistics->getChannelTypes()) {
+        for (auto& c : statistics->getChannelsByType(t)) {
+            for (auto& publishField : _publishFields) {
+                // The DC power of the inverter channel is published separately from the power of the channels
+                const char* name = (t == TYPE_INV && publishField.field == FLD_PDC) ? "PowerDC" : fields[publishField.field];
+                if (strcmp(name, f.Field) != 0 || !statistics->hasChannelFieldValue(t, c, publishField.field)) {
+                    continue;
+                }
+
+                out.printf("%s{%s,type=\"%s\",channel=\"%d\"} %.*f\n",
+                    f.Name.c_str(),
+                    labels.c_str(),
+                    statistics->getChannelTypeName(t),
+                    c,
+                    statistics->getChannelFieldDigits(t, c, publishField.field),
+                    statistics->getChannelFieldValue(t, c, publishField.field));
+            }
+        }
     }
 }
 
-void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
+void WebApiPrometheusClass::printFiltered(Print& out, const char* text, const size_t length, const std::vector<String>& families, const String& serialLabel)
 {
-    if (type != TYPE_DC) {
+    if (families.empty() && serialLabel.isEmpty()) {
+        out.write(reinterpret_cast<const uint8_t*>(text), length);
         return;
     }
 
-    const auto& config = Configuration.getInverterConfig(inv->serial());
-
-    const bool printHelp = (idx == 0 && channel == 0);
-    if (printHelp) {
-        stream->print("# HELP opendtu_PanelInfo panel information\n");
-        stream->print("# TYPE opendtu_PanelInfo gauge\n");
-    }
-    stream->printf("opendtu_PanelInfo{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\",channel=\"%" PRIu8 "\",panelname=\"%s\"} 1\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].Name);
-
-    if (printHelp) {
-        stream->print("# HELP opendtu_MaxPower panel maximum output power\n");
-        stream->print("# TYPE opendtu_MaxPower gauge\n");
-    }
-    stream->printf("opendtu_MaxPower{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\",channel=\"%" PRIu8 "\"} %" PRIu16 "\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].MaxChannelPower);
-
-    if (printHelp) {
-        stream->print("# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n");
-        stream->print("# TYPE opendtu_YieldTotalOffset gauge\n");
-    }
-    stream->printf("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%" PRIu8 "\",name=\"%s\",channel=\"%" PRIu16 "\"} %f\n",
-        serial.c_str(),
-        idx,
-        inv->name(),
-        channel,
-        config->channel[channel].YieldTotalOffset);
+    const char* line = text;
+    const char* end = text + length;
+    while (line < end) {
+        const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+        const size_t lineLen = (eol == nullptr) ? end - line : eol - line + 1;
+
+        // Metric name is either the third token of a comment or everything up to the labels/value
+        const char* name = line;
+        const bool comment = strncmp(line, "# HELP ", 7) == 0 || strncmp(line, "# TYPE ", 7) == 0;
+        if (comment) {
+            name += 7;
+        }
+        const size_t nameLen = strcspn(name, "{ \n");
+
+        bool match = families.empty();
+        for (auto& family : families) {
+            if (family.length() == nameLen && strncmp(family.c_str(), name, nameLen) == 0) {
+                match = true;
+                break;
+            }
+        }
+
+        // Inverter samples start their label set with the serial
+        if (match && !comment && !serialLabel.isEmpty()) {
+            match = name[nameLen] == '{' && strncmp(name + nameLen + 1, serialLabel.c_str(), serialLabel.length()) == 0;
+        }
+
+        if (match) {
+            out.write(reinterpret_cast<const uint8_t*>(line), lineLen);
+        }
+
+        line += lineLen;
+    }
 }
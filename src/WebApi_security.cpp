@@ -26,10 +26,10 @@ void WebApiSecurityClass::onSecurityGet(AsyncWebServerRequest* request)
 
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
-    const CONFIG_T& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    root["password"] = config.Security.Password;
-    root["allow_readonly"] = config.Security.AllowReadonly;
+    root["password"] = config->Security.Password;
+    root["allow_readonly"] = config->Security.AllowReadonly;
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
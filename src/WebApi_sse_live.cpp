@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2026 Thomas Basler and others
+ */
+
+/*
+Server-Sent Events variant of the live websocket. Every update of an inverter is sent
+as an "inverter" event, followed by a "total" event containing the totals and hints.
+The payloads are generated by the same functions as the websocket messages.
+
+All events carry an increasing id. A client reconnecting with a Last-Event-ID header
+only receives the inverters which have been updated since that event. Ids of a previous
+boot are recognized by their epoch, such clients receive all inverters.
+*/
+#include "WebApi_sse_live.h"
+#include "Utils.h"
+#include "WebApi.h"
+#include "WebApi_ws_live.h"
+#include "defaults.h"
+
+#undef TAG
+static const char* TAG = "webapi";
+
+WebApiSseLiveClass::WebApiSseLiveClass()
+    : _events("/api/livedata/events")
+    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiSseLiveClass::sendDataTaskCb, this))
+{
+}
+
+void WebApiSseLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    startEpoch();
+
+    _events.onConnect(std::bind(&WebApiSseLiveClass::onConnect, this, _1));
+    _events.onDisconnect(std::bind(&WebApiSseLiveClass::onDisconnect, this, _1));
+
+    // Reject new streams early if the maximum number of concurrent streams is reached
+    _events.addMiddleware([this](AsyncWebServerRequest* request, ArMiddlewareNext next) {
+        if (_events.count() >= SSE_LIVE_MAX_CLIENTS) {
+            WebApi.sendTooManyRequests(request);
+            return;
+        }
+        next();
+    });
+
+    server.addHandler(&_events);
+
+    scheduler.addTask(_sendDataTask);
+    _sendDataTask.enable();
+
+    _simpleDigestAuth.setUsername(AUTH_USERNAME);
+    _simpleDigestAuth.setRealm("live events");
+    _simpleDigestAuth.setAuthType(AsyncAuthType::AUTH_DIGEST);
+
+    reload();
+}
+
+void WebApiSseLiveClass::reload()
+{
+    _events.removeMiddleware(&_simpleDigestAuth);
+
+    const auto config = Configuration.get();
+
+    if (config->Security.AllowReadonly) {
+        return;
+    }
+
+    _simpleDigestAuth.setPassword(config->Security.Password);
+    _events.addMiddleware(&_simpleDigestAuth);
+    _events.close();
+}
+
+void WebApiSseLiveClass::onConnect(AsyncEventSourceClient* client)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Ids of another epoch can't be compared with the current ones
+    uint32_t lastId = client->lastId();
+    if ((lastId >> SSE_LIVE_COUNTER_BITS) != _epoch || (lastId & SSE_LIVE_COUNTER_MASK) > _eventCounter) {
+        lastId = 0;
+    }
+
+    ESP_LOGD(TAG, "Events: [%s] connect, last id %" PRIu32 "", _events.url(), lastId);
+
+    try {
+        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+            auto inv = Hoymiles.getInverterByPos(i);
+            if (inv == nullptr || (lastId > 0 && _lastEventId[i] <= lastId)) {
+                continue;
+            }
+
+            client->send(generateInverterEvent(inv).c_str(), "inverter", getEventId(), SSE_LIVE_RECONNECT);
+        }
+
+        client->send(generateTotalEvent().c_str(), "total", getEventId(), SSE_LIVE_RECONNECT);
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Call to /api/livedata/events temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
+    }
+}
+
+void WebApiSseLiveClass::onDisconnect(AsyncEventSourceClient* client)
+{
+    ESP_LOGD(TAG, "Events: [%s] disconnect", _events.url());
+}
+
+void WebApiSseLiveClass::sendDataTaskCb()
+{
+    // do nothing if no client is connected
+    if (_events.count() == 0) {
+        return;
+    }
+
+    bool updated = false;
+
+    // Loop all inverters
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv == nullptr) {
+            continue;
+        }
+
+        const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
+        if (!((lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i]) || (millis() - _lastPublishStats[i] > (10 * 1000)))) {
+            continue;
+        }
+
+        _lastPublishStats[i] = millis();
+
+        try {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _lastEventId[i] = nextEventId();
+            sendToClients(generateInverterEvent(inv), "inverter", _lastEventId[i]);
+            updated = true;
+
+        } catch (const std::bad_alloc& bad_alloc) {
+            ESP_LOGE(TAG, "Call to /api/livedata/events temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
+        }
+    }
+
+    if (!updated) {
+        return;
+    }
+
+    try {
+        std::lock_guard<std::mutex> lock(_mutex);
+        sendToClients(generateTotalEvent(), "total", getEventId());
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Call to /api/livedata/events temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
+    }
+}
+
+void WebApiSseLiveClass::sendToClients(const String& message, const char* event, const uint32_t id)
+{
+    if (message.isEmpty()) {
+        return;
+    }
+
+    // The event source drops messages for clients whose queue is full. As every event contains
+    // the complete state of an inverter, slow clients catch up with the next update.
+    _events.send(message.c_str(), event, id);
+}
+
+uint32_t WebApiSseLiveClass::getEventId() const
+{
+    return (_epoch << SSE_LIVE_COUNTER_BITS) | _eventCounter;
+}
+
+uint32_t WebApiSseLiveClass::nextEventId()
+{
+    if (++_eventCounter > SSE_LIVE_COUNTER_MASK) {
+        startEpoch();
+        _eventCounter = 1;
+    }
+    return getEventId();
+}
+
+void WebApiSseLiveClass::startEpoch()
+{
+    // Never zero, so an event id is never zero either
+    const uint32_t previous = _epoch;
+    do {
+        _epoch = esp_random() >> SSE_LIVE_COUNTER_BITS;
+    } while (_epoch == 0 || _epoch == previous);
+
+    _eventCounter = 0;
+    memset(_lastEventId, 0, sizeof(_lastEventId));
+}
+
+String WebApiSseLiveClass::generateInverterEvent(std::shared_ptr<InverterAbstract> inv)
+{
+    JsonDocument root;
+    auto invObject = root.to<JsonObject>();
+
+    WebApiWsLiveClass::generateInverterCommonJsonResponse(invObject, inv);
+    WebApiWsLiveClass::generateInverterChannelJsonResponse(invObject, inv);
+
+    String buffer;
+    if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        serializeJson(root, buffer);
+    }
+    return buffer;
+}
+
+String WebApiSseLiveClass::generateTotalEvent()
+{
+    JsonDocument root;
+    JsonVariant var = root;
+
+    WebApiWsLiveClass::generateCommonJsonResponse(var);
+
+    String buffer;
+    if (Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+        serializeJson(root, buffer);
+    }
+    return buffer;
+}
@@ -3,7 +3,9 @@
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
 #include "WebApi_sysstatus.h"
+#include "BootProfiler.h"
 #include "Configuration.h"
+#include "InverterSettings.h"
 #include "NetworkSettings.h"
 #include "PinMapping.h"
 #include "WebApi.h"
@@ -75,7 +77,8 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     reason = ResetReason::get_reset_reason_verbose(1);
     root["resetreason_1"] = reason;
 
-    root["cfgsavecount"] = Configuration.get().Cfg.SaveCount;
+    root["cfgsavecount"] = Configuration.getSaveCount();
+    root["cfgwritefailed"] = Configuration.hasWriteFailed();
 
     char version[16];
     snprintf(version, sizeof(version), "%d.%d.%d", CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
@@ -93,5 +96,24 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["cmt_configured"] = PinMapping.isValidCmt2300Config();
     root["cmt_connected"] = Hoymiles.getRadioCmt()->isConnected();
 
+    // All times in ms since boot, 0 if not reached yet
+    auto boot = root["boot"].to<JsonObject>();
+    auto stages = boot["stages"].to<JsonArray>();
+    BootProfiler.visitStages([&stages](const BootProfilerClass::Stage_t& stage) {
+        auto jsonStage = stages.add<JsonObject>();
+        jsonStage["name"] = JsonString(stage.name, true);
+        jsonStage["start"] = stage.start;
+        jsonStage["duration"] = stage.duration;
+    });
+    boot["radio_ready"] = InverterSettings.isRadioReady();
+    boot["web_ready"] = BootProfiler.getWebReadyMillis();
+
+    uint32_t firstRequest = Hoymiles.getRadioNrf()->getFirstRequestMillis();
+    const uint32_t firstRequestCmt = Hoymiles.getRadioCmt()->getFirstRequestMillis();
+    if (firstRequest == 0 || (firstRequestCmt != 0 && firstRequestCmt < firstRequest)) {
+        firstRequest = firstRequestCmt;
+    }
+    boot["first_rf_request"] = firstRequest;
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -3,7 +3,7 @@
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
 #include "WebApi_webapp.h"
-#include <MD5Builder.h>
+#include "WebApi.h"
 #include <__compiled_constants.h>
 
 extern const uint8_t file_index_html_start[] asm("_binary_webapp_dist_index_html_gz_start");
@@ -18,28 +18,57 @@ extern const uint8_t file_favicon_png_end[] asm("_binary_webapp_dist_favicon_png
 extern const uint8_t file_app_js_end[] asm("_binary_webapp_dist_js_app_js_gz_end");
 extern const uint8_t file_site_webmanifest_end[] asm("_binary_webapp_dist_site_webmanifest_end");
 
-void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String& contentType, const String& contentEncoding, const uint8_t* content, size_t len)
+// The content hashes are generated by pio-scripts/webapp_assets.py
+extern const char* _etag_webapp_dist_index_html_gz;
+extern const char* _etag_webapp_dist_favicon_ico;
+extern const char* _etag_webapp_dist_favicon_png;
+extern const char* _etag_webapp_dist_js_app_js_gz;
+extern const char* _etag_webapp_dist_site_webmanifest;
+
+#ifdef WEBAPP_HAS_BROTLI
+extern const uint8_t file_index_html_br_start[] asm("_binary_webapp_dist_index_html_br_start");
+extern const uint8_t file_app_js_br_start[] asm("_binary_webapp_dist_js_app_js_br_start");
+
+extern const uint8_t file_index_html_br_end[] asm("_binary_webapp_dist_index_html_br_end");
+extern const uint8_t file_app_js_br_end[] asm("_binary_webapp_dist_js_app_js_br_end");
+
+extern const char* _etag_webapp_dist_index_html_br;
+extern const char* _etag_webapp_dist_js_app_js_br;
+#endif
+
+WebApiWebappClass::WebappAsset_t WebApiWebappClass::makeAsset(const uint8_t* start, const uint8_t* end, const char* contentHash)
 {
-    auto md5 = MD5Builder();
-    md5.begin();
-    md5.add(const_cast<uint8_t*>(content), len);
+    WebappAsset_t asset = { start, end, "\"" };
 
     // ensure ETag uniqueness per version by including Git commit hash. force
     // browsers to reload dependent resources like app.js even
     // when index.html content hasn't actually changed between versions.
-    md5.add(String(__COMPILED_GIT_HASH__));
+    asset.etag += contentHash;
+    asset.etag += "-";
+    asset.etag += __COMPILED_GIT_HASH__;
+    asset.etag += "\"";
 
-    md5.calculate();
+    return asset;
+}
+
+void WebApiWebappClass::responseAsset(AsyncWebServerRequest* request, const String& contentType, const WebappAsset_t& gzipAsset, const WebappAsset_t* brotliAsset)
+{
+    if (brotliAsset != nullptr) {
+        if (WebApi.acceptsEncoding(request, "br")) {
+            responseBinaryDataWithETagCache(request, contentType, "br", *brotliAsset, true);
+            return;
+        }
+    }
 
-    String expectedEtag;
-    expectedEtag = "\"";
-    expectedEtag += md5.toString();
-    expectedEtag += "\"";
+    responseBinaryDataWithETagCache(request, contentType, asyncsrv::T_gzip, gzipAsset, brotliAsset != nullptr);
+}
 
+void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest* request, const String& contentType, const String& contentEncoding, const WebappAsset_t& asset, const bool varyEncoding)
+{
     bool eTagMatch = false;
     if (request->hasHeader(asyncsrv::T_INM)) {
         const AsyncWebHeader* h = request->getHeader(asyncsrv::T_INM);
-        eTagMatch = h->value().equals(expectedEtag);
+        eTagMatch = h->value().equals(asset.etag);
     }
 
     // begin response 200 or 304
@@ -47,7 +76,7 @@ void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest* r
     if (eTagMatch) {
         response = request->beginResponse(304);
     } else {
-        response = request->beginResponse(200, contentType, content, len);
+        response = request->beginResponse(200, contentType, asset.start, asset.end - asset.start);
         if (contentEncoding.length() > 0) {
             response->addHeader(asyncsrv::T_Content_Encoding, contentEncoding);
         }
@@ -55,43 +84,63 @@ void WebApiWebappClass::responseBinaryDataWithETagCache(AsyncWebServerRequest* r
 
     // HTTP requires cache headers in 200 and 304 to be identical
     response->addHeader(asyncsrv::T_Cache_Control, "public, must-revalidate");
-    response->addHeader(asyncsrv::T_ETag, expectedEtag);
+    response->addHeader(asyncsrv::T_ETag, asset.etag);
+    if (varyEncoding) {
+        response->addHeader("Vary", "Accept-Encoding");
+    }
 
     request->send(response);
 }
 
 void WebApiWebappClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
+    _indexHtml = makeAsset(file_index_html_start, file_index_html_end, _etag_webapp_dist_index_html_gz);
+    _faviconIco = makeAsset(file_favicon_ico_start, file_favicon_ico_end, _etag_webapp_dist_favicon_ico);
+    _faviconPng = makeAsset(file_favicon_png_start, file_favicon_png_end, _etag_webapp_dist_favicon_png);
+    _appJs = makeAsset(file_app_js_start, file_app_js_end, _etag_webapp_dist_js_app_js_gz);
+    _siteWebmanifest = makeAsset(file_site_webmanifest_start, file_site_webmanifest_end, _etag_webapp_dist_site_webmanifest);
+
     /*
        We don't validate the request header "Accept-Encoding" if gzip compression is supported!
        We just have the gzipped data available - so we ship them!
+       If brotli variants are embedded they are preferred for clients accepting "br".
     */
-
-    server.on("/", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_text_html, asyncsrv::T_gzip, file_index_html_start, file_index_html_end - file_index_html_start);
+#ifdef WEBAPP_HAS_BROTLI
+    _indexHtmlBr = makeAsset(file_index_html_br_start, file_index_html_br_end, _etag_webapp_dist_index_html_br);
+    _appJsBr = makeAsset(file_app_js_br_start, file_app_js_br_end, _etag_webapp_dist_js_app_js_br);
+
+    const WebappAsset_t* indexHtmlBr = &_indexHtmlBr;
+    const WebappAsset_t* appJsBr = &_appJsBr;
+#else
+    const WebappAsset_t* indexHtmlBr = nullptr;
+    const WebappAsset_t* appJsBr = nullptr;
+#endif
+
+    server.on("/", HTTP_GET, [this, indexHtmlBr](AsyncWebServerRequest* request) {
+        responseAsset(request, asyncsrv::T_text_html, _indexHtml, indexHtmlBr);
     });
 
-    server.onNotFound([&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_text_html, asyncsrv::T_gzip, file_index_html_start, file_index_html_end - file_index_html_start);
+    server.onNotFound([this, indexHtmlBr](AsyncWebServerRequest* request) {
+        responseAsset(request, asyncsrv::T_text_html, _indexHtml, indexHtmlBr);
     });
 
-    server.on("/index.html", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_text_html, asyncsrv::T_gzip, file_index_html_start, file_index_html_end - file_index_html_start);
+    server.on("/index.html", HTTP_GET, [this, indexHtmlBr](AsyncWebServerRequest* request) {
+        responseAsset(request, asyncsrv::T_text_html, _indexHtml, indexHtmlBr);
     });
 
-    server.on("/favicon.ico", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_image_x_icon, "", file_favicon_ico_start, file_favicon_ico_end - file_favicon_ico_start);
+    server.on("/favicon.ico", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        responseBinaryDataWithETagCache(request, asyncsrv::T_image_x_icon, "", _faviconIco);
     });
 
-    server.on("/favicon.png", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_image_png, "", file_favicon_png_start, file_favicon_png_end - file_favicon_png_start);
+    server.on("/favicon.png", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        responseBinaryDataWithETagCache(request, asyncsrv::T_image_png, "", _faviconPng);
     });
 
-    server.on("/site.webmanifest", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_application_json, "", file_site_webmanifest_start, file_site_webmanifest_end - file_site_webmanifest_start);
+    server.on("/site.webmanifest", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        responseBinaryDataWithETagCache(request, asyncsrv::T_application_json, "", _siteWebmanifest);
     });
 
-    server.on("/js/app.js", HTTP_GET, [&](AsyncWebServerRequest* request) {
-        responseBinaryDataWithETagCache(request, asyncsrv::T_text_javascript, asyncsrv::T_gzip, file_app_js_start, file_app_js_end - file_app_js_start);
+    server.on("/js/app.js", HTTP_GET, [this, appJsBr](AsyncWebServerRequest* request) {
+        responseAsset(request, asyncsrv::T_text_javascript, _appJs, appJsBr);
     });
 }
@@ -33,14 +33,14 @@ void WebApiWsConsoleClass::reload()
 {
     _ws.removeMiddleware(&_simpleDigestAuth);
 
-    auto const& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    if (config.Security.AllowReadonly) {
+    if (config->Security.AllowReadonly) {
         return;
     }
 
     _ws.enable(false);
-    _simpleDigestAuth.setPassword(config.Security.Password);
+    _simpleDigestAuth.setPassword(config->Security.Password);
     _ws.addMiddleware(&_simpleDigestAuth);
     _ws.closeAll();
     _ws.enable(true);
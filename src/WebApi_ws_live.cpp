@@ -8,6 +8,7 @@
 #include "WebApi.h"
 #include "defaults.h"
 #include <AsyncJson.h>
+#include <algorithm>
 
 #undef TAG
 static const char* TAG = "webapi";
@@ -53,14 +54,14 @@ void WebApiWsLiveClass::reload()
 {
     _ws.removeMiddleware(&_simpleDigestAuth);
 
-    auto const& config = Configuration.get();
+    const auto config = Configuration.get();
 
-    if (config.Security.AllowReadonly) {
+    if (config->Security.AllowReadonly) {
         return;
     }
 
     _ws.enable(false);
-    _simpleDigestAuth.setPassword(config.Security.Password);
+    _simpleDigestAuth.setPassword(config->Security.Password);
     _ws.addMiddleware(&_simpleDigestAuth);
     _ws.closeAll();
     _ws.enable(true);
@@ -79,6 +80,8 @@ void WebApiWsLiveClass::sendDataTaskCb()
         return;
     }
 
+    bool updated = false;
+
     // Loop all inverters
     for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
         auto inv = Hoymiles.getInverterByPos(i);
@@ -92,9 +95,17 @@ void WebApiWsLiveClass::sendDataTaskCb()
         }
 
         _lastPublishStats[i] = millis();
+        updated = true;
 
         try {
             std::lock_guard<std::mutex> lock(_mutex);
+
+            // Skip the JSON generation completely if nobody is interested in this inverter
+            const auto subscribers = getSubscribers(inv->serial());
+            if (subscribers.empty()) {
+                continue;
+            }
+
             JsonDocument root;
             JsonVariant var = root;
 
@@ -112,7 +123,7 @@ void WebApiWsLiveClass::sendDataTaskCb()
             String buffer;
             serializeJson(root, buffer);
 
-            _ws.textAll(buffer);
+            sendToSubscribers(subscribers, buffer);
 
         } catch (const std::bad_alloc& bad_alloc) {
             ESP_LOGE(TAG, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
@@ -120,6 +131,73 @@ void WebApiWsLiveClass::sendDataTaskCb()
             ESP_LOGE(TAG, "Unknown exception in /api/livedata/status. Reason: \"%s\".", exc.what());
         }
     }
+
+    if (!updated) {
+        return;
+    }
+
+    // Clients which only subscribed to the totals get them once per cycle with updated inverters
+    try {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const auto subscribers = getSubscribers(0);
+        if (subscribers.empty()) {
+            return;
+        }
+
+        JsonDocument root;
+        JsonVariant var = root;
+
+        var["inverters"].to<JsonArray>();
+        generateCommonJsonResponse(var);
+
+        if (!Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__)) {
+            return;
+        }
+
+        String buffer;
+        serializeJson(root, buffer);
+
+        sendToSubscribers(subscribers, buffer);
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        ESP_LOGE(TAG, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
+    }
+}
+
+/// @brief Returns the ids of all clients subscribed to the given inverter
+/// @param serial Inverter serial or 0 to get all clients which only subscribed to the totals
+std::vector<uint32_t> WebApiWsLiveClass::getSubscribers(const uint64_t serial) const
+{
+    std::vector<uint32_t> clientIds;
+
+    for (auto& [clientId, subscription] : _subscriptions) {
+        if (serial == 0) {
+            if (!subscription.allInverters && subscription.serials.empty()) {
+                clientIds.push_back(clientId);
+            }
+            continue;
+        }
+
+        if (subscription.allInverters
+            || std::find(subscription.serials.begin(), subscription.serials.end(), serial) != subscription.serials.end()) {
+            clientIds.push_back(clientId);
+        }
+    }
+
+    return clientIds;
+}
+
+void WebApiWsLiveClass::sendToSubscribers(const std::vector<uint32_t>& clientIds, const String& buffer)
+{
+    if (clientIds.size() == _subscriptions.size()) {
+        _ws.textAll(buffer);
+        return;
+    }
+
+    for (auto clientId : clientIds) {
+        _ws.text(clientId, buffer);
+    }
 }
 
 void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
@@ -133,14 +211,14 @@ void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
     struct tm timeinfo;
     hintObj["time_sync"] = !getLocalTime(&timeinfo, 5);
     hintObj["radio_problem"] = (Hoymiles.getRadioNrf()->isInitialized() && (!Hoymiles.getRadioNrf()->isConnected() || !Hoymiles.getRadioNrf()->isPVariant())) || (Hoymiles.getRadioCmt()->isInitialized() && (!Hoymiles.getRadioCmt()->isConnected()));
-    hintObj["default_password"] = strcmp(Configuration.get().Security.Password, ACCESS_POINT_PASSWORD) == 0;
+    hintObj["default_password"] = strcmp(Configuration.get()->Security.Password, ACCESS_POINT_PASSWORD) == 0;
 
     hintObj["pin_mapping_issue"] = PIN_MAPPING_REQUIRED && !PinMapping.isMappingSelected();
 }
 
 void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
 {
-    const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+    const auto inv_cfg = Configuration.getInverterConfig(*inv);
     if (inv_cfg == nullptr) {
         return;
     }
@@ -150,6 +228,7 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
     root["order"] = inv_cfg->Order;
     root["data_age"] = (millis() - inv->Statistics()->getLastUpdate()) / 1000;
     root["data_age_ms"] = millis() - inv->Statistics()->getLastUpdate();
+    root["data_stale"] = inv->Statistics()->isCached();
     root["poll_enabled"] = inv->getEnablePolling();
     root["reachable"] = inv->isReachable();
     root["producing"] = inv->isProducing();
@@ -170,7 +249,7 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
 
 void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
 {
-    const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+    const auto inv_cfg = Configuration.getInverterConfig(*inv);
     if (inv_cfg == nullptr) {
         return;
     }
@@ -241,8 +320,58 @@ void WebApiWsLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketC
 {
     if (type == WS_EVT_CONNECT) {
         ESP_LOGD(TAG, "Websocket: [%s][%" PRIu32 "] connect", server->url(), client->id());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _subscriptions[client->id()] = Subscription_t();
     } else if (type == WS_EVT_DISCONNECT) {
         ESP_LOGD(TAG, "Websocket: [%s][%" PRIu32 "] disconnect", server->url(), client->id());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _subscriptions.erase(client->id());
+    } else if (type == WS_EVT_DATA) {
+        // Only complete, unfragmented text messages are supported
+        auto info = static_cast<AwsFrameInfo*>(arg);
+        if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+            onSubscribe(client, data, len);
+        }
+    }
+}
+
+/// @brief Handles subscription messages sent by a client.
+/// {"subscribe":"all"} (default) sends the data of all inverters,
+/// {"subscribe":"totals"} only sends the totals and hints and
+/// {"subscribe":["<serial>", ...]} sends the data of the listed inverters.
+void WebApiWsLiveClass::onSubscribe(AsyncWebSocketClient* client, const uint8_t* data, const size_t len)
+{
+    JsonDocument root;
+    const DeserializationError error = deserializeJson(root, data, len);
+    if (error || root["subscribe"].isNull()) {
+        ESP_LOGW(TAG, "Websocket: [%" PRIu32 "] invalid subscribe message", client->id());
+        return;
+    }
+
+    Subscription_t subscription;
+    auto subscribe = root["subscribe"];
+
+    if (subscribe.is<JsonArray>()) {
+        subscription.allInverters = false;
+        for (JsonVariant serialVar : subscribe.as<JsonArray>()) {
+            const uint64_t serial = strtoull(serialVar.as<String>().c_str(), NULL, 16);
+            if (serial > 0) {
+                subscription.serials.push_back(serial);
+            }
+        }
+    } else if (subscribe.as<String>() == "totals") {
+        subscription.allInverters = false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _subscriptions[client->id()] = subscription;
+
+    // Send the current data of the subscribed inverters with the next cycle
+    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
+        auto inv = Hoymiles.getInverterByPos(i);
+        if (inv != nullptr && (subscription.allInverters || std::find(subscription.serials.begin(), subscription.serials.end(), inv->serial()) != subscription.serials.end())) {
+            _lastPublishStats[i] = 0;
+        }
     }
 }
 
@@ -252,42 +381,53 @@ void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    try {
+    const auto serial = WebApi.parseSerialFromRequest(request);
+
+    // Every inverter is rendered into its own small document and streamed to the client
+    // before the next one is generated. This keeps the memory usage independent of the number of inverters.
+    WebApi.sendChunkedResponse(request, asyncsrv::T_application_json, [this, serial, firstInverter = true](Print& out, const size_t part) mutable -> bool {
+        if (part == 0) {
+            out.print("{\"inverters\":[");
+            return true;
+        }
+
         std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-        auto invArray = root["inverters"].to<JsonArray>();
-        auto serial = WebApi.parseSerialFromRequest(request);
-
-        if (serial > 0) {
-            auto inv = Hoymiles.getInverterBySerial(serial);
-            if (inv != nullptr) {
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
-                generateInverterChannelJsonResponse(invObject, inv);
+
+        const size_t invCount = serial > 0 ? 1 : Hoymiles.getNumInverters();
+        if (part <= invCount) {
+            auto inv = serial > 0 ? Hoymiles.getInverterBySerial(serial) : Hoymiles.getInverterByPos(part - 1);
+            if (inv == nullptr) {
+                return true;
             }
-        } else {
-            // Loop all inverters
-            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-                auto inv = Hoymiles.getInverterByPos(i);
-                if (inv == nullptr) {
-                    continue;
-                }
-
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
+
+            JsonDocument doc;
+            auto invObject = doc.to<JsonObject>();
+            generateInverterCommonJsonResponse(invObject, inv);
+            if (serial > 0) {
+                generateInverterChannelJsonResponse(invObject, inv);
             }
-        }
 
-        generateCommonJsonResponse(root);
+            if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
+                throw std::bad_alloc();
+            }
 
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            if (!firstInverter) {
+                out.print(',');
+            }
+            firstInverter = false;
+            serializeJson(doc, out);
+            return true;
+        }
 
-    } catch (const std::bad_alloc& bad_alloc) {
-        ESP_LOGE(TAG, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".", bad_alloc.what());
-        WebApi.sendTooManyRequests(request);
-    } catch (const std::exception& exc) {
-        ESP_LOGE(TAG, "Unknown exception in /api/livedata/status. Reason: \"%s\".", exc.what());
-        WebApi.sendTooManyRequests(request);
-    }
+        JsonDocument doc;
+        JsonVariant var = doc;
+        generateCommonJsonResponse(var);
+
+        // Append the common members to the already opened root object (skip their leading '{')
+        String common;
+        serializeJson(doc, common);
+        out.print("],");
+        out.print(common.c_str() + 1);
+        return false;
+    });
 }
@@ -2,14 +2,20 @@
 /*
  * Copyright (C) 2022-2026 Thomas Basler and others
  */
+#include "BootProfiler.h"
 #include "Configuration.h"
 #include "Datastore.h"
 #include "Display_Graphic.h"
+#include "EnergyRollup.h"
+#include "EventStore.h"
+#include "History.h"
 #include "I18n.h"
+#include "InverterCache.h"
 #include "InverterSettings.h"
 #include "Led_Single.h"
 #include "Logging.h"
 #include "MessageOutput.h"
+#include "MqttBackfill.h"
 #include "MqttHandleDtu.h"
 #include "MqttHandleHass.h"
 #include "MqttHandleInverter.h"
@@ -22,6 +28,7 @@
 #include "Scheduler.h"
 #include "SunPosition.h"
 #include "Utils.h"
+#include "WarmStart.h"
 #include "WebApi.h"
 #include "defaults.h"
 #include <Arduino.h>
@@ -34,6 +41,8 @@ static const char* TAG = "main";
 
 void setup()
 {
+    BootProfiler.begin();
+
     // Move all dynamic allocations >512byte to psram (if available)
     heap_caps_malloc_extmem_enable(512);
 
@@ -51,6 +60,7 @@ void setup()
     esp_log_level_set("CORE", ESP_LOG_ERROR);
 
     ESP_LOGI(TAG, "Starting OpenDTU");
+    BootProfiler.endStage("serial");
 
     // Initialize file system
     ESP_LOGI(TAG, "Mounting FS...");
@@ -59,74 +69,98 @@ void setup()
         const bool success = LittleFS.begin(true);
         ESP_LOG_LEVEL_LOCAL((success ? ESP_LOG_INFO : ESP_LOG_ERROR), TAG, "FS reformat %s", success ? "successful" : "failed");
     }
+    BootProfiler.endStage("filesystem");
 
     // Read configuration values
     ESP_LOGI(TAG, "Reading configuration...");
     Configuration.init(scheduler);
     if (!Configuration.read()) {
-        bool success = Configuration.write();
+        Configuration.write();
+        const bool success = Configuration.flush();
         ESP_LOG_LEVEL_LOCAL((success ? ESP_LOG_INFO : ESP_LOG_WARN), TAG, "Failed to read configuration. New default configuration written %s",
             success ? "successful" : "failed");
     }
-    if (Configuration.get().Cfg.Version != CONFIG_VERSION) {
+    if (Configuration.get()->Cfg.Version != CONFIG_VERSION) {
         ESP_LOGI(TAG, "Performing configuration migration from %" PRIX32 " to %" PRIX32 "",
-            Configuration.get().Cfg.Version, CONFIG_VERSION);
+            Configuration.get()->Cfg.Version, CONFIG_VERSION);
         Configuration.migrate();
     }
 
     // Set configured log levels
     Logging.applyLogLevels();
     esp_log_level_set(TAG, ESP_LOG_VERBOSE);
+    BootProfiler.endStage("configuration");
 
     // Read languate pack
     ESP_LOGI(TAG, "Reading language pack...");
     I18n.init(scheduler);
+    BootProfiler.endStage("i18n");
 
     // Load PinMapping
     ESP_LOGI(TAG, "Reading PinMapping...");
-    if (PinMapping.init(Configuration.get().Dev_PinMapping)) {
+    if (PinMapping.init(Configuration.get()->Dev_PinMapping)) {
         ESP_LOGI(TAG, "Found valid mapping");
     } else {
         ESP_LOGW(TAG, "Didn't found valid mapping. Using default.");
     }
+    BootProfiler.endStage("pinmapping");
+
+    // Initialize inverter communication, the radios are set up in a separate task
+    InverterSettings.init(scheduler);
+    BootProfiler.endStage("inverters");
 
     // Initialize Network
     ESP_LOGI(TAG, "Initializing Network...");
     NetworkSettings.init(scheduler);
     NetworkSettings.applyConfig();
+    BootProfiler.init();
+    BootProfiler.endStage("network");
 
     // Initialize NTP
     ESP_LOGI(TAG, "Initializing NTP...");
     NtpSettings.init();
+    BootProfiler.endStage("ntp");
 
     // Initialize SunPosition
     ESP_LOGI(TAG, "Initializing SunPosition...");
     SunPosition.init(scheduler);
+    BootProfiler.endStage("sunposition");
 
     // Initialize MqTT
     ESP_LOGI(TAG, "Initializing MQTT...");
-    MqttSettings.init();
+    MqttSettings.init(scheduler);
     MqttHandleDtu.init(scheduler);
     MqttHandleInverter.init(scheduler);
     MqttHandleInverterTotal.init(scheduler);
     MqttHandleHass.init(scheduler);
+    MqttBackfill.init(scheduler);
+    BootProfiler.endStage("mqtt");
 
     // Initialize WebApi
     ESP_LOGI(TAG, "Initializing WebApi...");
     WebApi.init(scheduler);
+    BootProfiler.setWebStarted();
+    BootProfiler.endStage("webapi");
 
     // Initialize Display
     ESP_LOGI(TAG, "Initializing Display...");
     Display.init(scheduler);
+    BootProfiler.endStage("display");
 
     // Initialize Single LEDs
     ESP_LOGI(TAG, "Initializing LEDs...");
     LedSingle.init(scheduler);
+    BootProfiler.endStage("leds");
 
-    InverterSettings.init(scheduler);
+    InverterCache.init(scheduler);
+    WarmStart.init(scheduler);
 
     Datastore.init(scheduler);
+    History.init(scheduler);
+    EnergyRollup.init(scheduler);
+    EventStore.init(scheduler);
     RestartHelper.init(scheduler);
+    BootProfiler.endStage("stores");
 
     ESP_LOGI(TAG, "Startup complete");
 }
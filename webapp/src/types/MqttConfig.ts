@@ -7,6 +7,9 @@ export interface MqttConfig {
     mqtt_password: string;
     mqtt_topic: string;
     mqtt_publish_interval: number;
+    mqtt_publish_on_change: boolean;
+    mqtt_publish_max_age: number;
+    mqtt_aggregated: boolean;
     mqtt_clean_session: boolean;
     mqtt_retain: boolean;
     mqtt_tls: boolean;
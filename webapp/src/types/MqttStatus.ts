@@ -6,6 +6,9 @@ export interface MqttStatus {
     mqtt_username: string;
     mqtt_topic: string;
     mqtt_publish_interval: number;
+    mqtt_publish_on_change: boolean;
+    mqtt_publish_max_age: number;
+    mqtt_aggregated: boolean;
     mqtt_clean_session: boolean;
     mqtt_retain: boolean;
     mqtt_tls: boolean;
@@ -18,4 +21,23 @@ export interface MqttStatus {
     mqtt_hass_retain: boolean;
     mqtt_hass_topic: string;
     mqtt_hass_individualpanels: boolean;
+    mqtt_publish_count: number;
+    mqtt_publish_rate: number;
+    mqtt_publish_suppressed: number;
+    mqtt_publish_duration: number;
+    mqtt_outbox_messages: number;
+    mqtt_outbox_bytes: number;
+    mqtt_outbox_pending: number;
+    mqtt_outbox_dropped: number;
+    mqtt_outbox_coalesced: number;
+    mqtt_backfill_records: number;
+    mqtt_backfill_capacity: number;
+    mqtt_backfill_captured: number;
+    mqtt_backfill_dropped: number;
+    mqtt_backfill_replayed: number;
+    mqtt_hass_discovery_published: number;
+    mqtt_hass_discovery_unchanged: number;
+    mqtt_hass_discovery_bytes: number;
+    mqtt_hass_discovery_heap: number;
+    mqtt_hass_discovery_duration: number;
 }
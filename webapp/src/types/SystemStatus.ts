@@ -25,6 +25,7 @@ export interface SystemStatus {
     resetreason_0: string;
     resetreason_1: string;
     cfgsavecount: number;
+    cfgwritefailed: boolean;
     uptime: number;
     update_text: string;
     update_url: string;
@@ -1,6 +1,6 @@
 import { fileURLToPath, URL } from 'node:url'
 
-import { defineConfig } from 'vite'
+import { defineConfig, type Plugin } from 'vite'
 import vue from '@vitejs/plugin-vue'
 
 import viteCompression from 'vite-plugin-compression';
@@ -8,6 +8,8 @@ import cssInjectedByJsPlugin from 'vite-plugin-css-injected-by-js'
 import VueI18nPlugin from '@intlify/unplugin-vue-i18n/vite'
 
 import path from 'path'
+import fs from 'node:fs'
+import { brotliCompressSync, constants } from 'node:zlib'
 
 // example 'vite.user.ts': export const proxy_target = '192.168.16.107'
 let proxy_target;
@@ -18,10 +20,27 @@ try {
     proxy_target = '192.168.20.110';
 }
 
+// Creates brotli variants of the given files, which the firmware serves to clients accepting "br"
+// if they are embedded. Runs before viteCompression replaces the files by their gzip variants.
+const brotliVariants = (files: string[]): Plugin => ({
+  name: 'brotli-variants',
+  apply: 'build',
+  writeBundle(options) {
+    for (const file of files) {
+      const fullPath = path.join(options.dir!, file);
+      const content = brotliCompressSync(fs.readFileSync(fullPath), {
+        params: { [constants.BROTLI_PARAM_QUALITY]: constants.BROTLI_MAX_QUALITY },
+      });
+      fs.writeFileSync(fullPath + '.br', content);
+    }
+  },
+});
+
 // https://vitejs.dev/config/
 export default defineConfig({
   plugins: [
     vue(),
+    brotliVariants(['index.html', 'js/app.js']),
     viteCompression({ deleteOriginFile: true, threshold: 0 }),
     cssInjectedByJsPlugin(),
     VueI18nPlugin({